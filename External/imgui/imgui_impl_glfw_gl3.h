@@ -9,11 +9,16 @@
 // https://github.com/ocornut/imgui
 
 struct GLFWwindow;
+struct ImDrawData;
+struct ImVec2;
 
 IMGUI_API bool        ImGui_ImplGlfwGL3_Init(GLFWwindow* window, bool install_callbacks);
 IMGUI_API void        ImGui_ImplGlfwGL3_Shutdown();
 IMGUI_API void        ImGui_ImplGlfwGL3_NewFrame();
 
+// Draws draw data that was copied out of ImGui, doesn't touch the ImGui context
+IMGUI_API void        ImGui_ImplGlfwGL3_RenderDrawData(ImDrawData* draw_data, const ImVec2& display_size, const ImVec2& framebuffer_scale);
+
 // Use if you want to reset your rendering device without losing ImGui state.
 IMGUI_API void        ImGui_ImplGlfwGL3_InvalidateDeviceObjects();
 IMGUI_API bool        ImGui_ImplGlfwGL3_CreateDeviceObjects();
@@ -154,13 +154,13 @@ protected:
 
 	// -- Group Behaviors -- //
 
-	std::vector<PhysicsBody2D*> GetFlockingNeighbors();
+	FrameVector<PhysicsBody2D*> GetFlockingNeighbors();
 
-	Vector2 Cohesion(const std::vector<PhysicsBody2D*> &agents);
+	Vector2 Cohesion(const FrameVector<PhysicsBody2D*>& agents);
 
-	Vector2 Separation(const std::vector<PhysicsBody2D*> &agents);
+	Vector2 Separation(const FrameVector<PhysicsBody2D*>& agents);
 
-	Vector2 Alignment(const std::vector<PhysicsBody2D*> &agents);
+	Vector2 Alignment(const FrameVector<PhysicsBody2D*>& agents);
 
 #if DEBUG_RENDER
 	void DebugRender();
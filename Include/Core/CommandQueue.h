@@ -0,0 +1,237 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <Defines.h>
+
+namespace Osm
+{
+
+///
+/// Command
+/// A move-only callable with no arguments, stored inline. Captures must
+/// fit in the inline buffer, so creating a command never allocates.
+///
+class Command
+{
+public:
+	/// Bytes available for the callable and its captures
+	static const size_t kStorageSize = 64;
+
+	Command() {}
+
+	template<class F, class = typename std::enable_if<
+		!std::is_same<typename std::decay<F>::type, Command>::value>::type>
+	Command(F&& func)
+	{
+		typedef typename std::decay<F>::type Func;
+		static_assert(sizeof(Func) <= kStorageSize, "Command captures too much, it must fit inline");
+		static_assert(alignof(Func) <= alignof(std::max_align_t), "Command is over aligned");
+
+		new (_storage) Func(std::forward<F>(func));
+		_invoke = [](void* f) { (*static_cast<Func*>(f))(); };
+		_manage = [](void* dst, void* src)
+		{
+			if (dst)
+				new (dst) Func(std::move(*static_cast<Func*>(src)));
+			static_cast<Func*>(src)->~Func();
+		};
+	}
+
+	Command(Command&& other)					{ MoveFrom(other); }
+
+	Command& operator=(Command&& other)
+	{
+		if (this != &other)
+		{
+			Clear();
+			MoveFrom(other);
+		}
+		return *this;
+	}
+
+	Command(const Command& other) = delete;
+
+	Command& operator=(const Command& other) = delete;
+
+	~Command()									{ Clear(); }
+
+	/// Runs the command
+	void operator()()							{ ASSERT(_invoke); _invoke(_storage); }
+
+	/// Does this hold a callable
+	explicit operator bool() const				{ return _invoke != nullptr; }
+
+	/// Destroys the callable
+	void Clear()
+	{
+		if (_manage)
+			_manage(nullptr, _storage);
+		_invoke = nullptr;
+		_manage = nullptr;
+	}
+
+private:
+	void MoveFrom(Command& other)
+	{
+		if (other._manage)
+			other._manage(_storage, other._storage);
+		_invoke = other._invoke;
+		_manage = other._manage;
+		other._invoke = nullptr;
+		other._manage = nullptr;
+	}
+
+	typedef void(*InvokeFunc)(void*);
+	typedef void(*ManageFunc)(void* dst, void* src);
+
+	alignas(std::max_align_t) unsigned char	_storage[kStorageSize];
+	InvokeFunc								_invoke = nullptr;
+	ManageFunc								_manage = nullptr;
+};
+
+///
+/// CommandQueue
+/// A bounded lock-free queue of commands. Any thread can push, a single
+/// thread (usually the main thread) executes them. Each cell carries a
+/// sequence number so producers only contend on a single atomic. When
+/// the ring is full, commands spill into a locked list instead of being
+/// dropped, until the next execute empties it.
+///
+class CommandQueue
+{
+public:
+	/// Capacity gets rounded up to a power of two
+	explicit CommandQueue(size_t capacity = 1024)
+	{
+		size_t size = 1;
+		while (size < capacity)
+			size <<= 1;
+
+		_mask = size - 1;
+		_cells.reset(new Cell[size]);
+		for (size_t i = 0; i < size; i++)
+			_cells[i].Sequence.store(i, std::memory_order_relaxed);
+		_enqueuePos.store(0, std::memory_order_relaxed);
+		_dequeuePos = 0;
+	}
+
+	CommandQueue(const CommandQueue& other) = delete;
+
+	/// Adds a command, can be called from any thread. Only allocates
+	/// when the ring is full.
+	void Push(Command&& command)
+	{
+		// Once spilling, everything spills so the commands stay in order
+		if (!_spilled.load(std::memory_order_acquire) && TryPush(std::move(command)))
+			return;
+
+		std::lock_guard<std::mutex> lock(_spillMutex);
+		_spill.push_back(std::move(command));
+		_spilled.store(true, std::memory_order_release);
+	}
+
+	/// Adds a command to the ring, can be called from any thread. Returns
+	/// false when the ring is full, the command is left as it was then.
+	bool TryPush(Command&& command)
+	{
+		size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+		Cell* cell;
+		while (true)
+		{
+			cell = &_cells[pos & _mask];
+			size_t seq = cell->Sequence.load(std::memory_order_acquire);
+			intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+			if (diff == 0)
+			{
+				if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = _enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+
+		cell->Data = std::move(command);
+		cell->Sequence.store(pos + 1, std::memory_order_release);
+		return true;
+	}
+
+	/// Runs all the commands that were pushed before the call. Commands
+	/// pushed while executing will run on the next call. Only call this
+	/// from the consumer thread. Returns the number of commands executed.
+	size_t Execute()
+	{
+		size_t end = _enqueuePos.load(std::memory_order_acquire);
+		size_t executed = 0;
+		while (_dequeuePos != end)
+		{
+			Cell& cell = _cells[_dequeuePos & _mask];
+			size_t seq = cell.Sequence.load(std::memory_order_acquire);
+
+			// The producer reserved the cell but hasn't finished writing it
+			if (seq != _dequeuePos + 1)
+				break;
+
+			Command command = std::move(cell.Data);
+			cell.Sequence.store(_dequeuePos + _mask + 1, std::memory_order_release);
+			_dequeuePos++;
+
+			command();
+			executed++;
+		}
+
+		// Everything in the ring was pushed before the spill started
+		if (_spilled.load(std::memory_order_acquire))
+		{
+			std::vector<Command> spill;
+			{
+				std::lock_guard<std::mutex> lock(_spillMutex);
+				spill.swap(_spill);
+				_spilled.store(false, std::memory_order_release);
+			}
+			for (auto& command : spill)
+				command();
+			executed += spill.size();
+		}
+		return executed;
+	}
+
+	/// Capacity of the queue
+	size_t GetCapacity() const					{ return _mask + 1; }
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t>		Sequence;
+		Command					Data;
+	};
+
+	std::unique_ptr<Cell[]>		_cells;
+	size_t						_mask;
+
+	// Keep the producer and consumer positions on separate cache lines
+	char						_pad0[64];
+	std::atomic<size_t>			_enqueuePos;
+	char						_pad1[64];
+	size_t						_dequeuePos;
+
+	// Commands that didn't fit in the ring
+	std::mutex					_spillMutex;
+	std::vector<Command>		_spill;
+	std::atomic<bool>			_spilled{ false };
+};
+
+}
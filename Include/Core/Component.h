@@ -2,6 +2,7 @@
 #include <memory>
 #include <vector>
 #include <Core/IDable.h>
+#include <Core/FrameArena.h>
 #include <Defines.h>
 
 namespace Osm
@@ -46,9 +47,9 @@ public:
 	template<class T>
 	T* GetComponent();
 
-	/// Get all components of a certain kind
+	/// Get all components of a certain kind, valid for this frame only
 	template<class T>
-	std::vector<T*> GetComponents();
+	FrameVector<T*> GetComponents();
 
 	/// Remove a component of a certain kind
 	template<class T>
@@ -87,9 +88,9 @@ T* ComponentContainer<E>::GetComponent()
 
 template <class E>
 template <class T>
-std::vector<T*> ComponentContainer<E>::GetComponents()
+FrameVector<T*> ComponentContainer<E>::GetComponents()
 {
-	std::vector<T*> components;
+	FrameVector<T*> components;
 	for (auto& c : _components)
 	{
 		T* found = dynamic_cast<T*>(c.get());
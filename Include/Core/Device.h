@@ -19,11 +19,17 @@ public:
 
 	GLFWwindow* GetWindow() const { return _window; }
 
+	/// Hidden window with a context that shares objects with the main one.
+	/// Only created when rendering is pipelined, then the main thread uses
+	/// it to load resources while the render thread owns the main context.
+	GLFWwindow* GetResourceWindow() const { return _resourceWindow; }
+
 protected:
 	int			_height = 0;
 	int			_width = 0;
 	float		_ratio;
 	GLFWwindow* _window = nullptr;
+	GLFWwindow* _resourceWindow = nullptr;
 };
 
 }
\ No newline at end of file
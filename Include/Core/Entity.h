@@ -1,6 +1,8 @@
 #pragma once
 
 #include <string>
+#include <functional>
+#include <mutex>
 #include <Defines.h>
 #include <Core/Component.h>
 
@@ -56,6 +58,37 @@ public:
 	/// Set a generic tag
 	void SetTag(uint tag)				{ _tag = tag; }
 
+	/// Thread safe entities only touch their own state in Update and
+	/// PostUpdate, so the world can update them in parallel
+	bool GetThreadSafe() const			{ return _threadSafe; }
+
+	/// Mark this entity as safe to update in parallel
+	void SetThreadSafe(bool threadSafe)	{ _threadSafe = threadSafe; }
+
+	/// Create a component of a certain kind. During a parallel update
+	/// the component is only added at the world's sync point.
+	template<class T>
+	T* CreateComponent();
+
+	/// Remove a component of a certain kind. During a parallel update
+	/// the component is only removed at the world's sync point.
+	template<class T>
+	void RemoveComponent();
+
+private:
+
+	/// True when the world is updating entities on the job system
+	bool InParallelUpdate() const;
+
+	/// Lock that guards structural changes during a parallel update
+	std::recursive_mutex& GetStructureMutex() const;
+
+	/// Run a structural change at the world's sync point
+	void Defer(std::function<void(void)> change);
+
+	/// Add an already constructed component at the sync point
+	void DeferComponent(Component<Entity>* component);
+
 private:
 
 	/// Use this to grab the next valid ID
@@ -81,6 +114,35 @@ private:
 
 	/// Just a generic tag
 	uint				_tag = 0;
+
+	/// Can be updated in parallel with other thread safe entities
+	bool				_threadSafe = false;
 };
 
+template <class T>
+T* Entity::CreateComponent()
+{
+	if (!InParallelUpdate())
+		return ComponentContainer<Entity>::CreateComponent<T>();
+
+	// Constructors can register with world level managers, so they
+	// run under the world lock
+	std::lock_guard<std::recursive_mutex> lock(GetStructureMutex());
+	T* component = new T(*this);
+	DeferComponent(component);
+	return component;
+}
+
+template <class T>
+void Entity::RemoveComponent()
+{
+	if (!InParallelUpdate())
+	{
+		ComponentContainer<Entity>::RemoveComponent<T>();
+		return;
+	}
+
+	Defer([this]() { ComponentContainer<Entity>::RemoveComponent<T>(); });
+}
+
 }
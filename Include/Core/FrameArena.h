@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <Defines.h>
+
+namespace Osm
+{
+
+///
+/// FrameArena
+/// A linear allocator for short lived, per frame data. Allocating is a
+/// pointer bump and freeing is a no-op, all memory gets released at once
+/// when the arena is reset at the start of the frame. Each thread has its
+/// own arena, so no locking is needed.
+///
+class FrameArena
+{
+public:
+	/// Creates an arena with an initial capacity in bytes
+	explicit FrameArena(size_t capacity = 1024 * 1024);
+
+	/// Frees all the memory
+	~FrameArena();
+
+	FrameArena(const FrameArena& other) = delete;
+
+	FrameArena& operator=(const FrameArena& other) = delete;
+
+	/// Get a block of memory that is valid till the next reset
+	void* Allocate(size_t size, size_t alignment);
+
+	/// Releases all allocations. If the arena ran out of space during the
+	/// frame, it grows to fit the whole frame in a single block.
+	void Reset();
+
+	/// Bytes allocated since the last reset
+	size_t GetUsed() const						{ return _used; }
+
+	/// Most bytes used in any frame
+	size_t GetPeak() const						{ return _peak; }
+
+	/// Size of the main block
+	size_t GetCapacity() const					{ return _capacity; }
+
+	/// Arena of the calling thread. The main, worker and render threads
+	/// each have one, any other thread must not use frame memory.
+	static FrameArena& Get();
+
+	/// Sets the arena of the calling thread
+	static void SetCurrent(FrameArena* arena);
+
+private:
+	/// Falls back to a separate block once the main one is full
+	void* AllocateOverflow(size_t size, size_t alignment);
+
+	char*				_block		= nullptr;
+	size_t				_capacity	= 0;
+	size_t				_offset		= 0;
+	size_t				_used		= 0;
+	size_t				_peak		= 0;
+	std::vector<char*>	_overflow;
+};
+
+///
+/// FrameAllocator
+/// STL allocator on top of the frame arena of the thread that created it.
+/// Containers using it must not outlive the frame.
+///
+template<class T>
+class FrameAllocator
+{
+public:
+	typedef T value_type;
+
+	FrameAllocator() : _arena(&FrameArena::Get()) {}
+
+	template<class U>
+	FrameAllocator(const FrameAllocator<U>& other) : _arena(other.GetArena()) {}
+
+	T* allocate(size_t n)
+	{
+		return static_cast<T*>(_arena->Allocate(n * sizeof(T), alignof(T)));
+	}
+
+	void deallocate(T* p, size_t n) {}
+
+	FrameArena* GetArena() const				{ return _arena; }
+
+private:
+	FrameArena* _arena;
+};
+
+template<class T, class U>
+bool operator==(const FrameAllocator<T>& a, const FrameAllocator<U>& b) { return a.GetArena() == b.GetArena(); }
+
+template<class T, class U>
+bool operator!=(const FrameAllocator<T>& a, const FrameAllocator<U>& b) { return a.GetArena() != b.GetArena(); }
+
+/// A vector that lives only for the current frame
+template<class T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+}
@@ -2,9 +2,17 @@
 
 #include <Defines.h>
 #include <Core/Component.h>
+#include <Core/CommandQueue.h>
+#include <cstdlib>
 #include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
 #include <cereal/cereal.hpp>
 
+struct ImDrawList;
+
 namespace Osm
 {
 
@@ -15,6 +23,7 @@ class Profiler;
 class World;
 class InputManager;
 class AudioManager;
+class JobManager;
 
 struct GameSettings
 {	
@@ -36,6 +45,18 @@ struct GameSettings
 	std::string ResourcePath = "";
 	std::string SavePath = "";
 	std::string WindowName = "Window";
+	int WorkerThreads = -1;		// Negative picks one less than the hardware threads
+	bool PipelinedRendering = false;	// Render the last frame on its own thread while simulating the next
+	bool Headless = false;				// No window, GL context, audio or inspector
+	float FixedTimeStep = 1.0f / 60.0f;	// Simulation step when headless
+	float TickRate = 0.0f;				// Headless steps per second, zero runs as fast as possible
+	int MaxFrames = 0;					// Headless steps to run before quitting, zero runs until Quit()
+	std::string RecordInput = "";		// Records input to this file when set
+	std::string ReplayInput = "";		// Replays input from this file instead of polling when set
+	std::string CaptureTrace = "";		// Captures a profiler trace of the first frames to this file when set
+	int CaptureFrames = 60;				// Frames in a trace capture
+	float HitchThreshold = 33.3f;		// Frames slower than this, in milliseconds, count as hitches
+	std::string Budget = "";			// Headless runs fail when over budget, like "Frame:p95:16.6,Update:p99:4"
 
 protected:
 	std::string FilePath;
@@ -54,7 +75,19 @@ void GameSettings::serialize(Archive& archive)
 		CEREAL_NVP(ResourcePath),
 		CEREAL_NVP(InspectorFontSize),
 		CEREAL_NVP(SavePath),
-		CEREAL_NVP(WindowName)
+		CEREAL_NVP(WindowName),
+		CEREAL_NVP(WorkerThreads),
+		CEREAL_NVP(PipelinedRendering),
+		CEREAL_NVP(Headless),
+		CEREAL_NVP(FixedTimeStep),
+		CEREAL_NVP(TickRate),
+		CEREAL_NVP(MaxFrames),
+		CEREAL_NVP(RecordInput),
+		CEREAL_NVP(ReplayInput),
+		CEREAL_NVP(CaptureTrace),
+		CEREAL_NVP(CaptureFrames),
+		CEREAL_NVP(HitchThreshold),
+		CEREAL_NVP(Budget)
 	);
 }
 
@@ -75,6 +108,13 @@ public:
 
 	void Run();
 
+	/// Ends the game loop after the current frame
+	void Quit(int exitCode = EXIT_SUCCESS) { _quit = true; _exitCode = exitCode; }
+
+	/// What the process should exit with, a failed run sets it
+	int GetExitCode() const { return _exitCode; }
+
+	/// Not available when running headless
 	GraphicsDevice& Device() const { return *_device; }
 
 	ResourceManager& Resources() const { return *_resources; }
@@ -85,17 +125,64 @@ public:
 
 	Profiler& GetProfiler() const { return *_profiler; }
 
+	JobManager& Jobs() const { return *_jobs; }
+
 	const GameSettings& Settings() const { return _settings; }
 
 	void SwapWorld(World* world);
 
-	void QueueEvent(std::function<void(void)> e) { _event = e; }
+	/// Queues a function to run on the main thread at the start of the
+	/// next frame. Safe to call from any thread, only allocates when more
+	/// than fit in the queue are waiting.
+	template<class F>
+	void QueueEvent(F&& e);
 
 	const CTime& Time() const { return _time;  }
 
+	/// Is the last frame rendered on the render thread while the
+	/// next one gets simulated
+	bool IsPipelined() const { return _settings.PipelinedRendering && !_settings.Headless; }
+
+	/// Running without a window and GL context, like on a server
+	bool IsHeadless() const { return _settings.Headless; }
+
+	/// Blocks until the render thread is done with the frame in flight.
+	/// Only for when a lot changes at once, like swapping worlds or reloading
+	/// resources. Anything else goes through QueueRenderRelease.
+	void SyncRenderThread();
+
+	/// Queues a function to run on the thread that renders, before the
+	/// next frame. Use it for objects that can't be shared between GL
+	/// contexts, like vertex arrays and framebuffers. Never drops a command,
+	/// destroying a big world can queue more than fit in the ring.
+	template<class F>
+	void QueueRenderCommand(F&& e);
+
+	/// Like QueueRenderCommand, but waits out the frame in flight first.
+	/// Use it to release what the last extracted frame might still draw
+	/// with, without having to sync with the render thread.
+	template<class F>
+	void QueueRenderRelease(F&& e);
+
 protected:
 	void InitializeInternal();
 
+	/// Fixed step game loop without any rendering
+	void RunHeadless();
+
+	/// Entry point of the render thread
+	void RenderLoop();
+
+	/// Hands the extracted frame over to the render thread
+	void KickRender();
+
+	/// Finishes the frame in flight and joins the render thread
+	void StopRenderThread();
+
+	/// Runs every queued render command and release, only call when
+	/// nothing is rendering
+	void FlushRenderCommands();
+
 //	void Update();
 
 //	void Render();
@@ -116,13 +203,36 @@ protected:
 
 	AudioManager* _audio = nullptr;
 
+	JobManager* _jobs = nullptr;
+
 	GameSettings _settings;
 
 	bool _paused = false;
 
 	bool _advanceFrame = false;
 
-	std::function<void(void)> _event;
+	bool _quit = false;
+	int _exitCode = EXIT_SUCCESS;
+
+	CommandQueue _commands;
+
+	CommandQueue _renderCommands;
+
+	/// Releases queued during a frame, the next render runs the other one
+	CommandQueue _renderReleases[2];
+	int _releaseQueue = 0;
+
+	std::thread _renderThread;
+
+	std::mutex _renderMutex;
+
+	std::condition_variable _renderSignal;
+
+	bool _renderPending = false;	// A frame was handed over and is not done yet
+
+	bool _renderQuit = false;
+
+	void* _renderFence = nullptr;	// Uploads from the main thread the frame needs
 
 	CTime _time;
 
@@ -131,11 +241,31 @@ public:
 	void SetShowInspector(bool showInspector) { _show_inspector = showInspector; }
 private:
 	void Inspect();
+
+	/// Copies out what ImGui drew this frame, for the render thread
+	void SnapshotInspector();
+
+	/// Draws the inspector snapshot on the render thread
+	void RenderInspector();
+
+	/// ImGui's draw lists of a frame. The main thread fills one while the
+	/// render thread draws the other, they swap at the sync point.
+	struct InspectorFrame
+	{
+		std::vector<ImDrawList*>	Lists;
+		int							Count = 0;
+		float						DisplaySize[2] = {};
+		float						FramebufferScale[2] = {};
+	};
+
+	InspectorFrame _inspectorFrames[2];
+	int _inspectorFrame = 0;		// Filled by the main thread
 	bool _show_inspector = false;
 	bool _show_engine_components = false;
 	bool _show_input_debug = false;
 	bool _show_world_inspector = false;
 	bool _show_profiler = false;
+	bool _show_memory = false;
 	bool _show_imgui_test = false;
 	bool _show_settings = false;
 	//bool _close_inspector = false;	
@@ -144,4 +274,22 @@ private:
 
 extern CGame Game;
 
+template<class F>
+void CGame::QueueEvent(F&& e)
+{
+	_commands.Push(Command(std::forward<F>(e)));
+}
+
+template<class F>
+void CGame::QueueRenderCommand(F&& e)
+{
+	_renderCommands.Push(Command(std::forward<F>(e)));
+}
+
+template<class F>
+void CGame::QueueRenderRelease(F&& e)
+{
+	_renderReleases[_releaseQueue].Push(Command(std::forward<F>(e)));
+}
+
 }
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <Core/Game.h>
+#include <Core/FrameArena.h>
+#include <Tools/Memory.h>
+
+namespace Osm
+{
+
+/// Counts the jobs of a batch that are still in flight. Pass it when
+/// scheduling and wait on it to know when the whole batch is done.
+typedef std::atomic<int> JobCounter;
+
+///
+/// JobManager
+/// A small work-stealing job system. Each thread (the main thread included)
+/// owns a queue, pops from the back of its own queue and steals from the
+/// front of the others when it runs dry.
+///
+class JobManager : public Component<CGame>
+{
+public:
+	typedef std::function<void(void)> Job;
+
+	/// Starts the worker threads, count is taken from the game settings
+	JobManager(CGame& game);
+
+	/// Joins all the worker threads
+	virtual ~JobManager();
+
+	/// Queues a job on the calling thread's queue. The counter (if any)
+	/// gets incremented now and decremented once the job has finished.
+	void Schedule(Job job, JobCounter* counter = nullptr);
+
+	/// Splits the range [0, count) into batches and runs the function on
+	/// each of them in parallel. Returns when the whole range is done.
+	void ParallelFor(uint count, uint batchSize, const std::function<void(uint, uint)>& func);
+
+	/// Blocks until the counter reaches zero. The waiting thread
+	/// helps by running jobs in the mean time.
+	void Wait(JobCounter& counter);
+
+	/// Number of worker threads, not counting the main thread
+	uint GetWorkerCount() const			{ return (uint)_workers.size(); }
+
+	/// Index of the calling thread, zero for the main thread (or any thread
+	/// that is not a worker) and one and up for the workers
+	static uint GetThreadIndex();
+
+	/// Resets the frame arenas of the main thread and all workers. Must be
+	/// called when no jobs are in flight, like at the start of the frame.
+	void ResetFrameArenas();
+
+	/// Frame arena of the main thread or a worker
+	const FrameArena& GetFrameArena(uint index) const	{ return *_arenas[index]; }
+
+	/// Frame arena of the render thread, also used by the jobs it runs while
+	/// waiting. It is a frame behind the main thread, so ResetFrameArenas
+	/// leaves it alone and the render thread resets it when it starts a frame.
+	FrameArena& GetRenderArena()						{ return *_renderArena; }
+
+#ifdef INSPECTOR
+	virtual void Inspect() override;
+#endif
+
+private:
+
+	struct Entry
+	{
+		Job			Function;
+		JobCounter*	Counter;
+		MemoryTag	Tag = MEMORY_TAG_UNTAGGED;	// Allocations are charged to the scheduling subsystem
+	};
+
+	struct Queue
+	{
+		std::deque<Entry>	Jobs;
+		std::mutex			Mutex;
+		uint				Executed = 0;
+		uint				Stolen = 0;
+	};
+
+	/// Entry point of each worker thread
+	void WorkerLoop(uint index);
+
+	/// Tries to find a job, first in own queue then in the others
+	bool TryRunJob(uint index);
+
+	std::vector<std::thread>				_workers;
+	std::vector<std::unique_ptr<Queue>>		_queues;
+	std::vector<std::unique_ptr<FrameArena>>	_arenas;
+	std::unique_ptr<FrameArena>				_renderArena;
+	std::atomic<int>						_pending;
+	std::mutex								_wakeMutex;
+	std::condition_variable					_wake;
+	bool									_quit = false;
+};
+
+}
@@ -55,6 +55,14 @@ public:
 	///
 	bool Generated() const { return _generated; }
 
+	/// Returns the memory used on the CPU, in bytes
+	///
+	uint GetSize() const { return _size; }
+
+	/// Returns the memory used on the GPU, in bytes
+	///
+	uint GetGPUSize() const { return _gpuSize; }
+
 	/// A default way to create a resource ID. Resources that have more than a single parameter
 	/// (shader for example) can overload the method. The Resources class will no complie if
 	/// there is no match.
@@ -66,7 +74,7 @@ protected:
 	///
 	/// @param type the resource type of this resource.
 	///
-	Resource(ResourceType type) : _resourceID(0), _size(0), _type(type) { }
+	Resource(ResourceType type) : _resourceID(0), _size(0), _gpuSize(0), _type(type) { }
 
 	/// Protected dtor, as resources are handled by the ResourceManager.
 	virtual ~Resource() {}
@@ -85,6 +93,9 @@ protected:
 	/// Size in memory (not on disk) in bytes
 	unsigned int                _size;
 
+	/// Size in video memory in bytes
+	unsigned int                _gpuSize;
+
 	/// The type of this resource, as set by the constructor.
 	ResourceType                _type;
 
@@ -2,6 +2,7 @@
 #include <Core/Component.h>
 #include <Core/Resource.h>
 #include <Core/Game.h>
+#include <Tools/Memory.h>
 #include <unordered_map>
 
 namespace Osm
@@ -48,6 +49,7 @@ protected:
 template <typename T, typename ... Args>
 T* ResourceManager::CreateResource(Args ... args)
 {
+	MEMORY_SCOPE(MEMORY_TAG_RESOURCES);
 	T* resource = new T(args...);
 	ullong id = T::CalculateResourceID(resource->Path());
 	_resources.insert(std::make_pair(id, resource));
@@ -60,6 +62,7 @@ T* ResourceManager::CreateResource(Args ... args)
 template<typename T, typename... Args>
 T* ResourceManager::LoadResource(Args... args)
 {	
+	MEMORY_SCOPE(MEMORY_TAG_RESOURCES);
 	ullong id = T::CalculateResourceID(args...);
 
 	T* resource = GetLoadedResource<T>(id);
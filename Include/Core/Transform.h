@@ -1,8 +1,11 @@
 #pragma once
 
+#include <atomic>
 #include <Core/Component.h>
 #include <Core/Entity.h>
+#include <Core/World.h>
 #include <Math/Matrix44.h>
+#include <Math/Quaternion.h>
 
 
 namespace Osm
@@ -25,25 +28,37 @@ public:
 
 	const Vector3& GetPosition() const					{ return _position; }	
 
-	void SetPosition(const Vector3& pos)				{ _position = pos; }
+	void SetPosition(const Vector3& pos)				{ _position = pos; SetDirty(); }
 
 	const Vector3& GetScale() const						{ return _scale; }
 
-	void SetScale(const Vector3& scale)					{ _scale = scale; }
+	void SetScale(const Vector3& scale)					{ _scale = scale; SetDirty(); }
 
 	void SetUniformScale(float scale)					{ SetScale(Vector3(scale, scale, scale)); }
 
-	const Matrix44& GetOrientation() const				{ return _orientation; }
+	const Quaternion& GetRotation() const				{ return _rotation; }
 
-	void SetOrientation(const Matrix44& orientation)	{ _orientation = orientation; }
+	void SetRotation(const Quaternion& rotation)		{ _rotation = rotation; SetDirty(); }
+
+	/// Orientation as a matrix, built from the rotation
+	Matrix44 GetOrientation() const						{ return _rotation.ToMatrix(); }
+
+	/// Set the rotation from the (orthonormal) axes of the matrix
+	void SetOrientation(const Matrix44& orientation)	{ SetRotation(Quaternion::CreateFromMatrix(orientation)); }
 
 	void SetOrientation(const Vector3& x,
 						const Vector3& y,
 						const Vector3& z);
 
-	Matrix44 GetWorld() const;
+	/// Cached world matrix, only rebuilt when this or a parent has changed.
+	/// During a parallel update jobs can read each other's transforms, so
+	/// it is only read there and must not be dirty. A transform that moves
+	/// in a job gets rebuilt by World::UpdateTransforms afterwards.
+	const Matrix44& GetWorld() const;
 
-	Matrix44 GetLocal() const;
+	/// Cached local matrix, only rebuilt when this transform has changed.
+	/// Same as the world matrix, it is only read during a parallel update.
+	const Matrix44& GetLocal() const;
 
 	void SetLocal(Matrix44 view);
 
@@ -55,6 +70,14 @@ public:
 
 	ParentType GetParentType() const					{ return _parentType; }
 
+	/// Marks the local matrix dirty and the world matrix of this
+	/// transform and all its childern
+	void SetDirty();
+
+	/// Rebuilds the cached world matrix if needed. Called by the world in 
+	/// parent before child order, so the parent is always up to date.
+	void UpdateWorld() const;
+
 #ifdef INSPECTOR
 	virtual void Inspect() override;
 #endif
@@ -62,54 +85,53 @@ public:
 protected:
 	
 	Vector3					_position;
-	Matrix44				_orientation;	
+	Quaternion				_rotation;
 	Vector3					_scale;
 	Transform*				_parent;
 	std::vector<Transform*> _childern;
 	ParentType				_parentType;
+
+	/// Flags the world matrix dirty down the hierarchy. Stops at
+	/// transforms that are already dirty, as their childern are too.
+	void SetWorldDirty();
+
+	mutable Matrix44		_local;
+	mutable Matrix44		_world;
+
+	// Jobs of a parallel update can flag a child that another job reads
+	mutable std::atomic<bool>	_localDirty = { true };
+	mutable std::atomic<bool>	_worldDirty = { true };
+
+	friend class World;
+
+	/// Index in the world's list of transforms
+	uint					_worldIndex = 0;
 };
 
-inline Transform::Transform(Entity& entity)
-	: Component(entity)
-	, _parent(nullptr)
-	, _orientation()
-	, _position(0.0f, 0.0f, 0.0f)
-	, _scale(1.0f, 1.0f, 1.0f)
+inline void Transform::SetOrientation(const Vector3& x, const Vector3& y, const Vector3& z)
 {
+	Matrix44 orientation;
+	orientation.SetOrientation(x, y, z);
+	SetOrientation(orientation);
 }
 
-inline void Transform::SetOrientation(const Vector3& x, const Vector3& y, const Vector3& z)
+inline const Matrix44& Transform::GetWorld() const
 {
-	_orientation.SetOrientation(x, y, z);
+	if (_worldDirty && !GetOwner().GetWorld().InParallelUpdate())
+		UpdateWorld();
+	ASSERT(!_worldDirty);
+	return _world;
 }
 
-inline Matrix44 Transform::GetWorld() const
+inline const Matrix44& Transform::GetLocal() const
 {
-	Matrix44 world = _orientation * Matrix44::CreateScale(_scale);
-	world.SetTranslation(_position);
-
-	if (_parent)
+	if (_localDirty && !GetOwner().GetWorld().InParallelUpdate())
 	{
-		switch (_parentType)
-		{
-		case NORMAL:
-			world = _parent->GetWorld() * world;
-			break;
-		case POSITION:
-			world.SetTranslation(_position + _parent->GetWorld().GetTranslation());
-			break;
-		default:;
-		}		
+		_local = Matrix44::CreateTRS(_position, _rotation, _scale);
+		_localDirty = false;
 	}
-
-	return world;
-}
-
-inline Matrix44 Transform::GetLocal() const
-{
-	Matrix44 local = _orientation * Matrix44::CreateScale(_scale);
-	local.SetTranslation(_position);
-	return local;
+	ASSERT(!_localDirty);
+	return _local;
 }
 
 }
\ No newline at end of file
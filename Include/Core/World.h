@@ -3,11 +3,14 @@
 #include <set>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <functional>
 #include <Core/Entity.h>
 
 namespace Osm
 {
 class Entity;
+class Transform;
 
 class World : public ComponentContainer<World>
 {
@@ -38,21 +41,61 @@ public:
 	virtual void PostUpdate(float dt);
 
 	/// Generic rendering method (if the rendered is moved completely
-	/// into the engine, this can go)
+	/// into the engine, this can go). When rendering is pipelined this
+	/// runs on the render thread, so only touch the extracted state.
 	virtual void Render();
 
+	/// Takes a snapshot of everything that gets rendered. Runs on the main
+	/// thread, possibly while the previous frame is still rendering.
+	virtual void ExtractRender();
+
+	/// Makes the last snapshot the one that gets rendered. Only called
+	/// when nothing is rendering.
+	virtual void SwapRender();
+
 	/// Removes and deletes all entities in this container
 	void Clear();
 
-	/// Get the all entities of a certain type
+	/// Get the all entities of a certain type, valid for this frame only
 	template<class T>
-	std::vector<T*> GetEntitiesByType();
+	FrameVector<T*> GetEntitiesByType();
 
 	/// Get the all entities with a certain tag
 	std::vector<Entity*> GetEntitiesByTag(uint tag);
 
 	Entity* GetEntityByID(uint id);
 
+	/// When on, thread safe entities get updated on the job system
+	/// after all the other entities have been updated
+	void SetParallelUpdate(bool parallel)	{ _parallelUpdate = parallel; }
+
+	/// Are thread safe entities updated in parallel
+	bool GetParallelUpdate() const			{ return _parallelUpdate; }
+
+	/// True while thread safe entities are being updated on the job system
+	bool InParallelUpdate() const			{ return _inParallelUpdate; }
+
+	/// Queues a structural change (adding or removing components and such)
+	/// to run at the sync point after the parallel update. Outside the
+	/// parallel update the change runs right away.
+	void Defer(std::function<void(void)> change);
+
+	/// Lock that guards structural changes during a parallel update
+	std::recursive_mutex& GetStructureMutex()	{ return _structureMutex; }
+
+	/// Rebuilds all dirty world matrices in a single pass, parents before
+	/// childern. Called once per frame after the update.
+	void UpdateTransforms();
+
+	/// Used by transforms to register themselves
+	void AddTransform(Transform* transform);
+
+	/// Used by transforms to unregister themselves
+	void RemoveTransform(Transform* transform);
+
+	/// Flags the flattened hierarchy for a rebuild
+	void SetTransformsDirty()					{ _transformsDirty = true; }
+
 #ifdef INSPECTOR	
 	virtual void Inspect();
 	void InspectEntity(Entity* entity, std::set<Entity*>& inspected, uint& selected);
@@ -60,6 +103,36 @@ public:
 #endif
 
 protected:
+
+	/// Runs the function on all entities, thread safe ones in parallel
+	/// when enabled, followed by the sync point. The transforms get
+	/// updated before the parallel part.
+	void ForEachEntity(const std::function<void(Entity*)>& func);
+
+	/// Runs all deferred structural changes
+	void Sync();
+
+	/// Guards the queues and deferred changes during a parallel update
+	std::recursive_mutex			_structureMutex;
+
+	/// Structural changes waiting for the sync point
+	std::vector<std::function<void(void)>>	_deferred;
+
+	/// Update thread safe entities on the job system
+	bool							_parallelUpdate = false;
+
+	/// Set while the job system is running entity updates
+	bool							_inParallelUpdate = false;
+
+	/// All the transforms in this world, in no particular order
+	std::vector<Transform*>			_transforms;
+
+	/// Flattened hierarchy, each parent comes before its childern
+	std::vector<Transform*>			_transformOrder;
+
+	/// The hierarchy has changed since the last flattening
+	bool							_transformsDirty = true;
+
 	// Note: The order is important
 
 	/// Queue so that removing can be done form the game loop itself
@@ -75,15 +148,19 @@ protected:
 template<class T>
 inline T* World::CreateEntity()
 {
+	std::unique_lock<std::recursive_mutex> lock(_structureMutex, std::defer_lock);
+	if (_inParallelUpdate)
+		lock.lock();
+
 	T* entity = new T(*this);
 	_addQueue.push_back(std::unique_ptr<T>(entity));
 	return entity;
 }
 
 template <class T>
-inline	std::vector<T*> World::GetEntitiesByType()
+inline	FrameVector<T*> World::GetEntitiesByType()
 {
-	std::vector<T*> selection;
+	FrameVector<T*> selection;
 	for (auto& e : _entities)
 	{
 		T* found = dynamic_cast<T*>(e.get());
@@ -24,6 +24,32 @@
 	#define DEBUG_RENDER 1
 #endif
 
+// Scoped profiling is compiled out in release, unless asked for
+#ifndef PROFILING
+	#ifdef DEBUG
+		#define PROFILING 1
+	#else
+		#define PROFILING 0
+	#endif
+#endif
+
+// Hooks the global new and delete to count allocations per subsystem,
+// follows profiling unless asked for
+#ifndef MEMORY_TRACKING
+	#define MEMORY_TRACKING PROFILING
+#endif
+
+// Pick the SIMD instruction set at compile time. Define NO_SIMD
+// to fall back to the plain C++ math code.
+#ifndef NO_SIMD
+	#if defined(__AVX__)
+		#define SIMD_AVX 1
+	#endif
+	#if defined(__AVX__) || defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+		#define SIMD_SSE 1
+	#endif
+#endif
+
 
 namespace Osm
 {
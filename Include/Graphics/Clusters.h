@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+#include <Defines.h>
+#include <Math/Matrix44.h>
+#include <Graphics/Uniforms.h>
+
+namespace Osm
+{
+
+struct CameraState;
+struct LightState;
+
+///
+/// LightClusters
+/// Splits a camera's frustum into froxels, a grid of screen tiles by depth
+/// slices, and lists the point lights that reach each of them. Slices get
+/// deeper with the distance so the froxels stay roughly cube shaped. The
+/// shaders find the cluster of a position and only loop over its lights,
+/// so there is no cap on the point lights in the frame.
+///
+class LightClusters
+{
+public:
+	/// Bins the frame's point lights for a camera. Runs on the job system
+	/// and spreads the slices over the workers, never touches GL.
+	void Build(const CameraState& camera, const std::vector<LightState>& lights);
+
+	/// Point lights the camera can see, in the order the indices use
+	const std::vector<PointLightUniforms>& GetLights() const	{ return _lights; }
+
+	/// Offset and count in the indices for every froxel
+	const std::vector<ClusterUniforms>& GetClusters() const		{ return _clusters; }
+
+	/// Lights of every froxel, one froxel after the other
+	const std::vector<uint>& GetIndices() const					{ return _indices; }
+
+	/// The slice of a view depth is log(depth) * scale + bias
+	float GetSliceScale() const									{ return _sliceScale; }
+	float GetSliceBias() const									{ return _sliceBias; }
+
+private:
+	/// Lists the lights of one depth slice into its own indices
+	void BinSlice(uint slice, const Matrix44& projection);
+
+	/// View depth of the near side of a slice
+	float GetSliceDepth(uint slice) const;
+
+	std::vector<PointLightUniforms>	_lights;
+	std::vector<Vector3>			_viewCenters;		// Light positions in view space
+	std::vector<ClusterUniforms>	_clusters;
+	std::vector<uint>				_indices;
+	std::vector<uint>				_candidates[kClusterGridZ];	// Lights in a slice's depth range
+	std::vector<uint>				_sliceIndices[kClusterGridZ];
+	float							_sliceScale		= 1.0f;
+	float							_sliceBias		= 0.0f;
+};
+
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vector>
+#include <Defines.h>
+#include <Math/Matrix44.h>
+
+namespace Osm
+{
+
+///
+/// Frustum
+/// Six planes, each stored as the normal in xyz and distance in w, with
+/// the normals pointing inside.
+///
+struct Frustum
+{
+	Vector4 Planes[6];
+
+	/// Gets the planes of a projection times view matrix. Works for
+	/// orthographic projections too, like the ones shadows use.
+	static Frustum FromMatrix(const Matrix44& viewProjection);
+};
+
+///
+/// BoundsArray
+/// World space bounds of everything that might get drawn, kept in one
+/// array per component so they can be tested four at a time. Every entry
+/// has a box and a sphere around it, the tighter one gets used per plane.
+///
+class BoundsArray
+{
+public:
+	/// Removes all the bounds, keeps the memory
+	void Clear();
+
+	/// Adds bounds, returns their index
+	uint Add(const Vector3& center, const Vector3& extents, float radius);
+
+	/// Adds bounds that are never culled
+	uint AddUnbounded();
+
+	/// Number of bounds
+	uint GetCount() const { return (uint)_radius.size(); }
+
+	/// Writes 1 for every bounds that are at least partly inside the frustum
+	/// and 0 for the rest. Returns how many were culled.
+	uint Cull(const Frustum& frustum, std::vector<uchar>& visible) const;
+
+private:
+	std::vector<float>	_centerX;
+	std::vector<float>	_centerY;
+	std::vector<float>	_centerZ;
+	std::vector<float>	_extentX;
+	std::vector<float>	_extentY;
+	std::vector<float>	_extentZ;
+	std::vector<float>	_radius;
+};
+
+}
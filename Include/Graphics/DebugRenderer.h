@@ -2,6 +2,7 @@
 
 #include <Graphics/Color.h>
 #include <Graphics/Shader.h>
+#include <Graphics/StreamBuffer.h>
 #include <Math/Vector3.h>
 #include <Math/Matrix44.h>
 
@@ -11,6 +12,8 @@ namespace Osm
 ///
 /// Debug drawing in 3d space (good for testing ideas and stuff). Once a drawing
 /// max has been reached, all subsequent draw calls are silently ignored.
+/// Lines are double buffered, they get queued on the main thread and drawn
+/// from the other buffer, possibly on the render thread.
 ///
 class DebugRenderer
 {	
@@ -39,11 +42,16 @@ public:
     /// No args, for static creation
     DebugRenderer();
         
-    /// Does nothing
+    /// Expects Shutdown to have released the GL objects already
     virtual ~DebugRenderer();
 
 	/// Call to make debug draw, gets the _shader program id
 	void Initialize();
+
+	/// Queues the release of the shader, vertex array and line buffer on the
+	/// render commands. The global outlives the context, so the game calls
+	/// this on shutdown.
+	void Shutdown();
                 
     /// Queues a line segment for drawing
 	void AddLine(	uint category,
@@ -77,9 +85,13 @@ public:
     /// Queues an axis display
     void AddAxis(uint category, const Matrix44& trans, float size);
         
-    /// Clears queued actions
+    /// Clears the lines that were drawn
 	void Clear();
 
+	/// Makes the queued lines the ones to draw and starts a new queue.
+	/// Only call this when nothing is drawing.
+	void Swap();
+
 	/// Draw queue with a view projection matrix
 	void Draw(Matrix44& vp);
 
@@ -95,12 +107,16 @@ protected:
 
 	static int const		_maxLines = 4096;
 
-	int                     _linesCount;
-	VertexPosition3DColor   _vertexArray[_maxLines * 2];
+	/// Vertex arrays can't be shared between contexts, so create it where it's drawn
+	void CreateVAO();
+
+	int                     _linesCount[2];
+	VertexPosition3DColor   _vertexArray[2][_maxLines * 2];
+	int						_queue			= 0;	// Buffer that lines get added to
 
 	unique_ptr<Shader>	_shader;
 	GLuint				_vao			= 0;
-	GLuint				_linesVBO		= 0;
+	StreamBuffer		_lines;
 	ShaderAttribute*	_attribColor	= nullptr;
 	ShaderAttribute*	_attribVertex	= nullptr;
 	ShaderParameter*	_paramCamera	= nullptr;
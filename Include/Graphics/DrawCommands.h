@@ -0,0 +1,87 @@
+#pragma once
+
+#include <vector>
+#include <Defines.h>
+#include <Graphics/OpenGL.h>
+#include <Graphics/Color.h>
+
+namespace Osm
+{
+
+class Shader;
+class ShaderParameter;
+class Texture;
+class RenderProxy;
+struct Vector3;
+struct Matrix44;
+struct RenderItem;
+struct CameraState;
+struct RenderFrame;
+
+///
+/// DrawCommandBuffer
+/// Shader switches, uniform writes and draws recorded into a flat block of
+/// memory so they can be generated on any thread. Recording never touches
+/// GL, the buffer gets replayed in order on the thread that renders. Keeps
+/// its memory when cleared, so buffers can be reused every frame.
+///
+class DrawCommandBuffer
+{
+public:
+	/// Removes all the commands
+	void Clear()						{ _data.clear(); }
+
+	/// Check if anything was recorded
+	bool IsEmpty() const				{ return _data.empty(); }
+
+	/// Bytes used by the recorded commands
+	size_t GetSize() const				{ return _data.size(); }
+
+	/// Calls ActivateShader on the proxy when replayed
+	void ActivateShader(RenderProxy* proxy, const CameraState& camera, const RenderFrame& frame);
+
+	/// Activates a shader that isn't owned by a renderable
+	void UseShader(Shader* shader);
+
+	/// Uniform writes, invalid parameters don't get recorded
+	void SetValue(ShaderParameter* parameter, float value);
+	void SetValue(ShaderParameter* parameter, int value);
+	void SetValue(ShaderParameter* parameter, const Vector3& value);
+	void SetValue(ShaderParameter* parameter, const Color& value);
+	void SetValue(ShaderParameter* parameter, const Matrix44& value);
+	void SetValue(ShaderParameter* parameter, const Texture& texture);
+
+	/// Draws the item's indices, the item has to outlive the buffer
+	void Draw(const RenderItem& item);
+
+	/// Draws the item's indices count times. Returns room for count
+	/// instances of stride bytes, which has to be filled before anything
+	/// else gets recorded.
+	void* DrawInstanced(const RenderItem& item, uint count, uint stride);
+
+	/// Replays all the commands, only call from the thread that renders
+	void Execute() const;
+
+private:
+	enum CommandType
+	{
+		ACTIVATE_SHADER_COMMAND,
+		USE_SHADER_COMMAND,
+		SET_FLOAT_COMMAND,
+		SET_INT_COMMAND,
+		SET_VECTOR3_COMMAND,
+		SET_COLOR_COMMAND,
+		SET_MATRIX_COMMAND,
+		SET_TEXTURE_COMMAND,
+		DRAW_COMMAND,
+		DRAW_INSTANCED_COMMAND
+	};
+
+	/// Appends a command and extra bytes after it, returns the extra bytes
+	template<typename T>
+	uchar* Push(CommandType type, const T& command, size_t extra = 0);
+
+	std::vector<uchar> _data;
+};
+
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <Graphics/OpenGL.h>
+#include <Defines.h>
+
+namespace Osm
+{
+
+///
+/// GLStateCache
+/// Remembers the program, vertex array, buffers, textures, framebuffers and
+/// capabilities that were last set on the context and drops calls that would
+/// not change anything. Only works if all the engine code goes through it,
+/// anything that changes the state directly has to call Invalidate after.
+/// Contexts are per thread, so every thread gets its own cache.
+///
+class GLStateCache
+{
+public:
+	/// Texture units that are tracked, higher ones are always passed through
+	static const uint kTextureUnits = 16;
+
+	GLStateCache();
+
+	/// Forgets everything, the next call of every kind goes to GL
+	void Invalidate();
+
+	void UseProgram(GLuint program);
+
+	/// Binding a vertex array also changes the element array buffer binding
+	void BindVertexArray(GLuint vao);
+
+	void BindBuffer(GLenum target, GLuint buffer);
+
+	/// Makes the unit active, takes a zero based unit and not GL_TEXTUREi
+	void ActiveTexture(uint unit);
+
+	/// Binds on the active unit
+	void BindTexture(GLenum target, GLuint texture);
+
+	/// Binds on the given unit, which becomes the active one
+	void BindTexture(uint unit, GLenum target, GLuint texture);
+
+	/// Takes GL_FRAMEBUFFER for both, or GL_READ_FRAMEBUFFER or GL_DRAW_FRAMEBUFFER
+	void BindFramebuffer(GLenum target, GLuint framebuffer);
+
+	void Enable(GLenum capability);
+
+	void Disable(GLenum capability);
+
+	void SetEnabled(GLenum capability, bool enabled);
+
+	void DepthMask(bool write);
+
+	void BlendFunc(GLenum source, GLenum destination);
+
+	void Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+
+	/// Delete calls that also drop the deleted names from the cache, GL
+	/// reuses names so a stale entry could filter a needed bind
+	void DeleteProgram(GLuint program);
+	void DeleteVertexArrays(GLsizei count, const GLuint* vaos);
+	void DeleteBuffers(GLsizei count, const GLuint* buffers);
+	void DeleteTextures(GLsizei count, const GLuint* textures);
+	void DeleteFramebuffers(GLsizei count, const GLuint* framebuffers);
+
+private:
+	enum BufferTarget
+	{
+		ARRAY_BUFFER_TARGET,
+		ELEMENT_ARRAY_BUFFER_TARGET,
+		UNIFORM_BUFFER_TARGET,
+		BUFFER_TARGETS_NUM
+	};
+
+	enum TextureTarget
+	{
+		TEXTURE_2D_TARGET,
+		TEXTURE_2D_MULTISAMPLE_TARGET,
+		TEXTURE_CUBE_MAP_TARGET,
+		TEXTURE_TARGETS_NUM
+	};
+
+	enum Capability
+	{
+		CULL_FACE_CAPABILITY,
+		DEPTH_TEST_CAPABILITY,
+		BLEND_CAPABILITY,
+		SAMPLE_ALPHA_TO_COVERAGE_CAPABILITY,
+		SCISSOR_TEST_CAPABILITY,
+		CAPABILITIES_NUM
+	};
+
+	static int GetBufferTarget(GLenum target);
+	static int GetTextureTarget(GLenum target);
+	static int GetCapability(GLenum capability);
+
+	/// Counts a call that was filtered out
+	static void Filtered();
+
+	GLuint		_program;
+	GLuint		_vao;
+	GLuint		_buffers[BUFFER_TARGETS_NUM];
+	uint		_activeUnit;
+	GLuint		_textures[kTextureUnits][TEXTURE_TARGETS_NUM];
+	GLuint		_readFramebuffer;
+	GLuint		_drawFramebuffer;
+	int			_capabilities[CAPABILITIES_NUM];
+	int			_depthMask;
+	GLenum		_blendSource;
+	GLenum		_blendDestination;
+	GLint		_viewport[4];
+};
+
+/// State cache of the context current on this thread
+extern thread_local GLStateCache gGLState;
+
+}
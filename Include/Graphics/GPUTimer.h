@@ -0,0 +1,87 @@
+#pragma once
+
+#include <Graphics/OpenGL.h>
+#include <Defines.h>
+#include <cstdint>
+#include <vector>
+
+namespace Osm
+{
+
+///
+/// GPUTimer
+/// Times sections of GPU work with timestamp queries. Each frame gets its
+/// own set of queries out of a small ring, results are polled a few frames
+/// later so reading them back never stalls the pipeline. Finished sections
+/// are added to the profiler timeline. Only use from the thread that
+/// renders.
+///
+class GPUTimer
+{
+public:
+	/// Frames in flight before a frame's queries get reused
+	static const uint kFrames = 4;
+
+	/// Most sections that can be timed in a single frame
+	static const uint kMaxSections = 16;
+
+	/// A timed section of the last frame that has been read back
+	struct Result
+	{
+		const char*	Name;
+		double		Milliseconds;
+	};
+
+	GPUTimer();
+
+	/// Starts a new frame, reads back any finished frames first
+	void BeginFrame();
+
+	/// Ends the frame, nothing can be timed until the next BeginFrame
+	void EndFrame();
+
+	/// Starts timing a section, the name must be a literal. Sections can't
+	/// overlap. Returns an id to end it with.
+	uint Begin(const char* name);
+
+	/// Ends the section started with Begin
+	void End(uint section);
+
+	/// Sections of the last frame that the GPU finished
+	const std::vector<Result>& GetResults() const	{ return _results; }
+
+	/// Time from the first to the last section of the last finished frame
+	double GetFrameMilliseconds() const				{ return _frameMilliseconds; }
+
+private:
+	struct Section
+	{
+		const char*	Name;
+		bool		Ended;
+	};
+
+	struct Slot
+	{
+		GLuint		Queries[kMaxSections * 2];		// Start and end timestamp pairs
+		Section		Sections[kMaxSections];
+		uint		Count		= 0;
+		bool		Pending		= false;			// Waiting on the GPU
+		int64_t		CPUTime		= 0;				// Profiler clock at the start of the frame
+		GLint64		GPUTime		= 0;				// GPU clock at the same moment
+	};
+
+	/// Reads back the oldest frames, as long as their results are in
+	void Poll();
+
+	Slot					_slots[kFrames];
+	uint					_current		= 0;
+	bool					_created		= false;
+	bool					_recording		= false;	// Queries are issued for this frame
+	std::vector<Result>		_results;
+	double					_frameMilliseconds = 0.0;
+};
+
+/// Shared by everything that renders, like the debug renderer
+extern GPUTimer gGPUTimer;
+
+}
@@ -57,6 +57,15 @@ public:
 	/// Get the nummber of indieces
 	uint GetIndexCount() const;
 
+	/// Center of the box around the vertices, in model space
+	const Vector3& GetBoundsCenter() const { return _boundsCenter; }
+
+	/// Half the size of the box around the vertices
+	const Vector3& GetBoundsExtents() const { return _boundsExtents; }
+
+	/// Radius of the sphere around the vertices, centered on the box
+	float GetBoundsRadius() const { return _boundsRadius; }
+
 	/// Only valid if the mesh is not ready to be rendered yet
 	std::vector<VertexFormat> GetVertices() const { return _vertices; }
 
@@ -92,6 +101,12 @@ protected:
 	/// Clear 
 	void ClearGL();
 
+	/// Updates the CPU and GPU sizes of the resource
+	void UpdateSize();
+
+	/// Fits the bounds to the vertices, while they are still around
+	void UpdateBounds();
+
 	//virtual void Reload() override;
 
 	/// Mesh vertices, stored temporary when loading or creating a mesh
@@ -107,6 +122,11 @@ protected:
 	/// [0] is vertices
 	/// [1] is indices
 	GLuint						_vbo[2];
+
+	/// Model space bounds, kept after the vertices are gone
+	Vector3						_boundsCenter;
+	Vector3						_boundsExtents;
+	float						_boundsRadius = 0.0f;
 };
 
 }
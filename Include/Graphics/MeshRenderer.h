@@ -13,24 +13,16 @@ class LightShaderParameter;
 ///
 class MeshRenderer : public Renderable
 {
-public:
-	const int kMaxDirecationalLights = 5;
-	const int kMaxPointLights = 10;
-
 public:
 
 	MeshRenderer(Entity& entity);
 
-	virtual ~MeshRenderer();
-
 	Mesh* GetMesh() { return _mesh; }
 
 	void SetMesh(Mesh* mesh);
 
 	virtual void SetShader(Shader* shader) override;
 
-	GLuint GetVAO() { return _vao; }
-
 	Texture* GetTexture() { return _texture; }
 
 	void SetTexture(Texture* texture) { _texture = texture; }
@@ -43,26 +35,70 @@ public:
 
 	void SetAmbient(Color ambient) { _ambient = ambient; }
 
+	void Extract(RenderItem& item) const override;
+
+#ifdef INSPECTOR
+	void Inspect() override;
+#endif
+
+protected:
+	uint	_version = 1;		// Bumped when the mesh changes
+	Mesh*	_mesh = nullptr;
+	Texture* _texture = nullptr;
+
+	Transform* _transform = nullptr;
+	Color _diffuse;
+	Color _ambient;
+};
+
+///
+/// MeshRenderProxy
+/// Draws the items of a mesh renderer with one shader. Setting a new
+/// shader makes a new proxy, so the parameters never change under a frame.
+///
+class MeshRenderProxy : public RenderProxy
+{
+public:
+	const int kMaxDirecationalLights = 5;
+	const int kMaxPointLights = 10;		// Shaders on loose uniforms only, the others use the clusters
+
+public:
+
+	MeshRenderProxy(Shader* shader);
+
+	/// Runs on the thread that renders, like everything that touches the VAO
+	virtual ~MeshRenderProxy();
+
 	void ActivateShader(
-		Camera* camera,
-		const std::vector<Light*> lights) override;
+		const CameraState& camera,
+		const RenderFrame& frame) override;
 
-	void Draw() override;
+	void Record(
+		const RenderItem& item,
+		const CameraState& camera,
+		DrawCommandBuffer& commands) const override;
 
-	void DrawDepth(Matrix44 viewProjection) override;
+	/// True when the shader takes the per instance attributes
+	bool SupportsInstancing() const override;
 
-#ifdef INSPECTOR
-	void Inspect() override;
-#endif#endif
+	void RecordInstanced(
+		const std::vector<const RenderItem*>& items,
+		const CameraState& camera,
+		DrawCommandBuffer& commands) const override;
+
+	void RecordDepth(const RenderItem& item, DrawCommandBuffer& commands) const override;
 
+	void Bind(const RenderItem& item, const void* instances, size_t size) override;
 
 protected:
 
-	bool CreateVAO();
+	/// Vertex arrays are not shared between contexts, so this gets
+	/// called lazily from the render thread
+	bool CreateVAO(const RenderItem& item);
 
+	Shader*	_shader = nullptr;
 	GLuint	_vao = 0;
-	Mesh*	_mesh = nullptr;
-	Texture* _texture = nullptr;
+	uint	_vaoVersion = 0;	// Mesh version the vertex array was created for
 	ShaderParameter* _projParam = nullptr;
 	ShaderParameter* _modelParam = nullptr;
 	ShaderParameter* _viewParam = nullptr;
@@ -83,14 +119,23 @@ protected:
 	ShaderAttribute* _positionAttrib = nullptr;
 	ShaderAttribute* _normalAttrib = nullptr;
 	ShaderAttribute* _textureAttrib = nullptr;
+	ShaderAttribute* _instanceModelAttrib = nullptr;
+	ShaderAttribute* _instanceDiffuseAttrib = nullptr;
+	ShaderAttribute* _instanceAmbientAttrib = nullptr;
 	std::vector<std::unique_ptr<LightShaderParameter>> _dirLightParams;
 	std::vector<std::unique_ptr<LightShaderParameter>> _pointLightParams;
-
-	Transform* _transform = nullptr;
-	Matrix44 _viewMatrix;
-	Matrix44 _projectionMatrix;
-	Color _diffuse;
-	Color _ambient;
+	std::vector<ShaderParameter*> _shadowMapParams;
+
+	/// Per instance data, as laid out in the instance buffer
+	struct InstanceData
+	{
+		Matrix44	Model;
+		Color		Diffuse;
+		Color		Ambient;
+	};
+
+	/// Shared by all the proxies, refilled for every instanced draw
+	static GLuint _instanceBuffer;
 };
 
 ///
@@ -100,11 +145,12 @@ class LightShaderParameter
 {
 public:
 
-	/// Create a shader
-	LightShaderParameter(Shader* shader, const string& name);
+	/// Gets the parameters of a light, name is the hash of the element
+	/// in the lights array, like "u_pointLights[2]"
+	LightShaderParameter(Shader* shader, ParameterID name);
 
 	/// Set a light. The type will be set from the type
-	void SetValue(const Light& light);
+	void SetValue(const LightState& light);
 
 protected:
 	ShaderParameter* _positionParam;
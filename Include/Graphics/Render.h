@@ -7,6 +7,14 @@
 #include <Graphics/Color.h>
 #include <Core/Transform.h>
 #include <Graphics/Mesh.h>
+#include <Graphics/RenderQueue.h>
+#include <Graphics/DrawCommands.h>
+#include <Graphics/StreamBuffer.h>
+#include <Graphics/Culling.h>
+#include <Graphics/Clusters.h>
+#include <Graphics/Uniforms.h>
+#include <memory>
+#include <atomic>
 
 namespace Osm
 {
@@ -14,10 +22,17 @@ namespace Osm
 class Shader;
 class MeshRenderer;
 class Renderable;
+class RenderProxy;
 class Light;
 class Camera;
 class Transform;
 class RenderTarget;
+class Texture;
+struct CameraState;
+struct LightState;
+struct ShadowBuffer;
+struct RenderItem;
+struct RenderFrame;
 //class FullScreenPass;
 
 ///
@@ -31,8 +46,18 @@ public:
 
 	virtual ~RenderManager();
 
+	/// Renders the last extracted frame. When rendering is pipelined
+	/// this runs on the render thread.
 	void Render();
 
+	/// Takes a snapshot of the cameras, lights and renderables. Runs on
+	/// the main thread, possibly while the previous frame is rendering.
+	void Extract();
+
+	/// Makes the last snapshot the one that gets rendered. Only call
+	/// this when the render thread is idle.
+	void SwapFrames();
+
 	void Add(Renderable* renderable);
 
 	void Add(Light* light);
@@ -49,13 +74,23 @@ public:
 	virtual void Inspect() override;
 
 	const Camera* GetCamera() const { ASSERT(_cameras.size()); return _cameras[0]; }
-
-	int DrawCalls = 0;
-	int ShaderSwitches = 0;
 #endif
 
 protected:
 
+	/// Framebuffers can't be shared between contexts, so they are
+	/// created on the thread that renders
+	void CreateFramebuffers();
+
+	/// Fills the frame and light uniform blocks, once per frame
+	void UploadFrameUniforms(const RenderFrame& frame);
+
+	/// Fills the camera uniform block, once per camera
+	void UploadCameraUniforms(const CameraState& camera, const LightClusters& clusters);
+
+	/// Uploads a camera's point lights and clusters to the storage blocks
+	void UploadClusters(const LightClusters& clusters);
+
 	std::vector<Renderable*>	_renderables;
 	std::vector<Light*>			_lights;
 	std::vector<Camera*>		_cameras;
@@ -68,6 +103,14 @@ protected:
 	GLuint						_reslovedColorbuffer = 0;
 	GLuint						_reslovedDepthbuffer = 0;
 
+	/// Uniform blocks of the frames in flight, each upload binds its own range
+	StreamBuffer				_uniformStream;
+	size_t						_uniformAlignment = 256;
+
+	/// Light clusters of the frames in flight
+	StreamBuffer				_storageStream;
+	size_t						_storageAlignment = 256;
+
 
 	// GLuint						depthMapFBO;
 	// GLuint						depthMap;
@@ -76,22 +119,54 @@ protected:
 	Shader*						_bloomShader	= nullptr;
 	Shader*						_FXAAShader		= nullptr;
 	Shader*						_shadowPass		= nullptr;	
-	
-#ifdef 	INSPECTOR
-	enum RenderPasses
+
+	/// Double buffered snapshots, one is extracted while the other renders
+	std::unique_ptr<RenderFrame>	_frames[2];
+	int								_extractFrame	= 0;
+
+	/// A camera or a shadow casting light, culled and sorted by its own job
+	struct RenderView
 	{
-		GEOMETRY_PASS = 0,
-		LIGHT_PASS,
-		SSAO_PASS,
-		BLOOM_PASS,
-		FORWARD_PASS,
-		SHADOW_PASS,
-		RENDER_PASSES_NUM
+		const CameraState*	Camera			= nullptr;	// One of these two is set
+		const LightState*	Light			= nullptr;
+		Frustum				Frustum;
+		std::vector<uchar>	Visible;
+		RenderQueue			Queue;
+		uint				Culled			= 0;
+		LightClusters		Clusters;						// Only built for cameras
 	};
-	GLuint	_queries[RENDER_PASSES_NUM];
-	GLuint	_queryResults[RENDER_PASSES_NUM];
-	bool	_firstFrame = true;
-#endif
+
+	/// A range of one view's sorted draws, recorded by one job. Ranges never
+	/// mix layers, so the blend state can change between them.
+	struct DrawChunk
+	{
+		uint							View			= 0;
+		uint							Begin			= 0;
+		uint							End				= 0;
+		RenderLayer						Layer			= OPAQUE_LAYER;
+		DrawCommandBuffer				Commands;
+		std::vector<const RenderItem*>	Batch;			// Items that get drawn as instances
+		int								DrawCalls		= 0;
+		int								ShaderSwitches	= 0;
+		int								Instances		= 0;
+	};
+
+	/// Culls and sorts a view and bins the lights of a camera, runs on the
+	/// job system
+	void PrepareView(const RenderFrame& frame, RenderView& view) const;
+
+	/// Records the draws of a chunk, runs on the job system
+	void RecordChunk(const RenderFrame& frame, DrawChunk& chunk) const;
+
+	/// Bounds of the frame's items, shared by all the views
+	BoundsArray						_bounds;
+
+	/// Shadow views first, then the cameras. Only used on the render thread.
+	std::vector<RenderView>			_views;
+	std::vector<DrawChunk>			_chunks;
+
+	/// Looked up before recording, as getting a missing parameter adds it
+	ShaderParameter*				_shadowTransformParam = nullptr;
 };
 
 ///
@@ -131,6 +206,9 @@ public:
 	/// When deletes it will automatically get removed.
 	Renderable(Entity& entity);
 
+	/// Releases the proxy, once the frame in flight is done with it
+	virtual ~Renderable();
+
 	/// Get the shader used to render this object
 	Shader* GetShader()	{ return _shader; }
 
@@ -138,19 +216,9 @@ public:
 	/// VAOs, attributes and such, goes in this method 
 	virtual void SetShader(Shader* shader) = 0;
 
-	/// Gets called to activate a shader. Will not get called
-	/// for every Renderable, but only when switching shaders
-	virtual	void ActivateShader(
-		Camera* camera,
-		const std::vector<Light*> lights) = 0;
-
-	/// Used for the actual draw-call. Will get called
-	/// for every Renderable 
-	virtual void Draw() = 0;
-
-	/// Used for the actual draw-call. Will get called
-	/// for every Renderable 
-	virtual void DrawDepth(Matrix44 viewProjection) = 0;
+	/// Fills in everything needed to draw this renderable. Called on the
+	/// main thread, so the draw methods don't touch gameplay state.
+	virtual void Extract(RenderItem& item) const;
 
 	/// Check if this renderable casts a shadow
 	bool GetShadowCasting() const { return _castShadow; }
@@ -158,9 +226,67 @@ public:
 	/// Set if this renderable should cast a shadow
 	void SetShadowCasting(bool castShadow) { _castShadow = castShadow; }
 
+	/// Get the layer this renderable draws in
+	RenderLayer GetLayer() const { return _layer; }
+
+	/// Transparent renderables draw blended, after all the opaque ones
+	void SetLayer(RenderLayer layer) { _layer = layer; }
+
 protected:
-	Shader* _shader			= nullptr;
-	bool	_castShadow		= true;
+	/// Frames extracted from now on draw with this proxy. The old one can
+	/// still be drawing, so it gets released a frame later.
+	void SetProxy(RenderProxy* proxy);
+
+	Shader*			_shader			= nullptr;
+	RenderProxy*	_proxy			= nullptr;
+	bool			_castShadow		= true;
+	RenderLayer		_layer			= OPAQUE_LAYER;
+};
+
+///
+/// RenderProxy
+/// The part of a renderable that the thread that renders draws with. It is
+/// only read once set up, apart from the GL objects it creates for itself,
+/// so it can be swapped out or outlive its renderable while a frame is in flight.
+///
+class RenderProxy
+{
+public:
+	virtual ~RenderProxy() {}
+
+	/// Gets called to activate a shader. Will not get called
+	/// for every item, but only when switching shaders.
+	/// Called on the thread that renders, when replaying the commands.
+	virtual	void ActivateShader(
+		const CameraState& camera,
+		const RenderFrame& frame) = 0;
+
+	/// Records the uniforms and draw of an item. Gets called from the job
+	/// system, so it can only read the item and must not touch GL
+	virtual void Record(
+		const RenderItem& item,
+		const CameraState& camera,
+		DrawCommandBuffer& commands) const = 0;
+
+	/// Check if items that share shader, mesh and texture with this one
+	/// can be drawn with a single instanced draw call
+	virtual bool SupportsInstancing() const { return false; }
+
+	/// Records all the items as one draw call. Only gets called when
+	/// SupportsInstancing is true, and the items share shader, mesh and texture.
+	virtual void RecordInstanced(
+		const std::vector<const RenderItem*>& items,
+		const CameraState& camera,
+		DrawCommandBuffer& commands) const {}
+
+	/// Records the draw of an item into a shadow map, the shader and its
+	/// transform are already recorded
+	virtual void RecordDepth(const RenderItem& item, DrawCommandBuffer& commands) const = 0;
+
+	/// Makes the vertex arrays of the item current and uploads the instance
+	/// data, if there is any. Called on the thread that renders, right
+	/// before the recorded draw.
+	virtual void Bind(const RenderItem& item, const void* instances, size_t size) = 0;
 };
 
 ///
@@ -184,6 +310,9 @@ public:
 	/// Set the view matrix. This will affect the trasform of the Camera
 	void SetView(Matrix44 view);
 
+	/// Takes a snapshot for rendering
+	void Extract(CameraState& state) const;
+
 #ifdef INSPECTOR
 	virtual void Inspect() override;
 #endif
@@ -256,7 +385,7 @@ public:
 
 	void SetAttenuation(float attenuation) { _attenuation = attenuation; }
 
-	Vector3 GetDirection() const { return _transform->GetOrientation().GetZAxis(); }
+	Vector3 GetDirection() const { return _transform->GetRotation() * Vector3(0.0f, 0.0f, 1.0f); }
 
 	Vector3 GetPosition() const { return _transform->GetWorld().GetTranslation(); }
 
@@ -276,13 +405,10 @@ public:
 
 	int GetShadowResolution() const { return _shadowResolution;  }
 
-	void CreateShadowBuffer();
-
-	void DeleteShadowBuffer();
-
 	const Matrix44& GetShadowMatrix() const { return _shadowMatrix; }
 
-	const RenderTarget* GetRenderTarget() const { return _shadowTexture; }
+	/// Takes a snapshot for rendering, this also updates the shadow matrix
+	void Extract(LightState& state);
 
 #ifdef INSPECTOR
 	void Inspect() override;
@@ -303,14 +429,102 @@ protected:
 
 public:
 	bool			_castShadow			= false;
-	GLuint			_shadowMapFBO		= 0;
-	GLuint			_shadowMap			= 0;
-	RenderTarget*	_shadowTexture		= nullptr;
+	ShadowBuffer*	_shadowBuffer		= nullptr;
 	int				_shadowResolution	= 512;
 	Matrix44		_shadowMatrix;
 	Vector3			_shadowVolume		= Vector3(200.0f, 200.0f, 200.0f);
 };
 
+///
+/// ShadowBuffer
+/// Depth target of a shadow casting light. Created on the thread that
+/// renders, as framebuffers can't be shared between contexts, and released
+/// a frame after its light is gone.
+///
+struct ShadowBuffer
+{
+	GLuint					Framebuffer	= 0;
+	RenderTarget*			Target		= nullptr;
+	int						Resolution	= 0;
+	std::atomic<GLuint>		DepthMap;				// Read by the inspector
+
+	ShadowBuffer() : DepthMap(0) {}
+
+	~ShadowBuffer();
+
+	/// Creates the framebuffer again at the new resolution
+	void Create(int resolution);
+};
+
+///
+/// CameraState
+/// Snapshot of a camera, taken on the main thread
+///
+struct CameraState
+{
+	Matrix44	View;
+	Matrix44	Projection;
+	Vector3		Position;
+	float		FogNear;
+	float		FogFar;
+	float		FogGamma;
+	Color		FogNearColor;
+	Color		FogFarColor;
+	Color		ClearColor;
+};
+
+///
+/// LightState
+/// Snapshot of a light, taken on the main thread
+///
+struct LightState
+{
+	ShadowBuffer*		Shadow;
+	Light::LightType	Type;
+	Vector3				Position;
+	Vector3				Direction;
+	Vector3				Color;
+	float				Radius;
+	float				Attenuation;
+	bool				CastShadow;
+	int					ShadowResolution;
+	Matrix44			ShadowMatrix;
+};
+
+///
+/// RenderItem
+/// Snapshot of a renderable, taken on the main thread
+///
+struct RenderItem
+{
+	RenderProxy*	Proxy			= nullptr;
+	Shader*			Shader			= nullptr;
+	Matrix44		World;
+	GLuint			VertexBuffer	= 0;
+	GLuint			IndexBuffer		= 0;
+	int				IndexCount		= 0;
+	Texture*		Texture			= nullptr;
+	Color			Diffuse;
+	Color			Ambient;
+	uint			Version			= 0;
+	RenderLayer		Layer			= OPAQUE_LAYER;
+	Vector3			BoundsCenter;				// World space box and sphere,
+	Vector3			BoundsExtents;				// a negative radius is never culled
+	float			BoundsRadius	= -1.0f;
+};
+
+///
+/// RenderFrame
+/// Everything the render manager needs to draw one frame
+///
+struct RenderFrame
+{
+	std::vector<RenderItem>		Items;
+	std::vector<LightState>		Lights;
+	std::vector<CameraState>	Cameras;
+	float						Time = 0.0f;
+};
+
 inline Vector3 Light::GetColorAsVector() const
 
 { return Vector3(
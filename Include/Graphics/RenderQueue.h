@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <Defines.h>
+
+namespace Osm
+{
+
+/// Layers draw in order, each with its own sorting
+enum RenderLayer
+{
+	OPAQUE_LAYER,			// Sorted by state, then front to back
+	TRANSPARENT_LAYER,		// Sorted back to front, blended
+	RENDER_LAYERS_NUM
+};
+
+///
+/// RenderQueue
+/// A list of draws that gets sorted on a 64-bit key. The key packs the
+/// layer and the render state, so sorting groups draws that share a
+/// shader, texture and mesh. Opaque draws break ties front to back,
+/// transparent draws sort back to front before anything else.
+///
+class RenderQueue
+{
+public:
+	/// A draw, the item indexes into the frame's render items
+	struct Entry
+	{
+		uint64_t	Key;
+		uint		Item;
+	};
+
+	/// Removes all the entries, keeps the memory
+	void Clear()								{ _entries.clear(); }
+
+	void Add(uint64_t key, uint item)			{ _entries.push_back({ key, item }); }
+
+	/// Radix sorts the entries on their keys, the sort is stable
+	void Sort();
+
+	const std::vector<Entry>& GetEntries() const	{ return _entries; }
+
+	/// Packs a sort key. The ids get truncated, which only costs some
+	/// batching when two of them alias. Depth is the view space distance.
+	static uint64_t MakeKey(
+		RenderLayer layer,
+		uint shader,
+		uint texture,
+		uint mesh,
+		float depth);
+
+	/// Layer stored in a key
+	static RenderLayer GetLayer(uint64_t key)	{ return (RenderLayer)(key >> 62); }
+
+private:
+	std::vector<Entry>		_entries;
+	std::vector<Entry>		_scratch;
+};
+
+}
@@ -3,6 +3,7 @@
 #include <string>
 #include <map>
 #include <memory>
+#include <vector>
 
 #include <Graphics/OpenGL.h>
 #include <Math/Matrix44.h>
@@ -17,10 +18,23 @@ class Shader;
 class Texture;
 class Color;
 
+/// Identifies a parameter by the FNV-1a hash of its name
+typedef uint ParameterID;
+
+/// Hashes a parameter name. Continuing from a previous hash appends to
+/// that name, so "u_lights[2]" then ".color" is the same as "u_lights[2].color".
+/// Assign literals to a constexpr to get the hash at compile time.
+constexpr ParameterID HashParameter(const char* name, ParameterID hash = 2166136261u)
+{
+	return *name ? HashParameter(name + 1, (hash ^ (uchar)*name) * 16777619u) : hash;
+}
+
 ///
 /// ShaderParameter is a representation of an shader parameter.
 /// It has a type and it will complain if the type declared in the
-/// shader program is different.
+/// shader program is different. It keeps a copy of the last value set,
+/// uniforms live in the program, so setting the same value again skips
+/// the upload.
 ///
 class ShaderParameter
 {
@@ -90,6 +104,7 @@ protected:
 		this->_location = location;
 		this->_name = name;
 		this->_sampler = sampler;
+		this->_cached = false;
 	}
 
 	/// The shader should invalidate when reloading a new shader file
@@ -101,8 +116,13 @@ protected:
 		_type = 0;
 		_location = -1;
 		_sampler = -1;
+		_cached = false;
 	}
 
+	/// Stores the value and returns true when it differs from the one the
+	/// program already has, which means it needs uploading
+	bool Update(const void* value, size_t size) const;
+
 	/// The effect this parameter belongs to. Unused (beyond debugging)
 	Shader*			_shader;
 
@@ -117,6 +137,12 @@ protected:
 
 	/// Only valid for type sampler (GL_SAMPLER_2D)
 	GLint			_sampler;
+
+	/// Last value uploaded, big enough for a matrix
+	mutable float	_value[16];
+
+	/// Set once _value holds what the program has
+	mutable bool	_cached = false;
 };
 
 
@@ -230,6 +256,11 @@ public:
 	/// you will get an invalid one.
 	ShaderParameter* GetParameter(const std::string& name);
 
+	/// Get active parameter by the hash of its name, this is a lookup in
+	/// a flat table. If the parameter is not present/active you will get
+	/// an invalid one.
+	ShaderParameter* GetParameter(ParameterID id);
+
 	/// Get active attribute by name. If the attribute is not present/active
 	/// you will get an invalid one.
 	ShaderAttribute* GetAttribute(const std::string& name);
@@ -243,6 +274,10 @@ public:
 	/// Call after drawing
 	void Deactivate();
 
+	/// Check if the program reads the shared uniform blocks from Uniforms.hs,
+	/// in that case the camera, fog and lights don't need setting per shader
+	bool UsesUniformBlocks() const { return _usesUniformBlocks; }
+
 	
 	static ullong CalculateResourceID(	const std::string& vertexFilename,
 										const std::string& fragmentFilename);
@@ -268,8 +303,25 @@ private:
 
 private:
 
-	/// Store all the parameters
-	std::map<std::string, std::unique_ptr<ShaderParameter>> _parameters;
+	/// A slot in the parameters table, empty when there is no parameter
+	struct ParameterSlot
+	{
+		ParameterID							ID = 0;
+		std::unique_ptr<ShaderParameter>	Parameter;
+	};
+
+	/// Finds the slot of a parameter, or the empty slot where it would go
+	ParameterSlot& FindSlot(ParameterID id);
+
+	/// Stores a new parameter, the table grows to stay at most half full
+	ShaderParameter* AddParameter(ParameterID id, ShaderParameter* parameter);
+
+	/// Store all the parameters, open addressed on the id with linear
+	/// probing. The size is always a power of two.
+	std::vector<ParameterSlot> _parameters;
+
+	/// Number of used slots
+	uint _parameterCount = 0;
 
 	/// Store all the attributes
 	std::map<std::string, std::unique_ptr<ShaderAttribute>> _attributes;
@@ -285,6 +337,9 @@ private:
 
 	/// GL id (name) of the compiled program
 	GLuint _program = 0;
+
+	/// Set when any of the shared uniform blocks is active
+	bool _usesUniformBlocks = false;
 };
 
 }
\ No newline at end of file
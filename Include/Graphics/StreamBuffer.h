@@ -0,0 +1,72 @@
+#pragma once
+
+#include <Graphics/OpenGL.h>
+#include <Defines.h>
+
+namespace Osm
+{
+
+///
+/// StreamBuffer
+/// A buffer for data that gets rewritten every frame, like debug lines or
+/// uniform blocks. The buffer is split into a ring of regions, one per
+/// frame in flight, and every region gets a fence when the frame is done
+/// with it. Writing to a region only has to wait if the GPU is still
+/// reading it from kFrames frames ago.
+///
+/// When buffer storage is supported the whole buffer stays mapped with
+/// persistent coherent mapping. Otherwise each write maps its range
+/// unsynchronized, and a region that is still in flight orphans the
+/// buffer instead of waiting. Create, use and release it on the thread
+/// that renders.
+///
+class StreamBuffer
+{
+public:
+	/// Number of regions in the ring
+	static const uint kFrames = 3;
+
+	/// Creates the buffer with room for size bytes every frame
+	void Create(GLenum target, size_t size);
+
+	/// Deletes the buffer and its fences, nothing gets deleted on destruction
+	void Release();
+
+	/// Room to write size bytes in this frame's region, starting at an
+	/// offset that is a multiple of alignment. Returns null if the region
+	/// is full. Has to be unmapped before drawing.
+	void* Map(size_t size, size_t alignment, size_t& offset);
+
+	/// Done writing what was last mapped
+	void Unmap();
+
+	/// Fences this frame's region and moves to the next one. Call once
+	/// the draws that read this frame's data have been issued.
+	void EndFrame();
+
+	/// The buffer name, zero until created
+	GLuint GetBuffer() const		{ return _buffer; }
+
+	/// Bytes that fit in one frame's region
+	size_t GetRegionSize() const	{ return _regionSize; }
+
+	/// True when the buffer stays mapped
+	bool IsPersistent() const		{ return _persistent != nullptr; }
+
+private:
+	/// Makes sure the GPU is done with the current region before the
+	/// first write to it this frame
+	void BeginRegion();
+
+	GLenum		_target			= 0;
+	GLuint		_buffer			= 0;
+	size_t		_regionSize		= 0;
+	uint		_region			= 0;	// Region written this frame
+	size_t		_used			= 0;	// Bytes used in the region
+	bool		_begun			= false;
+	uchar*		_persistent		= nullptr;
+	bool		_mapped			= false;
+	GLsync		_fences[kFrames] = {};
+};
+
+}
@@ -1,6 +1,123 @@
 #pragma once
 
-#define vec2 Vector2
-#define vec3 Vector3
-#define vec4 Vector4
-#define 
\ No newline at end of file
+#include <Math/Matrix44.h>
+#include <Math/Vector4.h>
+#include <Defines.h>
+
+namespace Osm
+{
+
+///
+/// The C++ side of the uniform blocks in Shaders/Uniforms.hs. The layouts
+/// follow std140, so the padding here has to match the rules there: vec3
+/// and vec4 start on 16 bytes, a float can fill the gap after a vec3 and
+/// array elements and structs round up to 16 bytes. Storage blocks follow
+/// std430, which doesn't round arrays of scalars and vec2 up.
+///
+
+/// Fixed binding points, every program gets its blocks bound to these
+enum UniformBinding
+{
+	FRAME_UNIFORMS_BINDING,
+	CAMERA_UNIFORMS_BINDING,
+	LIGHT_UNIFORMS_BINDING,
+	UNIFORM_BINDINGS_NUM
+};
+
+/// Names of the blocks in the shaders, in binding order
+const char* const kUniformBlockNames[UNIFORM_BINDINGS_NUM] =
+{
+	"FrameUniforms",
+	"CameraUniforms",
+	"LightUniforms"
+};
+
+/// Fixed binding points of the shader storage blocks
+enum StorageBinding
+{
+	CLUSTER_LIGHTS_BINDING,
+	CLUSTERS_BINDING,
+	CLUSTER_INDICES_BINDING,
+	STORAGE_BINDINGS_NUM
+};
+
+/// Names of the storage blocks in the shaders, in binding order
+const char* const kStorageBlockNames[STORAGE_BINDINGS_NUM] =
+{
+	"ClusterLights",
+	"Clusters",
+	"ClusterIndices"
+};
+
+/// Directional lights each have a shadow sampler, so they stay capped
+const int kMaxDirectionalLights = 5;
+
+/// Froxels the camera frustum is split into for point lights
+const int kClusterGridX = 16;
+const int kClusterGridY = 9;
+const int kClusterGridZ = 24;
+const int kClusterCount = kClusterGridX * kClusterGridY * kClusterGridZ;
+
+/// Uploaded once per frame
+struct FrameUniforms
+{
+	float		Time;
+	float		Pad[3];
+};
+
+/// Uploaded once for every camera
+struct CameraUniforms
+{
+	Matrix44	Projection;
+	Matrix44	View;
+	Vector3		EyePos;
+	float		FogNear;
+	Vector4		FogColorNear;
+	Vector4		FogColorFar;
+	float		FogFar;
+	float		FogExp;
+	float		ClusterScale;		// Slice of a view depth is log(depth) * scale + bias
+	float		ClusterBias;
+};
+
+struct DirectionalLightUniforms
+{
+	Vector3		Direction;
+	float		Pad;
+	Vector3		Color;
+	int			CastShadow;
+	Matrix44	ShadowInvTransform;
+};
+
+/// Element of the ClusterLights storage block, std430 lays it out the same
+struct PointLightUniforms
+{
+	Vector3		Position;
+	float		Radius;
+	Vector3		Color;
+	float		Attenuation;
+};
+
+/// Uploaded once per frame, point lights go in the clusters
+struct LightUniforms
+{
+	int							DirectionalLightsCount;
+	int							Pad[3];
+	DirectionalLightUniforms	DirectionalLights[kMaxDirectionalLights];
+};
+
+/// Element of the Clusters storage block, where its lights are in ClusterIndices
+struct ClusterUniforms
+{
+	uint		Offset;
+	uint		Count;
+};
+
+static_assert(sizeof(FrameUniforms) == 16, "FrameUniforms does not match std140");
+static_assert(sizeof(CameraUniforms) == 192, "CameraUniforms does not match std140");
+static_assert(sizeof(DirectionalLightUniforms) == 96, "DirectionalLight does not match std140");
+static_assert(sizeof(PointLightUniforms) == 32, "PointLight does not match std140");
+static_assert(sizeof(LightUniforms) == 16 + 96 * kMaxDirectionalLights, "LightUniforms does not match std140");
+static_assert(sizeof(ClusterUniforms) == 8, "ClusterUniforms does not match std430");
+
+}
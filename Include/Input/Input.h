@@ -3,6 +3,7 @@
 #include <Core/Component.h>
 #include <Core/Game.h>
 #include <unordered_map>
+#include <fstream>
 //#include <GLFW/glfw3.h>
 
 namespace Osm
@@ -95,15 +96,44 @@ private:
 	};
 
 public:
+	/// Keys are indexed by GLFW key code
+	static const int kMaxKeys = 512;
+
 	InputManager(CGame& engine);
 
-	~InputManager() {}
+	~InputManager();
 
 	void Init();
 
 	void InitProfiles();
 
-	void Update();
+	/// Latches the keyboard and joysticks. Runs every frame, paused or not,
+	/// so the engine's hotkeys keep working. Does nothing during a replay,
+	/// the recording drives the input then.
+	void Poll();
+
+	/// Reads the next frame when replaying and records the frame when
+	/// recording, only call it for frames that get simulated. Returns the
+	/// delta time to simulate with, which is the recorded one during a replay.
+	float Update(float deltaTime);
+
+	/// Records input, delta times and the random seed to a file, starting
+	/// with the next update. Reseeds rand() with a fresh seed.
+	bool StartRecording(const std::string& file);
+
+	/// Flushes and closes the recording
+	void StopRecording();
+
+	/// Feeds a recording back in place of polling GLFW. Reseeds rand()
+	/// with the recorded seed.
+	bool StartReplay(const std::string& file);
+
+	/// Goes back to polling GLFW
+	void StopReplay();
+
+	bool IsRecording() const		{ return _record.is_open(); }
+
+	bool IsReplaying() const		{ return _replay.is_open(); }
 
 	/// True if down 
 	bool GetJoystickButton(Joystick joystick, JoystickButtons button);
@@ -139,10 +169,25 @@ public:
 
 private:
 	uint									_count;
+	/// Latches the state of all keys for this frame
+	void PollKeys();
+
+	/// Reads the state of the joysticks for this frame
+	void PollJoysticks();
+
+	void WriteFrame(float deltaTime);
+
+	bool ReadFrame(float& deltaTime);
+
 	std::vector<ProfileMapping>				_profiles;
 	std::unordered_map<int, JoystickState>	_joyState;	// Indexed by tokens
 	int										_nextVirtual = 256;
 	char									_keyOnce[256 + 1];
+	bool									_keys[kMaxKeys] = {};
+	bool									_recordedKeys[kMaxKeys] = {};	// Key state in the last recorded or replayed frame
+	std::ofstream							_record;
+	std::ifstream							_replay;
+	uint									_recordedFrames = 0;
 };
 
 }
@@ -1,11 +1,14 @@
 #pragma once
 
+#include <cstddef>
 #include <Math/Vector3.h>
 #include <Math/Vector4.h>
 
 namespace Osm
 {
 
+struct Quaternion;
+
 struct Matrix44
 {
 	union
@@ -83,6 +86,11 @@ struct Matrix44
 	/// Inverts this matrix
 	bool Invert();
 
+	/// Inverts a matrix made of only rotation, translation and scale along
+	/// the axes (no shear or projection), like a transform's world matrix.
+	/// Much cheaper than the general inverse.
+	void InvertRigid();
+
 	/// Transposes this matrix
 	void Transpose();
 
@@ -120,6 +128,11 @@ struct Matrix44
 
 	static Matrix44 CreateScale(Vector3 scale);
 
+	/// Creates a matrix that scales, then rotates and then translates
+	static Matrix44 CreateTRS(const Vector3& translation,
+							const Quaternion& rotation,
+							const Vector3& scale);
+
 	/// Creates a rotation matrix around an arbitrary axis
 	static Matrix44 CreateRotate(float angle, const Vector3& axis);
 
@@ -145,9 +158,30 @@ struct Matrix44
 	static Matrix44 CreateLookAt(const Vector3& eye, const Vector3& center, const Vector3& up);
 
 	/// Transfrom just the direction
-	Vector3 TransformDirectionVector(const Vector3& direction);
+	Vector3 TransformDirectionVector(const Vector3& direction) const;
 
 	Osm::Vector3 GetEulerAngles() const;
+
+	/// Transforms an array of points (w=1) by the matrix. The input
+	/// and output can be the same array.
+	static void TransformPoints(const Matrix44& mat,
+								const Vector3* in,
+								Vector3* out,
+								size_t count);
+
+	/// Transforms an array of vectors by the matrix. The input
+	/// and output can be the same array.
+	static void TransformVectors(const Matrix44& mat,
+								const Vector4* in,
+								Vector4* out,
+								size_t count);
+
+	/// Concatenates a parent matrix with an array of matrices, so that
+	/// out[i] = parent * in[i]. The input and output can be the same array.
+	static void Concatenate(const Matrix44& parent,
+							const Matrix44* in,
+							Matrix44* out,
+							size_t count);
 };
 
 }
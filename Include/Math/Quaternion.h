@@ -0,0 +1,67 @@
+#pragma once
+
+#include <Math/Vector3.h>
+
+namespace Osm
+{
+
+struct Matrix44;
+
+///
+/// A unit quaternion, used to store rotations
+///
+struct Quaternion
+{
+	union
+	{
+		// Holds all the values 
+		float f[4];
+
+		struct
+		{
+			float x;
+			float y;
+			float z;
+			float w;
+		};
+	};
+
+	/// The default constructor creates an identity rotation
+	Quaternion() : x(0.0f), y(0.0f), z(0.0f), w(1.0f) {}
+
+	/// Creates a quaternion with the given components
+	Quaternion(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+
+	/// Combines two rotations, the right side is applied first
+	Quaternion operator*(const Quaternion& q) const;
+
+	/// Rotates the vector
+	Vector3 operator*(const Vector3& v) const;
+
+	/// Dot product of the two quaternions
+	float Dot(const Quaternion& q) const		{ return x * q.x + y * q.y + z * q.z + w * q.w; }
+
+	/// Length of the quaternion, one for a rotation
+	float Magnitude() const						{ return sqrtf(Dot(*this)); }
+
+	/// Scales the quaternion back to unit length
+	void Normalize();
+
+	/// The inverse rotation (assumes unit length)
+	Quaternion Conjugate() const				{ return Quaternion(-x, -y, -z, w); }
+
+	/// Builds an orthonormal rotation matrix
+	Matrix44 ToMatrix() const;
+
+	/// Creates a rotation around an axis, angle in radians
+	static Quaternion CreateFromAxisAngle(const Vector3& axis, float angle);
+
+	/// Creates a rotation from the orientation part of a matrix.
+	/// The axes are expected to be orthonormal.
+	static Quaternion CreateFromMatrix(const Matrix44& mat);
+
+	/// Spherical interpolation, takes the shortest path
+	static Quaternion Slerp(const Quaternion& from, const Quaternion& to, float t);
+};
+
+}
@@ -310,7 +310,7 @@ public:
 	bool IsPhysicsBodyValid(PhysicsBody2D* body);
 
 	/// Get all bodies in the specified reariuis arround the given postion
-	std::vector<PhysicsBody2D*> GetInRadius(const Vector2& position, float radius);
+	FrameVector<PhysicsBody2D*> GetInRadius(const Vector2& position, float radius);
 
 	Intersection2D RayIntersect(
 		const Vector2& origin,
@@ -342,13 +342,13 @@ private:
 	void AccumulateContactsMultiGrid();
 
 	/// Get all bodies in the specified reariuis arround the given postion
-	std::vector<PhysicsBody2D*> GetInRadiusBrute(const Vector2& position, float radius);
+	FrameVector<PhysicsBody2D*> GetInRadiusBrute(const Vector2& position, float radius);
 
 	/// Get all bodies in the specified reariuis arround the given postion
-	std::vector<PhysicsBody2D*> GetInRadiusAutoGrid(const Vector2& position, float radius);
+	FrameVector<PhysicsBody2D*> GetInRadiusAutoGrid(const Vector2& position, float radius);
 
 	/// Get all bodies in the specified reariuis arround the given postion
-	std::vector<PhysicsBody2D*> GetInRadiusMultiGrid(const Vector2& position, float radius);
+	FrameVector<PhysicsBody2D*> GetInRadiusMultiGrid(const Vector2& position, float radius);
 
 	/// Call events on all entities
 	void CallOnCollisionEvent();
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+#include <Defines.h>
+
+namespace Osm
+{
+
+/// How a counter behaves between frames
+enum CounterKind
+{
+	COUNTER_PER_FRAME,		// Goes back to zero every frame, like draw calls
+	COUNTER_GAUGE			// Keeps its value till set again, like live entities
+};
+
+///
+/// CounterRegistry
+/// Named counters and gauges that any subsystem can bump from any thread.
+/// The profiler samples all of them once per frame into its history.
+///
+class CounterRegistry
+{
+public:
+	/// Most counters that can be registered
+	static const uint kMaxCounters = 64;
+
+	/// Registers a counter and returns its id. Registering the same name
+	/// twice returns the same id.
+	static uint Register(const char* name, CounterKind kind);
+
+	/// Adds to a counter
+	static void Add(uint id, int64_t value)		{ GetValue(id).fetch_add(value, std::memory_order_relaxed); }
+
+	/// Sets a counter
+	static void Set(uint id, int64_t value)		{ GetValue(id).store(value, std::memory_order_relaxed); }
+
+	/// Number of registered counters
+	static uint GetCount();
+
+	static const char* GetName(uint id);
+
+	static CounterKind GetKind(uint id);
+
+	/// Reads all the counters, in id order, and resets the per frame ones
+	static void Sample(std::vector<int64_t>& values);
+
+	/// Value of a counter at the last sample
+	static int64_t GetLast(uint id);
+
+private:
+	static std::atomic<int64_t>& GetValue(uint id);
+};
+
+///
+/// Counter
+/// A handle to a registered counter, meant to be a static in the code
+/// that bumps it.
+///
+class Counter
+{
+public:
+	explicit Counter(const char* name, CounterKind kind = COUNTER_PER_FRAME)
+		: _id(CounterRegistry::Register(name, kind)) {}
+
+	void Add(int64_t value = 1)			{ CounterRegistry::Add(_id, value); }
+
+	void Set(int64_t value)				{ CounterRegistry::Set(_id, value); }
+
+	Counter& operator++()				{ Add(1); return *this; }
+
+	Counter& operator+=(int64_t value)	{ Add(value); return *this; }
+
+	/// Value at the last time the profiler sampled it
+	int64_t GetLast() const				{ return CounterRegistry::GetLast(_id); }
+
+private:
+	uint _id;
+};
+
+}
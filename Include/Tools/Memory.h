@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <Defines.h>
+
+namespace Osm
+{
+
+/// Subsystems that heap allocations get charged to
+enum MemoryTag
+{
+	MEMORY_TAG_UNTAGGED,
+	MEMORY_TAG_PHYSICS,
+	MEMORY_TAG_RENDER,
+	MEMORY_TAG_RESOURCES,
+	MEMORY_TAG_GAMEPLAY,
+	MEMORY_TAG_AUDIO,
+	MEMORY_TAG_COUNT
+};
+
+/// Allocation numbers of all the tags at one point in time
+struct MemoryStats
+{
+	int64_t		LiveBytes[MEMORY_TAG_COUNT]		= {};	// Allocated and not yet freed
+	int64_t		FrameBytes[MEMORY_TAG_COUNT]	= {};	// Allocated during the frame
+	uint		FrameCount[MEMORY_TAG_COUNT]	= {};	// Allocations during the frame
+};
+
+///
+/// MemoryTracker
+/// Counts the heap allocations that go through the global new and delete,
+/// charged to the tag of the calling thread. The hooks are only installed
+/// when MEMORY_TRACKING is set, otherwise all the numbers stay at zero.
+///
+class MemoryTracker
+{
+public:
+	/// Sets the tag of the calling thread, returns the previous one
+	static MemoryTag SetTag(MemoryTag tag);
+
+	/// Tag of the calling thread
+	static MemoryTag GetTag();
+
+	/// Name of a tag, for display
+	static const char* GetTagName(MemoryTag tag);
+
+	/// Current numbers, then starts counting a new frame
+	static MemoryStats EndFrame();
+
+	/// Are the hooks installed
+	static bool IsEnabled()		{ return MEMORY_TRACKING != 0; }
+};
+
+///
+/// MemoryScope
+/// Charges the allocations of the enclosing scope to a tag
+///
+class MemoryScope
+{
+public:
+	explicit MemoryScope(MemoryTag tag) : _previous(MemoryTracker::SetTag(tag)) {}
+
+	~MemoryScope()								{ MemoryTracker::SetTag(_previous); }
+
+	MemoryScope(const MemoryScope&) = delete;
+
+	MemoryScope& operator=(const MemoryScope&) = delete;
+
+private:
+	MemoryTag _previous;
+};
+
+}
+
+#define MEMORY_CONCAT_INNER(a, b) a##b
+#define MEMORY_CONCAT(a, b) MEMORY_CONCAT_INNER(a, b)
+
+#if MEMORY_TRACKING
+	/// Charges the allocations in the rest of the enclosing scope to a tag
+	#define MEMORY_SCOPE(tag) Osm::MemoryScope MEMORY_CONCAT(_memoryScope, __LINE__)(tag)
+#else
+	#define MEMORY_SCOPE(tag)
+#endif
@@ -1,46 +1,248 @@
 #pragma once
 #include <Core/Game.h>
+#include <Tools/Memory.h>
+#include <Tools/Counters.h>
 #include <tchar.h>
+#include <cstdint>
+#include <string>
+#include <vector>
 
 namespace Osm
 {
 
+///
+/// Profiler
+/// Hierarchical timelines, one per thread. Each thread records scopes into
+/// its own timeline and at the end of every frame the main thread collects
+/// them into a history of the last few hundred frames.
+///
 class Profiler : public  Component<CGame>
 {
 public:
+	/// Number of frames kept in the history
+	static const uint kHistorySize = 300;
+
+	/// Most frames a budget is checked over, older ones get overwritten.
+	/// About 18 minutes at 60 fps, in 256 KB per budget.
+	static const uint kBudgetSamples = 1 << 16;
+
+	/// Frames to wait for late GPU events before writing a capture
+	static const uint kGPULatency = 5;
+
+	/// A timed scope on a single thread
+	struct Event
+	{
+		const char*		Name;		// Must outlive the profiler, literals are fine
+		int64_t			Start;		// Clock ticks
+		int64_t			End;		// Clock ticks, zero while still open
+		uint			Depth;		// Nesting level, zero at the root
+	};
+
+	/// All the events of one thread in one frame
+	struct ThreadEvents
+	{
+		uint				Thread;
+		std::vector<Event>	Events;
+	};
+
+	/// Everything recorded during one frame
+	struct Frame
+	{
+		uint						Number = 0;
+		int64_t						Start = 0;
+		int64_t						End = 0;
+		std::vector<ThreadEvents>	Threads;
+		MemoryStats					Memory;
+		std::vector<int64_t>		Counters;	// Sampled from the registry, in id order
+
+		double GetDuration() const	{ return ToSeconds(End - Start); }
+	};
+
+	/// Rolling numbers over a set of frames, in milliseconds
+	struct Stats
+	{
+		double		Mean		= 0.0;
+		double		P50			= 0.0;
+		double		P95			= 0.0;
+		double		P99			= 0.0;
+		double		Max			= 0.0;
+		uint		Hitches		= 0;	// Samples over the hitch threshold
+		uint		Samples		= 0;
+	};
+
 	Profiler(CGame& engine);
 
 	void StartFrame();
 
 	void EndFrame();
 
+	/// Opens a scope on the calling thread, for when RAII doesn't fit
 	uint StartSection(const std::string& name);
 
+	/// Closes the scope opened by StartSection
 	void EndSection(uint sectionId);
 
 	double GetTimePerFrame() const	{ return _timePerFrame;		}
 
 	double GetFPS() const;
 
+	/// Opens a scope on the calling thread's timeline
+	static void BeginEvent(const char* name);
+
+	/// Closes the innermost open scope on the calling thread's timeline
+	static void EndEvent();
+
+	/// Names the calling thread's timeline
+	static void SetThreadName(const std::string& name);
+
+	/// Name of a timeline by its thread index
+	static std::string GetThreadName(uint thread);
+
+	/// High resolution clock ticks
+	static int64_t Now();
+
+	/// Converts clock ticks to seconds
+	static double ToSeconds(int64_t ticks);
+
+	/// Converts seconds to clock ticks
+	static int64_t FromSeconds(double seconds);
+
+	/// Adds a finished GPU section, in clock ticks. These come in a few
+	/// frames late and get placed in the frame they started in.
+	static void AddGPUEvent(const char* name, int64_t start, int64_t end);
+
+	/// Number of frames in the history
+	uint GetHistoryCount() const	{ return _historyCount; }
+
+	/// A frame from the history, zero is the last completed frame
+	const Frame& GetFrame(uint framesAgo) const;
+
+	/// When paused, frames are timed but not added to the history
+	void SetPaused(bool paused)		{ _paused = paused; }
+
+	bool GetPaused() const			{ return _paused; }
+
+	/// Stats of the whole frame over the history
+	Stats GetFrameStats() const;
+
+	/// Stats of a section over the history. A section's time in a frame is
+	/// the sum of all the events with that name, on all threads.
+	Stats GetSectionStats(const std::string& name) const;
+
+	/// Frames (or sections) slower than this count as hitches
+	void SetHitchThreshold(double milliseconds)	{ _hitchThreshold = milliseconds; }
+
+	double GetHitchThreshold() const			{ return _hitchThreshold; }
+
+	/// Sets budgets that are checked over the frames from now on, up to the
+	/// last kBudgetSamples of them. The spec is a comma separated list of
+	/// section:stat:milliseconds, where stat is one of mean, p50, p95, p99
+	/// or max and "Frame" is the whole frame. For example
+	/// "Frame:p95:16.6,Update:p99:4".
+	void SetBudget(const std::string& spec);
+
+	/// Checks the budgets, the report lists every budget and how it did.
+	/// Returns false when any of them is exceeded.
+	bool CheckBudget(std::string& report) const;
+
+	/// Writes the counters of every frame in the history to a CSV file,
+	/// oldest frame first. Returns false if the file can't be written.
+	bool ExportCounters(const std::string& file) const;
+
+	/// Computes the stats of a set of samples in milliseconds, sorts them
+	static Stats ComputeStats(std::vector<float>& samples, double hitchThreshold);
+
+	/// Time in seconds spent in a section during a frame
+	static double GetSectionTime(const Frame& frame, const std::string& name);
+
+	/// Records the next few frames and writes them to a file in the Chrome
+	/// trace event format, which opens in chrome://tracing or Perfetto
+	void CaptureTrace(const std::string& file, uint frames);
+
+	bool IsCapturing() const		{ return _captureFrames > 0 || _captureDelay > 0; }
+
 #ifdef INSPECTOR
 	virtual void Inspect() override;
+
+	/// Allocations per tag, in a window of its own
+	void InspectMemory();
 #endif
 
 private:
+#ifdef INSPECTOR
+	/// Stats table and frame time distribution
+	void InspectStats(const Frame& frame, float width);
+
+	/// Counter values and their history
+	void InspectCounters(const Frame& frame, float width);
+#endif
+
+	/// Moves the events of all threads into the frame
+	void Collect(Frame& frame, int64_t end);
+
+	/// Writes the captured frames and ends the capture
+	void WriteTrace();
+
+	/// Moves the GPU events that came in to the frames they belong to
+	void PlaceGPUEvents();
 
-	struct Section
+	struct Budget
 	{
-		std::string Name;
-		double StartTime;
-		double EndTime;
+		std::string				Section;
+		std::string				Stat;
+		double					Limit;			// Milliseconds
+		std::vector<float>		Samples;		// Ring of the last kBudgetSamples frames
+		uint					Head = 0;		// Oldest sample once the ring is full
 	};
 
-	std::vector<Section>	_sections;
-	double					_frameStart;
-	double					_frameEnd;
+	std::vector<Frame>		_history;
+	Frame					_pausedFrame;		// Collected into while paused
+	uint					_historyHead		= 0;
+	uint					_historyCount		= 0;
+	uint					_frameNumber		= 0;
+	uint					_mainThread			= 0;	// Timeline of the thread running the frame
+	int64_t					_frameStart			= 0;
+	bool					_paused				= false;
+	int						_selectedFrame		= 0;	// Frames ago, for the inspector
 	double					_framePerSecond;
 	double					_timePerFrame;
 	double					_timeSinceRefresh;
+	std::string				_captureFile;
+	uint					_captureFrames		= 0;	// Frames left to capture
+	uint					_captureDelay		= 0;	// Frames left to wait for the GPU
+	std::vector<Frame>		_capture;
+	int						_inspectCaptureFrames = 60;
+	double					_hitchThreshold		= 1000.0 / 30.0;
+	std::vector<Budget>		_budgets;
+};
+
+///
+/// ProfileScope
+/// Times the enclosing scope on the calling thread
+///
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char* name)		{ Profiler::BeginEvent(name); }
+
+	~ProfileScope()								{ Profiler::EndEvent(); }
+
+	ProfileScope(const ProfileScope&) = delete;
+
+	ProfileScope& operator=(const ProfileScope&) = delete;
 };
 
 }
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#if PROFILING
+	/// Times the rest of the enclosing scope, the name must be a literal
+	#define PROFILE_SCOPE(name) Osm::ProfileScope PROFILE_CONCAT(_profileScope, __LINE__)(name)
+	/// Times the rest of the enclosing function
+	#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+#else
+	#define PROFILE_SCOPE(name)
+	#define PROFILE_FUNCTION()
+#endif
@@ -0,0 +1,45 @@
+// Planet vertex shader, Planet.vsh and PlanetInstanced.vsh pick the variant
+
+#pragma include "Osmium.glsl"
+#pragma include "NoiseTools.glsl"
+
+#define USE_RIM 0
+
+// Vertex atributes
+in vec3 a_position;
+in vec3 a_normal;
+
+#ifdef INSTANCED
+// Instance atributes, the renderer draws all the objects that share
+// this shader, mesh and texture with one draw call
+in mat4 a_instanceModel;
+in vec4 a_instanceDiffuse;
+in vec4 a_instanceAmbient;
+
+out vec3 vg_diffuse;
+out vec3 vg_ambient;
+#endif
+
+// Vertex shader outputs
+out vec3 vg_normal;
+out vec3 vg_position;
+
+void main()
+{
+#ifdef INSTANCED
+	u_model = a_instanceModel;
+	vg_diffuse = a_instanceDiffuse.rgb;
+	vg_ambient = a_instanceAmbient.rgb;
+#endif
+
+	vec3 normal = normalize((u_model * vec4(a_normal, 0.0)).xyz);
+	vec3 worldPosition = a_position;
+	float offset = sample_noise(worldPosition);
+	worldPosition += normal * offset;
+	worldPosition = (u_model * vec4(worldPosition, 1.0)).xyz;
+
+	gl_Position = u_projection * u_view * vec4(worldPosition, 1.0);
+
+  vg_normal = normal;
+  vg_position = worldPosition;
+}
@@ -22,5 +22,5 @@ int main(void)
 	Game.Run();
 	Game.Shutdown();
 
-	exit(EXIT_SUCCESS);
+	exit(Game.GetExitCode());
 }
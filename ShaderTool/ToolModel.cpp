@@ -13,16 +13,20 @@ ToolModel::ToolModel(Osm::World& world) : Entity(world)
 {
 	SetName("Model");
 
-	auto shader = Game.Resources().LoadResource<Shader>(
+	_shader = Game.Resources().LoadResource<Shader>(
 		"./Assets/Shaders/Planet.vsh",
 		"./Assets/Shaders/Planet.gsh",
 		"./Assets/Shaders/Planet.fsh");
+	_instancedShader = Game.Resources().LoadResource<Shader>(
+		"./Assets/Shaders/PlanetInstanced.vsh",
+		"./Assets/Shaders/PlanetInstanced.gsh",
+		"./Assets/Shaders/PlanetInstanced.fsh");
 	auto texture = Game.Resources().LoadResource<Texture>("./Assets/Textures/Texture.png");
 
 	_transform = CreateComponent<Transform>();
 	_renderer = CreateComponent<MeshRenderer>();
 	_renderer->SetTexture(texture);
-	_renderer->SetShader(shader);
+	_renderer->SetShader(_shader);
 	Setup();
 }
 
@@ -43,6 +47,11 @@ void ToolModel::Inspect()
 	{
 		_dirty = true;
 	}
+	// Same shader with the model and colors coming from the instance data
+	if(ImGui::Checkbox("Instanced", &_instanced))
+	{
+		_renderer->SetShader(_instanced ? _instancedShader : _shader);
+	}
 	switch (_model)
 	{
 	case Sphere:
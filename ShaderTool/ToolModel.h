@@ -27,6 +27,7 @@ private:
 
 	Model _model				= Model::Sphere;
 	bool _dirty					= false;
+	bool _instanced				= false;
 	int _sphereTesselation		= 4;
 	int _planeResolution		= 10;
 	float _size					= 1.0f;
@@ -35,4 +36,6 @@ private:
 	Osm::Mesh* _mesh				= nullptr;
 	Osm::MeshRenderer* _renderer	= nullptr;
 	Osm::Mesh* _teapot				= nullptr;
+	Osm::Shader* _shader			= nullptr;
+	Osm::Shader* _instancedShader	= nullptr;
 };
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include <Graphics/Render.h>
 #include <Graphics/MeshRenderer.h>
 #include <Graphics/Texture.h>
+#include <Graphics/GLState.h>
 #include <imgui/imgui.h>
 #include "ToolModel.h"
 
@@ -36,8 +37,8 @@ void ToolWorld::Render()
 	if(_wireframe)
 		glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
-	glEnable(GL_CULL_FACE);
-	glEnable(GL_DEPTH_TEST);
+	gGLState.Enable(GL_CULL_FACE);
+	gGLState.Enable(GL_DEPTH_TEST);
 
 	_renderManager->Render();
 
@@ -1,50 +1,23 @@
 // Geneal shader include file
 
-struct DirectionalLight
-{
-    vec3 direction;
-    vec3 color;
-    bool castShadow;
-    mat4 shadowInvTransform;
-    sampler2D shadowMap;
-};
-
-struct PointLight
-{
-    vec3 position;
-    vec3 color;
-    float radius;
-};
-
-// Uniforms
-uniform mat4 u_projection;
-uniform mat4 u_view;
-uniform mat4 u_model;
+#pragma include "Uniforms.hs"
+
+// Per draw uniforms
 uniform mat4 u_modelViewProjection;
-uniform int u_directionalLightsCount;
-uniform int u_pointLightsCount;
+#ifdef INSTANCED
+// Instanced shaders fill these in from their per instance attributes
+mat4 u_model;
+vec3 u_ambient;
+vec3 u_diffuse;
+#else
+uniform mat4 u_model;
 uniform vec3 u_ambient;
 uniform vec3 u_diffuse;
-uniform vec3 u_eyePos;
-uniform float u_fogFar;
-uniform float u_fogNear;
-uniform float u_fogExp;
-uniform float u_time;
-uniform vec4 u_fogColorNear;
-uniform vec4 u_fogColorFar;
+#endif
 
 const float kRimGamma = 4.0;
 const float kLightRadius = 5.2;
 
-// Lights
-#define DIR_LIGHT_COUNT     5
-#define POINT_LIGHT_COUNT   10
-
-// All the directional lights
-uniform DirectionalLight    u_directionalLights[DIR_LIGHT_COUNT];
-// All the point lights
-uniform PointLight          u_pointLights[POINT_LIGHT_COUNT];
-
 vec3 CalculateDirectionalLights(in vec3 normal)
 {
   vec3 color = vec3(0.0, 0.0, 0.0);
@@ -74,12 +47,12 @@ vec3 CalculateDirectionalLightsWithShadow(in vec3 position, in vec3 normal)
 
       float bias = 0.002;
 
-      float closestDepth = texture(u_directionalLights[i].shadowMap, projCoords.xy).r;   
+      float closestDepth = texture(u_directionalShadows[i].shadowMap, projCoords.xy).r;   
       float currentDepth = projCoords.z;  
       shadow = abs(currentDepth - bias) > closestDepth  ? 0.0 : 1.0;
 
 
-      //shadow = texture(u_directionalLights[i].shadowMap, projCoords.xyz);   
+      //shadow = texture(u_directionalShadows[i].shadowMap, projCoords.xyz);   
     }
 
     vec3 light_dir = u_directionalLights[i].direction;
@@ -90,21 +63,38 @@ vec3 CalculateDirectionalLightsWithShadow(in vec3 position, in vec3 normal)
   return color;
 }
 
+// Cluster a world position falls in, positions off screen use the edge ones
+uint GetCluster(in vec3 position)
+{
+  vec4 viewPosition = u_view * vec4(position, 1.0);
+  vec4 clipPosition = u_projection * viewPosition;
+  vec2 screen = (clipPosition.xy / clipPosition.w) * 0.5 + 0.5;
+  ivec2 tile = clamp(
+    ivec2(floor(screen * vec2(CLUSTER_GRID_X, CLUSTER_GRID_Y))),
+    ivec2(0, 0),
+    ivec2(CLUSTER_GRID_X - 1, CLUSTER_GRID_Y - 1));
+
+  float depth = max(-viewPosition.z, 0.0001);
+  int slice = clamp(int(floor(log(depth) * u_clusterScale + u_clusterBias)), 0, CLUSTER_GRID_Z - 1);
+  return uint(tile.x + (tile.y + slice * CLUSTER_GRID_Y) * CLUSTER_GRID_X);
+}
+
 vec3 CalculatePointLights(in vec3 position, in vec3 normal)
 {
   vec3 color = vec3(0.0, 0.0, 0.0);
 
-  for(int i = 0; i < u_pointLightsCount && i < POINT_LIGHT_COUNT; i++)
+  // Only the lights that reach this position's cluster
+  uvec2 cluster = u_clusters[GetCluster(position)];
+  for(uint i = 0u; i < cluster.y; i++)
   {
-    vec3 light_dir = u_pointLights[i].position - position;
-    float dist = length(light_dir);
+    PointLight light = u_pointLights[u_clusterIndices[cluster.x + i]];
+    vec3 light_dir = light.position - position;
+    float d = length(light_dir);
     light_dir = normalize(light_dir);
     float intensity = max(0.0, dot(normal, light_dir));
 
-    vec3 l = u_pointLights[i].position - position;
-    float d = length(l);
-    float attenuation = 1.0 - clamp((d * d) / (u_pointLights[i].radius * u_pointLights[i].radius), 0.0, 1.0);
-    color += u_pointLights[i].color * intensity * attenuation * u_diffuse;
+    float attenuation = 1.0 - clamp((d * d) / (light.radius * light.radius), 0.0, 1.0);
+    color += light.color * intensity * attenuation * u_diffuse;
   }
 
   return color;
@@ -1,6 +1,14 @@
+// Uniform blocks shared by all the shaders. Keep in sync with
+// Include/Graphics/Uniforms.h, the engine fills these once per
+// frame or camera and binds them to every program.
+
 // Lights
 #define DIR_LIGHT_COUNT     5
-#define POINT_LIGHT_COUNT   10
+
+// Froxels of the camera frustum the point lights are binned into
+#define CLUSTER_GRID_X      16
+#define CLUSTER_GRID_Y      9
+#define CLUSTER_GRID_Z      24
 
 struct DirectionalLight
 {
@@ -8,42 +16,65 @@ struct DirectionalLight
     vec3 color;
     bool castShadow;
     mat4 shadowInvTransform;
-    //sampler2D shadowMap;
 };
 
 struct PointLight
 {
     vec3 position;
-    vec3 color;
     float radius;
+    vec3 color;
+    float attenuation;
+};
+
+// Samplers can't live in a block
+struct DirectionalShadow
+{
+    sampler2D shadowMap;
 };
 
-// Uniforms
-uniform ShaderActivationUniforms
+layout(std140) uniform FrameUniforms
+{
+  float u_time;
+};
+
+layout(std140) uniform CameraUniforms
 {
   mat4 u_projection;
   mat4 u_view;
-  int u_directionalLightsCount;
-  int u_pointLightsCount;
-  vec3 u_eyePos;  
-  float u_fogFar;
+  vec3 u_eyePos;
   float u_fogNear;
-  float u_fogExp;
-  float u_time;
   vec4 u_fogColorNear;
   vec4 u_fogColorFar;
+  float u_fogFar;
+  float u_fogExp;
+  float u_clusterScale;
+  float u_clusterBias;
+};
+
+layout(std140) uniform LightUniforms
+{
+  int u_directionalLightsCount;
 
   // All the directional lights
   DirectionalLight u_directionalLights[DIR_LIGHT_COUNT];
+};
 
-  // All the point lights
-  PointLight u_pointLights[POINT_LIGHT_COUNT];
+// All the point lights the camera can see, in no particular order
+layout(std430) readonly buffer ClusterLights
+{
+  PointLight u_pointLights[];
 };
 
-uniform DrawCallUniforms
+// Offset and count in u_clusterIndices for every cluster
+layout(std430) readonly buffer Clusters
 {
-  mat4 u_model;
-  mat4 u_modelViewProjection;
-  vec3 u_ambient;
-  vec3 u_diffuse;
-};
\ No newline at end of file
+  uvec2 u_clusters[];
+};
+
+// Point lights touching each cluster, one after the other
+layout(std430) readonly buffer ClusterIndices
+{
+  uint u_clusterIndices[];
+};
+
+uniform DirectionalShadow u_directionalShadows[DIR_LIGHT_COUNT];
@@ -69,7 +69,7 @@ void Steering::CalculateWeightedSum()
 void Steering::CalculatePrioritized()
 {
 	_current.Clear();
-	vector<PhysicsBody2D*> neighbors;
+	FrameVector<PhysicsBody2D*> neighbors;
 	if (IsOn(STEERING_SEPARATION) || IsOn(STEERING_ALIGNMENT) || IsOn(STEERING_COHESION))
 	{
 		Vector2 v = _physicsBody->GetPosition();
@@ -542,9 +542,9 @@ Vector2 Steering::ObstacleAvoidance2()
 	return Vector2();
 }
 
-vector<PhysicsBody2D*> Steering::GetFlockingNeighbors()
+FrameVector<PhysicsBody2D*> Steering::GetFlockingNeighbors()
 {
-	vector<PhysicsBody2D*> neighbors;
+	FrameVector<PhysicsBody2D*> neighbors;
 	Vector2 v = _physicsBody->GetPosition();
 	neighbors = _physicsManager->GetInRadius(v, FlockingRadius);
 	if (FlockingTag != 0)
@@ -562,7 +562,7 @@ vector<PhysicsBody2D*> Steering::GetFlockingNeighbors()
 	return neighbors;
 }
 
-Vector2 Steering::Cohesion(const std::vector<PhysicsBody2D*>& agents)
+Vector2 Steering::Cohesion(const FrameVector<PhysicsBody2D*>& agents)
 {
 	Vector2 cohesion;
 
@@ -595,7 +595,7 @@ Vector2 Steering::Cohesion(const std::vector<PhysicsBody2D*>& agents)
 	return cohesion;
 }
 
-Vector2 Steering::Separation(const std::vector<PhysicsBody2D*>& agents)
+Vector2 Steering::Separation(const FrameVector<PhysicsBody2D*>& agents)
 {
 	Vector2 steeringForce;
 	
@@ -623,7 +623,7 @@ Vector2 Steering::Separation(const std::vector<PhysicsBody2D*>& agents)
 	return steeringForce;
 }
 
-Vector2 Steering::Alignment(const std::vector<PhysicsBody2D*>& agents)
+Vector2 Steering::Alignment(const FrameVector<PhysicsBody2D*>& agents)
 {
 	//This will record the average heading of the neighbors
 	Vector2 averageHeading;
@@ -4,6 +4,7 @@
 #include <fmod_errors.h>
 #include <Core/Transform.h>
 #include <Physics/Physics2D.h>
+#include <Tools/Memory.h>
 #include <imgui/imgui.h>
 
 #define VERBOSE_LEVEL 4
@@ -45,6 +46,10 @@ FMOD_VECTOR Osm::VectorToFmod(const Vector2& vector)
 
 AudioManager::AudioManager(CGame& owner) : Component(owner)
 {	
+	// No sound device on a server, every call becomes a no-op
+	if (owner.IsHeadless())
+		return;
+
 	ERRCHECK(FMOD::Studio::System::create(&_studioSystem));
 	ERRCHECK(_studioSystem->getLowLevelSystem(&_system));
 	ERRCHECK(_system->setSoftwareFormat(0, FMOD_SPEAKERMODE_5POINT1, 0));
@@ -87,12 +92,20 @@ AudioManager::AudioManager(CGame& owner) : Component(owner)
 
 AudioManager::~AudioManager()
 {
+	if (!_studioSystem)
+		return;
+
 	ERRCHECK(_studioSystem->unloadAll());
 	ERRCHECK(_studioSystem->release());
 }
 
 void AudioManager::Update(float dt)
 {
+	MEMORY_SCOPE(MEMORY_TAG_AUDIO);
+
+	if (!_studioSystem)
+		return;
+
 	// Update listener
 	if(_listener)
 	{		
@@ -140,6 +153,9 @@ void AudioManager::Update(float dt)
 void AudioManager::LoadBank(const std::string& bankName,
 							FMOD_STUDIO_LOAD_BANK_FLAGS flags)
 {
+	if (!_studioSystem)
+		return;
+
 	auto foundIt = _banks.find(bankName);
 	if (foundIt != _banks.end())
 		return;
@@ -152,6 +168,9 @@ void AudioManager::LoadBank(const std::string& bankName,
 
 void AudioManager::PlayEvent(const std::string& eventName, const Vector3& position)
 {
+	if (!_studioSystem)
+		return;
+
 	FMOD::Studio::EventDescription* description = nullptr;
 	auto found = _descriptions.find(eventName);
 	if (found != _descriptions.end())
@@ -221,6 +240,9 @@ void AudioManager::LoadEvent(const std::string& eventName)
 
 EventDescription* AudioManager::LoadDescription(const std::string& eventName)
 {
+	if (!_studioSystem)
+		return nullptr;
+
 	auto found = _descriptions.find(eventName);
 	if (found != _descriptions.end())
 		return found->second.Description;
@@ -354,27 +376,32 @@ bool AudioSource::LoadEvent(const std::string& eventPath)
 
 void AudioSource::Play() const
 {		
-	ERRCHECK(_event->start());
+	if (_event)
+		ERRCHECK(_event->start());
 }
 
 void AudioSource::SetVolume(float volume) const
 {
-	_event->setVolume(volume);
+	if (_event)
+		_event->setVolume(volume);
 }
 
 void AudioSource::SetPitch(float pitch) const
 {
-	_event->setPitch(pitch);
+	if (_event)
+		_event->setPitch(pitch);
 }
 
 void AudioSource::SetParameter(const std::string& name, float value) const
 {
-	ERRCHECK(_event->setParameterValue(name.c_str(), value));
+	if (_event)
+		ERRCHECK(_event->setParameterValue(name.c_str(), value));
 }
 
 void AudioSource::UpdatePositionalData() const
 {
-	_event->set3DAttributes(&_attributes);
+	if (_event)
+		_event->set3DAttributes(&_attributes);
 }
 
 AudioListener::AudioListener(Entity& entity) : AudioManagerComponent(entity)
@@ -73,16 +73,35 @@ GraphicsDevice::GraphicsDevice(CGame& engine) : Component(engine)
 		ASSERT(false);
 	}
 
+	// Point lights are read from storage buffers, core since 4.3 like the shaders
+	if (!GLAD_GL_ARB_shader_storage_buffer_object || !GLAD_GL_ARB_program_interface_query)
+	{
+		cout << "Shader storage buffers are not supported" << endl;
+		ASSERT(false);
+		glfwTerminate();
+		exit(EXIT_FAILURE);
+	}
+
 #ifdef DEBUG 
 	InitDebugMessages();
 #endif
 
+	if (settings.PipelinedRendering)
+	{
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+		glfwWindowHint(GLFW_SAMPLES, 0);
+		_resourceWindow = glfwCreateWindow(1, 1, "", nullptr, _window);
+		ASSERT(_resourceWindow);
+	}
+
 	glfwGetFramebufferSize(_window, &_width, &_height);
 	_ratio = _width / float(_height);
 }
 
 GraphicsDevice::~GraphicsDevice()
 {
+	if (_resourceWindow)
+		glfwDestroyWindow(_resourceWindow);
 	glfwDestroyWindow(_window);
 	glfwTerminate();
 }
@@ -1,4 +1,5 @@
 #include <Core/Entity.h>
+#include <Core/World.h>
 #include <Utils.h>
 #include <imgui.h>
 
@@ -13,6 +14,29 @@ Entity::Entity(World& world)
 	, _world(world)	
 {}
 
+bool Entity::InParallelUpdate() const
+{
+	return _world.InParallelUpdate();
+}
+
+recursive_mutex& Entity::GetStructureMutex() const
+{
+	return _world.GetStructureMutex();
+}
+
+void Entity::Defer(function<void(void)> change)
+{
+	_world.Defer(move(change));
+}
+
+void Entity::DeferComponent(Component<Entity>* component)
+{
+	_world.Defer([this, component]()
+	{
+		_components.push_back(unique_ptr<Component<Entity>>(component));
+	});
+}
+
 #ifdef INSPECTOR
 void Entity::Inspect()
 {
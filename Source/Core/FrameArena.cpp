@@ -0,0 +1,94 @@
+#include <Core/FrameArena.h>
+#include <algorithm>
+#include <cstdlib>
+
+using namespace Osm;
+using namespace std;
+
+namespace
+{
+	thread_local FrameArena* tCurrentArena = nullptr;
+
+	inline size_t AlignUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+FrameArena::FrameArena(size_t capacity)
+	: _capacity(capacity)
+{
+	_block = static_cast<char*>(malloc(_capacity));
+	ASSERT(_block);
+}
+
+FrameArena::~FrameArena()
+{
+	for (auto b : _overflow)
+		free(b);
+	free(_block);
+}
+
+void* FrameArena::Allocate(size_t size, size_t alignment)
+{
+	ASSERT((alignment & (alignment - 1)) == 0);
+
+	size_t start = AlignUp(_offset, alignment);
+	_used += size;
+	if (start + size <= _capacity)
+	{
+		_offset = start + size;
+		return _block + start;
+	}
+
+	return AllocateOverflow(size, alignment);
+}
+
+void* FrameArena::AllocateOverflow(size_t size, size_t alignment)
+{
+	// Malloc is aligned enough for anything the engine puts in here
+	ASSERT(alignment <= alignof(max_align_t));
+	char* block = static_cast<char*>(malloc(size));
+	ASSERT(block);
+	_overflow.push_back(block);
+	return block;
+}
+
+void FrameArena::Reset()
+{
+	_peak = max(_peak, _used);
+
+	if (!_overflow.empty())
+	{
+		for (auto b : _overflow)
+			free(b);
+		_overflow.clear();
+
+		// Grow so next frame fits in a single block
+		free(_block);
+		_capacity = AlignUp(_peak + _peak / 2, 4096);
+		_block = static_cast<char*>(malloc(_capacity));
+		ASSERT(_block);
+	}
+
+	_offset = 0;
+	_used = 0;
+}
+
+FrameArena& FrameArena::Get()
+{
+	if (!tCurrentArena)
+	{
+		// Nothing ever resets this one, so it would grow without bound.
+		// The engine's threads all have an arena, see JobManager.
+		ASSERT(false);
+		thread_local FrameArena fallback(64 * 1024);
+		tCurrentArena = &fallback;
+	}
+	return *tCurrentArena;
+}
+
+void FrameArena::SetCurrent(FrameArena* arena)
+{
+	tCurrentArena = arena;
+}
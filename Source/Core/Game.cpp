@@ -2,6 +2,7 @@
 #include <Core/Resources.h>
 #include <Core/World.h>
 #include <Core/Device.h>
+#include <Core/Jobs.h>
 #include <Input/Input.h>
 #include <Audio/Audio.h>
 #include <glad/glad.h>
@@ -10,8 +11,14 @@
 #include <imgui/imgui_impl_glfw_gl3.h>
 #include <imgui/IconsFontAwesome.h>
 #include <Tools/Profiler.h>
+#include <Graphics/DebugRenderer.h>
+#include <Graphics/GPUTimer.h>
+#include <Graphics/GLState.h>
 #include <cereal/archives/json.hpp>
 #include <fstream>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 
 using namespace Osm;
 using namespace std;
@@ -53,6 +60,18 @@ void GameSettings::Inspect()
 	ImGui::Checkbox("Native Resolution", &UseNativeResolution);
 	ImGui::InputInt("MSAA Samples", &MSAASamples);
 	ImGui::SliderFloat("Inspector Font Size", &InspectorFontSize, 0.5f, 2.0f);
+	ImGui::InputInt("Worker Threads", &WorkerThreads);
+	ImGui::Checkbox("Pipelined Rendering", &PipelinedRendering);
+	ImGui::Checkbox("Headless", &Headless);
+	ImGui::InputFloat("Fixed Time Step", &FixedTimeStep);
+	ImGui::InputFloat("Tick Rate", &TickRate);
+	ImGui::InputInt("Max Frames", &MaxFrames);
+	ImGui::InputInt("Capture Frames", &CaptureFrames);
+	ImGui::InputFloat("Hitch Threshold", &HitchThreshold);
+	char budget[256];
+	snprintf(budget, sizeof(budget), "%s", Budget.c_str());
+	if (ImGui::InputText("Budget", budget, sizeof(budget)))
+		Budget = budget;
 	
 	if (ImGui::Button("Save Settings"))
 	{
@@ -64,53 +83,111 @@ void CGame::InitializeInternal()
 {
 	_initialized = true;
 
+	_jobs = CreateComponent<JobManager>();
+
 	_resources = CreateComponent<ResourceManager>();		
 
-	_device = CreateComponent<GraphicsDevice>();
+	if (!IsHeadless())
+		_device = CreateComponent<GraphicsDevice>();
 
 	_input = CreateComponent<InputManager>();
 
 	_profiler = CreateComponent<Profiler>();
 
+	// Still created when headless so gameplay code can use it, it just
+	// doesn't start FMOD
 	_audio = CreateComponent<AudioManager>();
 
+	if (IsHeadless())
+		return;
+
 	ImGui_ImplGlfwGL3_Init(_device->GetWindow(), true);
+
+	if (IsPipelined())
+	{
+		// ImGui's vertex array has to live on the render thread's context,
+		// and it draws copies of the lists there instead of on Render()
+		ImGui_ImplGlfwGL3_CreateDeviceObjects();
+		ImGui::GetIO().RenderDrawListsFn = nullptr;
+
+		// The render thread takes over the window's context, the main
+		// thread keeps loading resources on a shared one
+		glfwMakeContextCurrent(_device->GetResourceWindow());
+		_renderThread = thread(&CGame::RenderLoop, this);
+	}
 }
 
 void CGame::Initialize(const GameSettings& options)
 {
 	_settings = options;
 	InitializeInternal();
-	ImGui::SetUIStyle(true, 1.0f);
+	if (!IsHeadless())
+		ImGui::SetUIStyle(true, 1.0f);
 }
 
 void CGame::Shutdown()
 {
 	ASSERT(_initialized);
 
-	// Remove component in the reverse order they were created
+	StopRenderThread();
+
+#ifdef INSPECTOR
+	for (auto& frame : _inspectorFrames)
+	{
+		for (auto list : frame.Lists)
+			delete list;
+		frame.Lists.clear();
+		frame.Count = 0;
+	}
+#endif
+
+	// Renderers queue their GL deletes, so the world goes while there still
+	// is a context to run them on
+	delete _world;
+	_world = nullptr;
+	gDebugRenderer.Shutdown();
+	FlushRenderCommands();
+
+	// Remove component in the reverse order they were created. Whatever the
+	// destructors queue runs on the main context, before the device takes it down.
 	while (_components.size() != 0)
+	{
+		if (_components.back().get() == _device)
+			FlushRenderCommands();
 		_components.erase(_components.end() - 1);
+	}
 }
 
 void CGame::Run()
 {
 	ASSERT(_initialized);
 
+	if (IsHeadless())
+	{
+		RunHeadless();
+		return;
+	}
+
 	auto lastFrame = glfwGetTime();
-	while (!glfwWindowShouldClose(_device->GetWindow()) ||
-			glfwGetKey(_device->GetWindow(), GLFW_KEY_ESCAPE))
+	while (!_quit && (!glfwWindowShouldClose(_device->GetWindow()) ||
+			glfwGetKey(_device->GetWindow(), GLFW_KEY_ESCAPE)))
 	{
 		glfwPollEvents();
 
-		if (_event)
+		// Run everything queued up to this point, from any thread
+		_commands.Execute();
+
+		// Nothing to run until a world gets swapped in
+		if (!_world)
 		{
-			_event();
-			_event = nullptr;
+			this_thread::sleep_for(chrono::milliseconds(1));
+			continue;
 		}
 
-		if (!_world)
-			continue;		
+		_profiler->StartFrame();
+
+		// Nothing from last frame is in flight, so the frame memory can go
+		_jobs->ResetFrameArenas();
 
 		auto currentFrame = glfwGetTime();
 		float deltaTime = (float)(currentFrame - lastFrame);
@@ -118,16 +195,22 @@ void CGame::Run()
 		_time.WallTime += deltaTime;
 		if (deltaTime > 0.033f)
 			deltaTime = 0.033f;
-		_time.DeltaTime = deltaTime;
-		_time.ElapsedTime += deltaTime;
+
+		// Hotkeys keep working while paused, only the simulation stops
+		_input->Poll();
 
 		// Update
 		if (!_paused || _advanceFrame)
 		{
-			_profiler->StartFrame();
 			uint updateID = _profiler->StartSection("Update");
-			_input->Update();
+
+			// A replay runs with the recorded frame times
+			deltaTime = _input->Update(deltaTime);
+			_time.DeltaTime = deltaTime;
+			_time.ElapsedTime += deltaTime;
+
 			_world->Update(deltaTime);
+			_world->UpdateTransforms();
 			uint audioID = _profiler->StartSection("Audio");
 			_audio->Update(deltaTime);
 			_profiler->EndSection(audioID);
@@ -135,21 +218,72 @@ void CGame::Run()
 			_advanceFrame = false;
 		}
 
-		_resources->Update(deltaTime);
+		{
+			PROFILE_SCOPE("Resources");
+			_resources->Update(deltaTime);
+		}
 
+#ifdef INSPECTOR
+		if (IsPipelined())
+		{
+			// Built here and drawn by the render thread along with this frame
+			PROFILE_SCOPE("Inspector");
+			Inspect();
+			SnapshotInspector();
+		}
+#endif
 
 		uint renderID = _profiler->StartSection("Render");
-		glViewport(0, 0, _device->GetScreenWidth(), _device->GetScreenHeight());				
-		_world->Render();
-		_profiler->EndSection(renderID);
+		_world->ExtractRender();
 
-		_profiler->EndFrame();
+		// The render thread is done with the last frame after this
+		{
+			PROFILE_SCOPE("Sync");
+			SyncRenderThread();
+		}
+		_world->SwapRender();
+
+		// What got released while that frame rendered goes with the next one
+		_releaseQueue = 1 - _releaseQueue;
+		gDebugRenderer.Swap();
+
+		if (IsPipelined())
+		{
+#ifdef INSPECTOR
+			_inspectorFrame = 1 - _inspectorFrame;
+#endif
+			KickRender();
+		}
+		else
+		{
+			_renderCommands.Execute();
+			_renderReleases[1 - _releaseQueue].Execute();
+			gGLState.Invalidate();
+			gGLState.Viewport(0, 0, _device->GetScreenWidth(), _device->GetScreenHeight());				
+			gGPUTimer.BeginFrame();
+			_world->Render();
+			gGPUTimer.EndFrame();
+		}
+		_profiler->EndSection(renderID);
 
+		if (!IsPipelined())
+		{
 #ifdef INSPECTOR
-		Inspect();
+			{
+				// ImGui renders on the main thread
+				PROFILE_SCOPE("Inspector");
+				Inspect();
+			}
 #endif
+			PROFILE_SCOPE("Present");
+			glfwSwapBuffers(_device->GetWindow());
+		}
+
+		_profiler->EndFrame();
 
-		glfwSwapBuffers(_device->GetWindow());
+		// Right shift + T captures a trace of the next few frames
+		if (_input->GetKey(GLFW_KEY_RIGHT_SHIFT) && _input->GetKeyOnce(GLFW_KEY_T) && !_profiler->IsCapturing())
+			_profiler->CaptureTrace(_settings.SavePath + "trace.json", (uint)max(_settings.CaptureFrames, 1));
 
 		// Escape hack
 		auto joysticks = _input->GetActiveJoysticks();
@@ -161,16 +295,188 @@ void CGame::Run()
 	}
 }
 
+void CGame::RunHeadless()
+{
+	typedef chrono::steady_clock Clock;
+
+	const float step = _settings.FixedTimeStep;
+	const auto tick = chrono::duration_cast<Clock::duration>(
+		chrono::duration<double>(_settings.TickRate > 0.0f ? 1.0 / _settings.TickRate : 0.0));
+	const auto start = Clock::now();
+	auto nextTick = start;
+	int frames = 0;
+
+	while (!_quit && (_settings.MaxFrames <= 0 || frames < _settings.MaxFrames))
+	{
+		// Run everything queued up to this point, from any thread
+		_commands.Execute();
+
+		// Nothing to run until a world gets swapped in
+		if (!_world)
+		{
+			this_thread::sleep_for(chrono::milliseconds(1));
+			continue;
+		}
+
+		_jobs->ResetFrameArenas();
+
+		_time.WallTime = chrono::duration<float>(Clock::now() - start).count();
+
+		_profiler->StartFrame();
+		uint updateID = _profiler->StartSection("Update");
+
+		// Simulation time only advances in fixed steps, or as recorded
+		_input->Poll();
+		float deltaTime = _input->Update(step);
+		_time.DeltaTime = deltaTime;
+		_time.ElapsedTime += deltaTime;
+
+		_world->Update(deltaTime);
+		_world->UpdateTransforms();
+		uint audioID = _profiler->StartSection("Audio");
+		_audio->Update(deltaTime);
+		_profiler->EndSection(audioID);
+		_profiler->EndSection(updateID);
+		_profiler->EndFrame();
+
+		// Nothing draws, so whatever got released can go right away
+		FlushRenderCommands();
+
+		frames++;
+
+		if (_settings.TickRate > 0.0f)
+		{
+			nextTick += tick;
+			this_thread::sleep_until(nextTick);
+		}
+	}
+
+	LOG("Headless run finished after %d frames in %.2f seconds", frames, _time.WallTime);
+
+	if (!_settings.Budget.empty())
+	{
+		string report;
+		bool passed = _profiler->CheckBudget(report);
+		LOG("Budget %s\n%s", passed ? "passed" : "FAILED", report.c_str());
+		if (!passed)
+			_exitCode = EXIT_FAILURE;
+	}
+}
+
 void CGame::SwapWorld(World* world)
 {
 	QueueEvent([this, world]()
 	{
+		SyncRenderThread();
 		if (_world)
 			delete _world;
 		_world = world;
 	});
 }
 
+void CGame::SyncRenderThread()
+{
+	if (!_renderThread.joinable() || this_thread::get_id() == _renderThread.get_id())
+		return;
+
+	unique_lock<mutex> lock(_renderMutex);
+	_renderSignal.wait(lock, [this]() { return !_renderPending; });
+}
+
+void CGame::KickRender()
+{
+	// Make sure everything uploaded on the main thread so far is visible
+	// to the render thread before it draws the frame
+	_renderFence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush();
+
+	{
+		lock_guard<mutex> lock(_renderMutex);
+		_renderPending = true;
+	}
+	_renderSignal.notify_all();
+}
+
+void CGame::RenderLoop()
+{
+	GLFWwindow* window = _device->GetWindow();
+	glfwMakeContextCurrent(window);
+	glfwSwapInterval(1);
+	Profiler::SetThreadName("Render");
+	FrameArena& arena = _jobs->GetRenderArena();
+	FrameArena::SetCurrent(&arena);
+
+	while (true)
+	{
+		{
+			unique_lock<mutex> lock(_renderMutex);
+			_renderSignal.wait(lock, [this]() { return _renderPending || _renderQuit; });
+			if (_renderQuit)
+				break;
+		}
+
+		{
+			PROFILE_SCOPE("Render");
+			arena.Reset();
+			GLsync fence = static_cast<GLsync>(_renderFence);
+			glWaitSync(fence, 0, GL_TIMEOUT_IGNORED);
+			glDeleteSync(fence);
+
+			// The frame these were released during is done rendering
+			_renderCommands.Execute();
+			_renderReleases[1 - _releaseQueue].Execute();
+			gGLState.Invalidate();
+			gGLState.Viewport(0, 0, _device->GetScreenWidth(), _device->GetScreenHeight());
+			gGPUTimer.BeginFrame();
+			_world->Render();
+			gGPUTimer.EndFrame();
+#ifdef INSPECTOR
+			RenderInspector();
+#endif
+		}
+		{
+			PROFILE_SCOPE("Present");
+			glfwSwapBuffers(window);
+		}
+
+		{
+			lock_guard<mutex> lock(_renderMutex);
+			_renderPending = false;
+		}
+		_renderSignal.notify_all();
+	}
+
+	FlushRenderCommands();
+	glFinish();
+	glfwMakeContextCurrent(nullptr);
+	FrameArena::SetCurrent(nullptr);
+}
+
+void CGame::StopRenderThread()
+{
+	if (!_renderThread.joinable())
+		return;
+
+	SyncRenderThread();
+	{
+		lock_guard<mutex> lock(_renderMutex);
+		_renderQuit = true;
+	}
+	_renderSignal.notify_all();
+	_renderThread.join();
+
+	// Whatever gets released from here on is deleted on the main context
+	glfwMakeContextCurrent(_device->GetWindow());
+	FlushRenderCommands();
+}
+
+void CGame::FlushRenderCommands()
+{
+	_renderCommands.Execute();
+	_renderReleases[1 - _releaseQueue].Execute();
+	_renderReleases[_releaseQueue].Execute();
+}
+
 #ifdef INSPECTOR
 void CGame::Inspect()
 {		
@@ -197,6 +503,7 @@ void CGame::Inspect()
 		ImGui::MenuItem("World", nullptr, &_show_world_inspector);
 		ImGui::MenuItem("Settings", nullptr, &_show_settings);
 		ImGui::MenuItem("Profiler", nullptr, &_show_profiler);
+		ImGui::MenuItem("Memory", nullptr, &_show_memory);
 #if SHOW_IMGUI
 		ImGui::MenuItem("ImGui Test", nullptr, &_show_imgui_test);
 #endif
@@ -241,6 +548,11 @@ void CGame::Inspect()
 		_profiler->Inspect();
 	}
 
+	if (_show_memory)
+	{
+		_profiler->InspectMemory();
+	}
+
 	if (_show_imgui_test)
 	{
 		ImGui::SetNextWindowPos(ImVec2(650, 20), ImGuiSetCond_FirstUseEver);
@@ -271,6 +583,66 @@ void CGame::Inspect()
 
 	ImGui::Render();	
 }
+
+namespace
+{
+	template<class T>
+	void CopyImVector(ImVector<T>& to, const ImVector<T>& from)
+	{
+		to.resize(from.Size);
+		if (from.Size > 0)
+			memcpy(to.Data, from.Data, from.Size * sizeof(T));
+	}
+}
+
+void CGame::SnapshotInspector()
+{
+	// ImGui reuses its lists next frame, so they get copied out. The lists
+	// of the snapshot are kept and only grow.
+	InspectorFrame& frame = _inspectorFrames[_inspectorFrame];
+	ImDrawData* data = _show_inspector ? ImGui::GetDrawData() : nullptr;
+	frame.Count = data ? data->CmdListsCount : 0;
+	while ((int)frame.Lists.size() < frame.Count)
+		frame.Lists.push_back(new ImDrawList());
+
+	for (int i = 0; i < frame.Count; i++)
+	{
+		const ImDrawList& from = *data->CmdLists[i];
+		ImDrawList& to = *frame.Lists[i];
+		CopyImVector(to.CmdBuffer, from.CmdBuffer);
+		CopyImVector(to.IdxBuffer, from.IdxBuffer);
+		CopyImVector(to.VtxBuffer, from.VtxBuffer);
+	}
+
+	const ImGuiIO& io = ImGui::GetIO();
+	frame.DisplaySize[0] = io.DisplaySize.x;
+	frame.DisplaySize[1] = io.DisplaySize.y;
+	frame.FramebufferScale[0] = io.DisplayFramebufferScale.x;
+	frame.FramebufferScale[1] = io.DisplayFramebufferScale.y;
+}
+
+void CGame::RenderInspector()
+{
+	// The main thread is filling the other one by now
+	InspectorFrame& frame = _inspectorFrames[1 - _inspectorFrame];
+	if (frame.Count == 0)
+		return;
+
+	PROFILE_SCOPE("Inspector");
+	ImDrawData data;
+	data.Valid = true;
+	data.CmdLists = frame.Lists.data();
+	data.CmdListsCount = frame.Count;
+	for (int i = 0; i < frame.Count; i++)
+	{
+		data.TotalVtxCount += frame.Lists[i]->VtxBuffer.Size;
+		data.TotalIdxCount += frame.Lists[i]->IdxBuffer.Size;
+	}
+	ImGui_ImplGlfwGL3_RenderDrawData(
+		&data,
+		ImVec2(frame.DisplaySize[0], frame.DisplaySize[1]),
+		ImVec2(frame.FramebufferScale[0], frame.FramebufferScale[1]));
+}
 #endif
 
 
@@ -0,0 +1,210 @@
+#include <Core/Jobs.h>
+#include <Tools/Profiler.h>
+#include <imgui.h>
+#include <algorithm>
+
+using namespace Osm;
+using namespace std;
+
+namespace
+{
+	thread_local uint tThreadIndex = 0;
+}
+
+JobManager::JobManager(CGame& game)
+	: Component(game)
+	, _pending(0)
+{
+	int workers = game.Settings().WorkerThreads;
+	if (workers < 0)
+		workers = max((int)thread::hardware_concurrency() - 1, 0);
+
+	// One queue and frame arena for the main thread and for each worker
+	for (int i = 0; i < workers + 1; i++)
+	{
+		_queues.push_back(make_unique<Queue>());
+		_arenas.push_back(make_unique<FrameArena>());
+	}
+	FrameArena::SetCurrent(_arenas[0].get());
+	_renderArena = make_unique<FrameArena>();
+
+	for (int i = 0; i < workers; i++)
+		_workers.push_back(thread(&JobManager::WorkerLoop, this, i + 1));
+
+	LOG("Job system started with %d worker threads", workers);
+}
+
+JobManager::~JobManager()
+{
+	{
+		lock_guard<mutex> lock(_wakeMutex);
+		_quit = true;
+	}
+	_wake.notify_all();
+
+	for (auto& w : _workers)
+		w.join();
+
+	FrameArena::SetCurrent(nullptr);
+}
+
+void JobManager::Schedule(Job job, JobCounter* counter)
+{
+	if (counter)
+		++(*counter);
+
+	uint index = GetThreadIndex();
+	if (index >= _queues.size())
+		index = 0;
+
+	{
+		auto& queue = *_queues[index];
+		lock_guard<mutex> lock(queue.Mutex);
+		queue.Jobs.push_back({ move(job), counter, MemoryTracker::GetTag() });
+	}
+
+	++_pending;
+	{
+		// Taking the lock makes sure a worker can't miss the notification
+		// between checking the pending count and going to sleep
+		lock_guard<mutex> lock(_wakeMutex);
+	}
+	_wake.notify_one();
+}
+
+void JobManager::ParallelFor(
+	uint count,
+	uint batchSize,
+	const function<void(uint, uint)>& func)
+{
+	if (count == 0)
+		return;
+
+	batchSize = max(batchSize, 1u);
+	if (_workers.empty() || count <= batchSize)
+	{
+		func(0, count);
+		return;
+	}
+
+	JobCounter counter(0);
+	for (uint begin = 0; begin < count; begin += batchSize)
+	{
+		uint end = min(begin + batchSize, count);
+		Schedule([&func, begin, end]() { func(begin, end); }, &counter);
+	}
+	Wait(counter);
+}
+
+void JobManager::Wait(JobCounter& counter)
+{
+	uint index = GetThreadIndex();
+	while (counter.load() > 0)
+	{
+		if (!TryRunJob(index))
+			this_thread::yield();
+	}
+}
+
+uint JobManager::GetThreadIndex()
+{
+	return tThreadIndex;
+}
+
+void JobManager::ResetFrameArenas()
+{
+	for (auto& a : _arenas)
+		a->Reset();
+}
+
+void JobManager::WorkerLoop(uint index)
+{
+	tThreadIndex = index;
+	FrameArena::SetCurrent(_arenas[index].get());
+	Profiler::SetThreadName("Worker " + to_string(index));
+
+	while (true)
+	{
+		if (TryRunJob(index))
+			continue;
+
+		unique_lock<mutex> lock(_wakeMutex);
+		_wake.wait(lock, [this]() { return _quit || _pending.load() > 0; });
+		if (_quit)
+			return;
+	}
+}
+
+bool JobManager::TryRunJob(uint index)
+{
+	if (index >= _queues.size())
+		index = 0;
+
+	Entry entry;
+	bool found = false;
+
+	// Own queue first, newest job first as it is likely still in cache
+	{
+		auto& own = *_queues[index];
+		lock_guard<mutex> lock(own.Mutex);
+		if (!own.Jobs.empty())
+		{
+			entry = move(own.Jobs.back());
+			own.Jobs.pop_back();
+			own.Executed++;
+			found = true;
+		}
+	}
+
+	// Steal the oldest job from one of the others
+	for (size_t i = 1; !found && i < _queues.size(); i++)
+	{
+		auto& victim = *_queues[(index + i) % _queues.size()];
+		lock_guard<mutex> lock(victim.Mutex);
+		if (!victim.Jobs.empty())
+		{
+			entry = move(victim.Jobs.front());
+			victim.Jobs.pop_front();
+			victim.Stolen++;
+			found = true;
+		}
+	}
+
+	if (!found)
+		return false;
+
+	--_pending;
+	{
+		PROFILE_SCOPE("Job");
+		MemoryScope tag(entry.Tag);
+		entry.Function();
+	}
+	if (entry.Counter)
+		--(*entry.Counter);
+
+	return true;
+}
+
+#ifdef INSPECTOR
+void JobManager::Inspect()
+{
+	ImGui::Text("Worker Threads: %d", (int)_workers.size());
+	ImGui::Text("Pending Jobs: %d", _pending.load());
+	for (size_t i = 0; i < _queues.size(); i++)
+	{
+		auto& queue = *_queues[i];
+		auto& arena = *_arenas[i];
+		lock_guard<mutex> lock(queue.Mutex);
+		ImGui::Text("%s %d - Executed: %d Stolen: %d Arena: %d/%d KB",
+			i == 0 ? "Main" : "Worker",
+			(int)i,
+			queue.Executed,
+			queue.Stolen,
+			(int)(arena.GetPeak() / 1024),
+			(int)(arena.GetCapacity() / 1024));
+	}
+	ImGui::Text("Render - Arena: %d/%d KB",
+		(int)(_renderArena->GetPeak() / 1024),
+		(int)(_renderArena->GetCapacity() / 1024));
+}
+#endif
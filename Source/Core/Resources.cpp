@@ -1,12 +1,18 @@
 #include <Core/Resources.h>
 #include <Defines.h>
 #include <imgui/imgui.h>
+#include <Tools/Counters.h>
 
 
 const float kAutoReloadTime = 2.0f;
 
 using namespace Osm;
 
+namespace
+{
+	Counter gLiveResources("Live Resources", COUNTER_GAUGE);
+}
+
 void ResourceManager::ReleaseResource(Resource* res)
 {
 	if(!res)
@@ -32,6 +38,10 @@ void ResourceManager::ReleaseResource(Resource* res)
 
 void ResourceManager::Update(float dt)
 {
+	MEMORY_SCOPE(MEMORY_TAG_RESOURCES);
+
+	gLiveResources.Set((int64_t)_resources.size());
+
 #ifdef INSPECTOR
 	for (auto& itr : _resources)
 	{
@@ -43,6 +53,7 @@ void ResourceManager::Update(float dt)
 
 		if (r->QueueReload)
 		{
+			Game.SyncRenderThread();
 			r->Reload();
 			r->Reloaded = true;
 			r->QueueReload = false;
@@ -53,6 +64,7 @@ void ResourceManager::Update(float dt)
 			r->ReloadTimer += dt;
 			if(r->ReloadTimer > kAutoReloadTime)
 			{
+				Game.SyncRenderThread();
 				r->Reload();
 				r->Reloaded = true;
 				r->ReloadTimer = 0.0f;
@@ -74,6 +86,14 @@ void ResourceManager::Inspect()
 	ImGui::CheckboxFlags("Textures", &FilterFlags, RESOURCE_TYPE_TEXTURE); ImGui::SameLine();
 	ImGui::CheckboxFlags("Shaders", &FilterFlags, RESOURCE_TYPE_SHADER); ImGui::SameLine();
 	ImGui::Checkbox("Generated", &ShowGenerated);
+
+	uint64_t cpuTotal = 0, gpuTotal = 0;
+	for (auto& itr : _resources)
+	{
+		cpuTotal += itr.second->GetSize();
+		gpuTotal += itr.second->GetGPUSize();
+	}
+	ImGui::Text("CPU: %.1f KB GPU: %.1f KB", cpuTotal / 1024.0, gpuTotal / 1024.0);
 	
 	static ImGuiTextFilter filter;
 	filter.Draw();
@@ -100,6 +120,11 @@ void ResourceManager::Inspect()
 			ImGui::Checkbox("Sync", &r->AutoReload);
 			ImGui::SameLine();
 			ImGui::Text(r->Path().c_str());
+			if (r->GetSize() || r->GetGPUSize())
+			{
+				ImGui::SameLine();
+				ImGui::TextDisabled("CPU: %.1f KB GPU: %.1f KB", r->GetSize() / 1024.0, r->GetGPUSize() / 1024.0);
+			}
 			ImGui::Separator();
 			ImGui::PopID();
 		}
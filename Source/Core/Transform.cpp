@@ -8,6 +8,17 @@
 
 using namespace Osm;
 
+Transform::Transform(Entity& entity)
+	: Component(entity)
+	, _position(0.0f, 0.0f, 0.0f)
+	, _rotation()
+	, _scale(1.0f, 1.0f, 1.0f)
+	, _parent(nullptr)
+	, _parentType(NORMAL)
+{
+	GetOwner().GetWorld().AddTransform(this);
+}
+
 Transform::~Transform()
 {
 	// Remove from parent
@@ -23,7 +34,55 @@ Transform::~Transform()
 	{
 		t->GetOwner().GetWorld().RemoveEntity(&t->GetOwner());
 		t->_parent = nullptr;
+		t->SetWorldDirty();
 	}
+
+	GetOwner().GetWorld().RemoveTransform(this);
+}
+
+void Transform::SetDirty()
+{
+	_localDirty = true;
+	SetWorldDirty();
+}
+
+void Transform::SetWorldDirty()
+{
+	if (_worldDirty)
+		return;
+
+	_worldDirty = true;
+	for (auto t : _childern)
+		t->SetWorldDirty();
+}
+
+void Transform::UpdateWorld() const
+{
+	if (!_worldDirty)
+		return;
+
+	const Matrix44& local = GetLocal();
+	if (_parent)
+	{
+		switch (_parentType)
+		{
+		case NORMAL:
+			_world = _parent->GetWorld() * local;
+			break;
+		case POSITION:
+			_world = local;
+			_world.SetTranslation(_position + _parent->GetWorld().GetTranslation());
+			break;
+		default:
+			_world = local;
+		}
+	}
+	else
+	{
+		_world = local;
+	}
+
+	_worldDirty = false;
 }
 
 void Transform::SetLocal(Matrix44 view)
@@ -42,23 +101,36 @@ void Transform::SetLocal(Matrix44 view)
 
 	_scale = Vector3(sx, sy, sz);
 	_position = view.GetTranslation();
-	_orientation.SetOrientation(x, y, z);
+	SetOrientation(x, y, z);
 }
 
 void Transform::SetParent(Transform* parent, ParentType type)
 {
+	if (_parent)
+	{
+		_parent->_childern.erase(
+			remove(_parent->_childern.begin(), _parent->_childern.end(), this),
+			_parent->_childern.end());
+	}
+
 	_parent = parent;
-	_parent->_childern.push_back(this);
+	if (_parent)
+		_parent->_childern.push_back(this);
 	_parentType = type;
+
+	SetWorldDirty();
+	GetOwner().GetWorld().SetTransformsDirty();
 }
 
 #ifdef INSPECTOR
 void Transform::Inspect()
 {
-	ImGui::DragFloat3("Position", _position.f);
-	ImGui::DragFloat3("Scale", _scale.f);
-	Vector3 euler = _orientation.GetEulerAngles();
-	ImGui::DragFloat3("Rotation", euler.f, 0.001f);
+	// Only dirty the transform when a widget or the gizmo changed it
+	bool edited = false;
+	edited |= ImGui::DragFloat3("Position", _position.f);
+	edited |= ImGui::DragFloat3("Scale", _scale.f);
+	Vector3 euler = GetOrientation().GetEulerAngles();
+	edited |= ImGui::DragFloat3("Rotation", euler.f, 0.001f);
 	//_orientation.SetEulerAngles(euler);
 
 
@@ -156,22 +228,27 @@ void Transform::Inspect()
 	float matrixTranslation[3], matrixRotation[3], matrixScale[3];
 	ImGuizmo::DecomposeMatrixToComponents(matrix, matrixTranslation, matrixRotation, matrixScale);
 
-	_position.x = matrixTranslation[0];
-	_position.y = matrixTranslation[1];
-	_position.z = matrixTranslation[2];
-
-	_scale.x = matrixScale[0];
-	_scale.y = matrixScale[1];
-	_scale.z = matrixScale[2];
-
 	matrixRotation[0] *= Pi / 180.0f;
 	matrixRotation[1] *= Pi / 180.0f;
 	matrixRotation[2] *= Pi / 180.0f;
 
-	_orientation.SetEulerAngles(Vector3(
-			matrixRotation[0],
-			matrixRotation[1],
-			matrixRotation[2]));	
+	if (edited || ImGuizmo::IsUsing())
+	{
+		_position.x = matrixTranslation[0];
+		_position.y = matrixTranslation[1];
+		_position.z = matrixTranslation[2];
+
+		_scale.x = matrixScale[0];
+		_scale.y = matrixScale[1];
+		_scale.z = matrixScale[2];
+
+		Matrix44 orientation;
+		orientation.SetEulerAngles(Vector3(
+				matrixRotation[0],
+				matrixRotation[1],
+				matrixRotation[2]));
+		SetOrientation(orientation);
+	}
 
 
 	ImGui::InputFloat3("Rt", matrixRotation, 3);
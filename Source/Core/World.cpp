@@ -1,6 +1,12 @@
 #include <Core/World.h>
 #include <Core/Entity.h>
 #include <Core/Transform.h>
+#include <Core/Game.h>
+#include <Core/Jobs.h>
+#include <Graphics/Render.h>
+#include <Tools/Profiler.h>
+#include <Tools/Memory.h>
+#include <Tools/Counters.h>
 #include <imgui.h>
 #include <algorithm>
 #include <Utils.h>
@@ -8,25 +14,48 @@
 using namespace std;
 using namespace Osm;
 
+namespace
+{
+	Counter gEntities("Entities", COUNTER_GAUGE);
+}
+
 World::~World()
 {
 }
 
 void Osm::World::RemoveEntity(Entity * e)
 {
+	unique_lock<recursive_mutex> lock(_structureMutex, defer_lock);
+	if (_inParallelUpdate)
+		lock.lock();
+
 	_removeQueue.insert(e);
 }
 
+void World::Defer(function<void(void)> change)
+{
+	if (!_inParallelUpdate)
+	{
+		change();
+		return;
+	}
+
+	lock_guard<recursive_mutex> lock(_structureMutex);
+	_deferred.push_back(move(change));
+}
+
 void World::Update(float dt)
 {
+	PROFILE_FUNCTION();
+	MEMORY_SCOPE(MEMORY_TAG_GAMEPLAY);
+
 	// Add entities
 	for (auto& e : _addQueue)
 		_entities.push_back(move(e));
 	_addQueue.clear();
 
 	// Update entites
-	for (auto& e : _entities)
-		e->Update(dt);
+	ForEachEntity([dt](Entity* e) { e->Update(dt); });
 
 	while (_removeQueue.size() > 0)
 	{
@@ -38,26 +67,135 @@ void World::Update(float dt)
 		});
 		_entities.erase(toRemove, _entities.end());
 	}
+
+	gEntities.Set((int64_t)_entities.size());
 }
 
 void World::PostUpdate(float dt)
 {
 	// Update entites
+	ForEachEntity([dt](Entity* e) { e->PostUpdate(dt); });
+}
+
+void World::ForEachEntity(const function<void(Entity*)>& func)
+{
+	if (!_parallelUpdate)
+	{
+		for (auto& e : _entities)
+			func(e.get());
+		return;
+	}
+
+	// Everything that is not thread safe goes first on this thread
+	vector<Entity*> parallel;
 	for (auto& e : _entities)
-		e->PostUpdate(dt);
+	{
+		if (e->GetThreadSafe())
+			parallel.push_back(e.get());
+		else
+			func(e.get());
+	}
+
+	// Reading a dirty world matrix rebuilds a shared cache, so have them all
+	// clean before the jobs can read each other's transforms
+	if (!parallel.empty())
+		UpdateTransforms();
+
+	_inParallelUpdate = true;
+	Game.Jobs().ParallelFor((uint)parallel.size(), 16, [&parallel, &func](uint begin, uint end)
+	{
+		for (uint i = begin; i < end; i++)
+			func(parallel[i]);
+	});
+	_inParallelUpdate = false;
+
+	Sync();
+}
+
+void World::Sync()
+{
+	// Changes can queue more changes, so don't iterate in place
+	while (!_deferred.empty())
+	{
+		auto deferred = move(_deferred);
+		_deferred.clear();
+		for (auto& change : deferred)
+			change();
+	}
 }
 
 void World::Render()
 {
 }
 
+void World::ExtractRender()
+{
+	auto renderManager = GetComponent<RenderManager>();
+	if (renderManager)
+		renderManager->Extract();
+}
+
+void World::SwapRender()
+{
+	auto renderManager = GetComponent<RenderManager>();
+	if (renderManager)
+		renderManager->SwapFrames();
+}
+
 void Osm::World::Clear()
 {
 	_entities.clear();
 	_addQueue.clear();
 	_removeQueue.clear();
+	_deferred.clear();
+}
+
+
+void World::UpdateTransforms()
+{
+	PROFILE_FUNCTION();
+
+	if (_transformsDirty)
+	{
+		_transformOrder.clear();
+		_transformOrder.reserve(_transforms.size());
+		for (auto t : _transforms)
+		{
+			if (t->GetParent())
+				continue;
+
+			// Breadth first from each root keeps parents ahead of childern
+			size_t first = _transformOrder.size();
+			_transformOrder.push_back(t);
+			for (size_t i = first; i < _transformOrder.size(); i++)
+			{
+				for (auto c : _transformOrder[i]->GetChildern())
+					_transformOrder.push_back(c);
+			}
+		}
+		_transformsDirty = false;
+	}
+
+	for (auto t : _transformOrder)
+		t->UpdateWorld();
 }
 
+void World::AddTransform(Transform* transform)
+{
+	transform->_worldIndex = (uint)_transforms.size();
+	_transforms.push_back(transform);
+	_transformsDirty = true;
+}
+
+void World::RemoveTransform(Transform* transform)
+{
+	uint index = transform->_worldIndex;
+	ASSERT(index < _transforms.size() && _transforms[index] == transform);
+	_transforms[index] = _transforms.back();
+	_transforms[index]->_worldIndex = index;
+	_transforms.pop_back();
+	_transformsDirty = true;
+}
 
 vector<Entity*> World::GetEntitiesByTag(uint tag)
 {
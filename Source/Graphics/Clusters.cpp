@@ -0,0 +1,181 @@
+#include <Graphics/Clusters.h>
+#include <Graphics/Culling.h>
+#include <Graphics/Render.h>
+#include <Core/Game.h>
+#include <Core/Jobs.h>
+#include <Tools/Counters.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace Osm;
+using namespace std;
+
+namespace
+{
+	Counter gClusteredLights("Clustered Lights");
+	Counter gClusterIndices("Cluster Light Indices");
+
+	const uint kTilesPerSlice = kClusterGridX * kClusterGridY;
+
+	// Log slices need a near plane above zero, ortho ones can start at zero
+	const float kMinDepth = 0.01f;
+
+	// View space point at a depth that projects to the ndc x and y
+	Vector3 Unproject(const Matrix44& projection, float x, float y, float depth)
+	{
+		// Clip w and xy of a view point with z at -depth, solved for its xy
+		const auto& m = projection.m;
+		const float w = m[3][3] - m[2][3] * depth;
+		return Vector3(
+			(x * w + m[2][0] * depth - m[3][0]) / m[0][0],
+			(y * w + m[2][1] * depth - m[3][1]) / m[1][1],
+			-depth);
+	}
+}
+
+void LightClusters::Build(const CameraState& camera, const vector<LightState>& lights)
+{
+	// Near and far planes out of the projection, perspective or ortho
+	const auto& m = camera.Projection.m;
+	float nearDepth;
+	float farDepth;
+	if (m[2][3] != 0.0f)
+	{
+		nearDepth = m[3][2] / (m[2][2] - 1.0f);
+		farDepth = m[3][2] / (m[2][2] + 1.0f);
+	}
+	else
+	{
+		nearDepth = (m[3][2] + 1.0f) / m[2][2];
+		farDepth = (m[3][2] - 1.0f) / m[2][2];
+	}
+	nearDepth = max(nearDepth, kMinDepth);
+	farDepth = max(farDepth, nearDepth * 2.0f);
+	_sliceScale = (float)kClusterGridZ / logf(farDepth / nearDepth);
+	_sliceBias = -logf(nearDepth) * _sliceScale;
+
+	// Only the point lights that reach into the view
+	const Frustum frustum = Frustum::FromMatrix(camera.Projection * camera.View);
+	_lights.clear();
+	_viewCenters.clear();
+	for (const auto& l : lights)
+	{
+		if (l.Type != Light::POINT_LIGHT)
+			continue;
+
+		bool inside = true;
+		for (const auto& p : frustum.Planes)
+		{
+			if (p.x * l.Position.x + p.y * l.Position.y + p.z * l.Position.z + p.w < -l.Radius)
+			{
+				inside = false;
+				break;
+			}
+		}
+		if (!inside)
+			continue;
+
+		PointLightUniforms point;
+		point.Position = l.Position;
+		point.Radius = l.Radius;
+		point.Color = l.Color;
+		point.Attenuation = l.Attenuation;
+		_lights.push_back(point);
+		_viewCenters.push_back(camera.View * l.Position);
+	}
+
+	_clusters.assign(kClusterCount, ClusterUniforms{ 0, 0 });
+	_indices.clear();
+	if (_lights.empty())
+		return;
+
+	// Slices write to their own froxels and lists, so they don't share anything
+	const Matrix44& projection = camera.Projection;
+	Game.Jobs().ParallelFor(kClusterGridZ, 1, [this, &projection](uint begin, uint end)
+	{
+		for (uint s = begin; s < end; s++)
+			BinSlice(s, projection);
+	});
+
+	// Offsets so far start at each slice's own list
+	for (uint s = 0; s < (uint)kClusterGridZ; s++)
+	{
+		const uint base = (uint)_indices.size();
+		_indices.insert(_indices.end(), _sliceIndices[s].begin(), _sliceIndices[s].end());
+		for (uint c = s * kTilesPerSlice; c < (s + 1) * kTilesPerSlice; c++)
+			_clusters[c].Offset += base;
+	}
+
+	gClusteredLights += (int64_t)_lights.size();
+	gClusterIndices += (int64_t)_indices.size();
+}
+
+void LightClusters::BinSlice(uint slice, const Matrix44& projection)
+{
+	auto& candidates = _candidates[slice];
+	auto& indices = _sliceIndices[slice];
+	candidates.clear();
+	indices.clear();
+
+	const float nearDepth = GetSliceDepth(slice);
+	const float farDepth = GetSliceDepth(slice + 1);
+	for (uint i = 0; i < (uint)_lights.size(); i++)
+	{
+		const float depth = -_viewCenters[i].z;
+		const float radius = _lights[i].Radius;
+		if (depth + radius >= nearDepth && depth - radius <= farDepth)
+			candidates.push_back(i);
+	}
+	if (candidates.empty())
+		return;
+
+	const float depths[] = { nearDepth, farDepth };
+	for (uint y = 0; y < (uint)kClusterGridY; y++)
+	{
+		const float y0 = -1.0f + 2.0f * y / kClusterGridY;
+		const float y1 = -1.0f + 2.0f * (y + 1) / kClusterGridY;
+		for (uint x = 0; x < (uint)kClusterGridX; x++)
+		{
+			const float x0 = -1.0f + 2.0f * x / kClusterGridX;
+			const float x1 = -1.0f + 2.0f * (x + 1) / kClusterGridX;
+
+			// Box around the froxel's corners, on both sides of the slice
+			Vector3 boxMin(FLT_MAX, FLT_MAX, FLT_MAX);
+			Vector3 boxMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+			for (float depth : depths)
+			{
+				for (uint corner = 0; corner < 4; corner++)
+				{
+					Vector3 p = Unproject(
+						projection,
+						(corner & 1) ? x1 : x0,
+						(corner & 2) ? y1 : y0,
+						depth);
+					boxMin = Vector3(min(boxMin.x, p.x), min(boxMin.y, p.y), min(boxMin.z, p.z));
+					boxMax = Vector3(max(boxMax.x, p.x), max(boxMax.y, p.y), max(boxMax.z, p.z));
+				}
+			}
+
+			ClusterUniforms& cluster = _clusters[slice * kTilesPerSlice + y * kClusterGridX + x];
+			cluster.Offset = (uint)indices.size();
+			for (uint i : candidates)
+			{
+				// Distance from the center to the closest point in the box
+				const Vector3& c = _viewCenters[i];
+				const float dx = max(boxMin.x - c.x, 0.0f) + max(c.x - boxMax.x, 0.0f);
+				const float dy = max(boxMin.y - c.y, 0.0f) + max(c.y - boxMax.y, 0.0f);
+				const float dz = max(boxMin.z - c.z, 0.0f) + max(c.z - boxMax.z, 0.0f);
+				const float radius = _lights[i].Radius;
+				if (dx * dx + dy * dy + dz * dz <= radius * radius)
+					indices.push_back(i);
+			}
+			cluster.Count = (uint)indices.size() - cluster.Offset;
+		}
+	}
+}
+
+float LightClusters::GetSliceDepth(uint slice) const
+{
+	return expf(((float)slice - _sliceBias) / _sliceScale);
+}
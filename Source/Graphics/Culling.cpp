@@ -0,0 +1,135 @@
+#include <Graphics/Culling.h>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if SIMD_SSE
+#include <emmintrin.h>
+#endif
+
+using namespace Osm;
+using namespace std;
+
+Frustum Frustum::FromMatrix(const Matrix44& viewProjection)
+{
+	// Clip space component c is the dot product with column c, the planes
+	// are where x, y and z meet -w and w
+	const auto& m = viewProjection.m;
+	Vector4 col[4];
+	for (int c = 0; c < 4; c++)
+		col[c] = Vector4(m[0][c], m[1][c], m[2][c], m[3][c]);
+
+	Frustum frustum;
+	frustum.Planes[0] = col[3] + col[0];	// Left
+	frustum.Planes[1] = col[3] - col[0];	// Right
+	frustum.Planes[2] = col[3] + col[1];	// Bottom
+	frustum.Planes[3] = col[3] - col[1];	// Top
+	frustum.Planes[4] = col[3] + col[2];	// Near
+	frustum.Planes[5] = col[3] - col[2];	// Far
+
+	for (auto& p : frustum.Planes)
+	{
+		float length = sqrtf(p.x * p.x + p.y * p.y + p.z * p.z);
+		if (length > 0.0f)
+			p = p * (1.0f / length);
+	}
+	return frustum;
+}
+
+void BoundsArray::Clear()
+{
+	_centerX.clear();
+	_centerY.clear();
+	_centerZ.clear();
+	_extentX.clear();
+	_extentY.clear();
+	_extentZ.clear();
+	_radius.clear();
+}
+
+uint BoundsArray::Add(const Vector3& center, const Vector3& extents, float radius)
+{
+	_centerX.push_back(center.x);
+	_centerY.push_back(center.y);
+	_centerZ.push_back(center.z);
+	_extentX.push_back(extents.x);
+	_extentY.push_back(extents.y);
+	_extentZ.push_back(extents.z);
+	_radius.push_back(radius);
+	return GetCount() - 1;
+}
+
+uint BoundsArray::AddUnbounded()
+{
+	return Add(Vector3(), Vector3(FLT_MAX, FLT_MAX, FLT_MAX), FLT_MAX);
+}
+
+uint BoundsArray::Cull(const Frustum& frustum, vector<uchar>& visible) const
+{
+	const uint count = GetCount();
+	visible.resize(count);
+	uint culled = 0;
+	uint i = 0;
+
+#if SIMD_SSE
+	// Four bounds against one plane at a time
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 cx = _mm_loadu_ps(&_centerX[i]);
+		__m128 cy = _mm_loadu_ps(&_centerY[i]);
+		__m128 cz = _mm_loadu_ps(&_centerZ[i]);
+		__m128 ex = _mm_loadu_ps(&_extentX[i]);
+		__m128 ey = _mm_loadu_ps(&_extentY[i]);
+		__m128 ez = _mm_loadu_ps(&_extentZ[i]);
+		__m128 r = _mm_loadu_ps(&_radius[i]);
+		__m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+		for (const auto& p : frustum.Planes)
+		{
+			__m128 d = _mm_add_ps(
+				_mm_add_ps(
+					_mm_mul_ps(cx, _mm_set1_ps(p.x)),
+					_mm_mul_ps(cy, _mm_set1_ps(p.y))),
+				_mm_add_ps(
+					_mm_mul_ps(cz, _mm_set1_ps(p.z)),
+					_mm_set1_ps(p.w)));
+			__m128 box = _mm_add_ps(
+				_mm_add_ps(
+					_mm_mul_ps(ex, _mm_set1_ps(fabsf(p.x))),
+					_mm_mul_ps(ey, _mm_set1_ps(fabsf(p.y)))),
+				_mm_mul_ps(ez, _mm_set1_ps(fabsf(p.z))));
+			__m128 reach = _mm_min_ps(r, box);
+			inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(d, reach), _mm_setzero_ps()));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		for (uint k = 0; k < 4; k++)
+		{
+			visible[i + k] = (mask >> k) & 1;
+			culled += 1 - visible[i + k];
+		}
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		bool inside = true;
+		for (const auto& p : frustum.Planes)
+		{
+			float d = _centerX[i] * p.x + _centerY[i] * p.y + _centerZ[i] * p.z + p.w;
+			float box =
+				_extentX[i] * fabsf(p.x) +
+				_extentY[i] * fabsf(p.y) +
+				_extentZ[i] * fabsf(p.z);
+			if (d + min(_radius[i], box) < 0.0f)
+			{
+				inside = false;
+				break;
+			}
+		}
+		visible[i] = inside ? 1 : 0;
+		culled += inside ? 0 : 1;
+	}
+
+	return culled;
+}
@@ -2,10 +2,21 @@
 #include <Defines.h>
 #include <Graphics/Shader.h>
 #include <Graphics/OpenGL.h>
+#include <Graphics/GPUTimer.h>
+#include <Graphics/GLState.h>
+#include <Tools/Counters.h>
+#include <Core/Game.h>
+#include <cstring>
 
 using namespace Osm;
 using namespace std;
 
+namespace
+{
+	Counter gUploadedBytes("Uploaded Bytes");
+	Counter gDrawCalls("Draw Calls");
+}
+
 // Actualy creates a new DebugDraw, but the real work is in the Init not the ctor
 // This serves as a manager
 DebugRenderer Osm::gDebugRenderer;
@@ -18,19 +29,26 @@ DebugRenderer Osm::gDebugRenderer;
 DebugRenderer::DebugRenderer()
 {
     // Set values
-    _linesCount = 0;
+    _linesCount[0] = 0;
+    _linesCount[1] = 0;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // Destructor
 ////////////////////////////////////////////////////////////////////////////////
-DebugRenderer::~DebugRenderer() {}
+DebugRenderer::~DebugRenderer()
+{
+	ASSERT(!_vao && !_shader);
+}
 
 ////////////////////////////////////////////////////////////////////////////////
 // Initialize - Acts as a constructor
 ////////////////////////////////////////////////////////////////////////////////
 void DebugRenderer::Initialize()
 {
+	if (Game.IsHeadless())
+		return;
+
 	auto vxShader =
 		"#version 430 core												\n\
 		in vec3 a_position;												\n\
@@ -64,19 +82,44 @@ void DebugRenderer::Initialize()
 	_attribVertex = _shader->GetAttribute("a_position");
 	_paramCamera = _shader->GetParameter("u_worldviewproj");
 
-	glGenVertexArrays(1, &_vao);
-	
-	glBindVertexArray(_vao);
+	_shader->Deactivate();
+}
 
-	// Allocate two buffers
-	glGenBuffers(1, &_linesVBO);
+////////////////////////////////////////////////////////////////////////////////
+// Shutdown
+////////////////////////////////////////////////////////////////////////////////
+void DebugRenderer::Shutdown()
+{
+	if (!_shader && !_vao)
+		return;
 
-	// Array buffer contains the attribute data
-	glBindBuffer(GL_ARRAY_BUFFER, _linesVBO);
+	// The buffer stays mapped till it's released on the rendering context
+	GLuint vao = _vao;
+	auto lines = make_unique<StreamBuffer>(_lines);
+	auto shader = move(_shader);
+	Game.QueueRenderCommand([vao, lines = move(lines), shader = move(shader)]() mutable
+	{
+		if (vao)
+			gGLState.DeleteVertexArrays(1, &vao);
+		lines->Release();
+		shader.reset();
+	});
+	_vao = 0;
+	_lines = StreamBuffer();
+}
 
-	// Alocate into VBO
-	auto size = sizeof(_vertexArray);
-	glBufferData(GL_ARRAY_BUFFER, size, &_vertexArray[0], GL_STREAM_DRAW);
+////////////////////////////////////////////////////////////////////////////////
+// CreateVAO
+////////////////////////////////////////////////////////////////////////////////
+void DebugRenderer::CreateVAO()
+{
+	// Room for all the lines every frame
+	_lines.Create(GL_ARRAY_BUFFER, sizeof(_vertexArray[0]));
+
+	glGenVertexArrays(1, &_vao);
+	
+	gGLState.BindVertexArray(_vao);
+	gGLState.BindBuffer(GL_ARRAY_BUFFER, _lines.GetBuffer());
 
 	_attribVertex->SetAttributePointer(3,
 		GL_FLOAT,
@@ -88,11 +131,6 @@ void DebugRenderer::Initialize()
 		GL_TRUE,
 		sizeof(VertexPosition3DColor),
 		(void*)offsetof(VertexPosition3DColor, Color));
-
-	glBindVertexArray(0);
-
-	_shader->Deactivate();
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -103,26 +141,38 @@ void DebugRenderer::Draw(Matrix44& vp)
 	if (!_shader)
 		return;
 
+	if (!_vao)
+		CreateVAO();
+
+	uint debugPass = gGPUTimer.Begin("Debug");
 	_shader->Activate();
 	_paramCamera->SetValue(vp);
 
-	glBindVertexArray(_vao);
+	gGLState.BindVertexArray(_vao);
 
-	if (_linesCount > 0)
+	const int draw = 1 - _queue;
+	const int count = _linesCount[draw];
+	if (count > 0)
 	{
-		// Array buffer contains the attribute data
-		glBindBuffer(GL_ARRAY_BUFFER, _linesVBO);
-
-		glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(VertexPosition3DColor) * (_linesCount * 2), &_vertexArray[0].Position);
-		//glBufferData(GL_ARRAY_BUFFER, sizeof(_vertexArray), &_vertexArray[0], GL_DYNAMIC_DRAW);
-
-		glDrawArrays(GL_LINES, 0, _linesCount * 2);
-
-		glBindBuffer(GL_ARRAY_BUFFER, 0); // Unbind buffer
+		// Offsets are whole vertices, so the draw can start from there
+		// and the vertex array never needs changing
+		const size_t stride = sizeof(VertexPosition3DColor);
+		const size_t size = stride * (count * 2);
+		size_t offset = 0;
+		void* vertices = _lines.Map(size, stride, offset);
+		if (vertices)
+		{
+			memcpy(vertices, &_vertexArray[draw][0], size);
+			_lines.Unmap();
+			gUploadedBytes += (int64_t)size;
+
+			glDrawArrays(GL_LINES, (GLint)(offset / stride), count * 2);
+			++gDrawCalls;
+		}
 	}
+	_lines.EndFrame();
 
-	glBindVertexArray(0);
-	_shader->Deactivate();
+	gGPUTimer.End(debugPass);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -130,7 +180,16 @@ void DebugRenderer::Draw(Matrix44& vp)
 ////////////////////////////////////////////////////////////////////////////////
 void DebugRenderer::Clear()
 {
-	_linesCount = 0;
+	_linesCount[1 - _queue] = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Swap
+////////////////////////////////////////////////////////////////////////////////
+void DebugRenderer::Swap()
+{
+	_queue = 1 - _queue;
+	_linesCount[_queue] = 0;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -146,15 +205,17 @@ void DebugRenderer::AddLine(
 		return;
 
 
-	if (_linesCount < _maxLines)
+	int& count = _linesCount[_queue];
+	if (count < _maxLines)
     {
-		_vertexArray[_linesCount * 2].Position     = from;
-		_vertexArray[_linesCount * 2 + 1].Position = to;
+		auto vertices = _vertexArray[_queue];
+		vertices[count * 2].Position     = from;
+		vertices[count * 2 + 1].Position = to;
         //
-        _vertexArray[_linesCount * 2].Color       = color;
-		_vertexArray[_linesCount * 2 + 1].Color   = color;
+        vertices[count * 2].Color       = color;
+		vertices[count * 2 + 1].Color   = color;
         //
-		++_linesCount;
+		++count;
 	}
     // else ignore
 }
@@ -267,16 +328,20 @@ void DebugRenderer::AddAxis(uint category, const Matrix44 &trans, float size)
 
 #else
 
-DebugRenderer::DebugRenderer(): _linesCount(0) {}
+DebugRenderer::DebugRenderer() { _linesCount[0] = _linesCount[1] = 0; }
 
 DebugRenderer::~DebugRenderer() {}
 
 void DebugRenderer::Initialize() {}
 
+void DebugRenderer::Shutdown() {}
+
 void DebugRenderer::Draw(Matrix44& vp) {}
 
 void DebugRenderer::Clear() {}
 
+void DebugRenderer::Swap() {}
+
 void DebugRenderer::AddLine(uint category, const Vector3& from, const Vector3& to, const Color& color) { }
 
 void DebugRenderer::AddCircle(uint category, const Vector3& center, float radius, const Color& color, int divs) {}
@@ -0,0 +1,201 @@
+#include <Graphics/DrawCommands.h>
+#include <Graphics/Render.h>
+#include <Graphics/Shader.h>
+#include <Graphics/Texture.h>
+#include <cstring>
+
+using namespace Osm;
+using namespace std;
+
+namespace
+{
+	// Commands are copied in and out, so the buffer never needs aligning
+	struct CommandHeader
+	{
+		uint	Type;
+		uint	Size;		// Header, command and extra bytes, rounded up
+	};
+
+	struct ActivateShaderCommand
+	{
+		RenderProxy*		Proxy;
+		const CameraState*	Camera;
+		const RenderFrame*	Frame;
+	};
+
+	template<typename T>
+	struct SetValueCommand
+	{
+		ShaderParameter*	Parameter;
+		T					Value;
+	};
+
+	struct DrawCommand
+	{
+		const RenderItem*	Item;
+		uint				Count;
+		uint				Stride;
+	};
+
+	template<typename T>
+	T Read(const uchar* data)
+	{
+		T command;
+		memcpy(&command, data, sizeof(T));
+		return command;
+	}
+}
+
+template<typename T>
+uchar* DrawCommandBuffer::Push(CommandType type, const T& command, size_t extra)
+{
+	const size_t size = (sizeof(CommandHeader) + sizeof(T) + extra + 7) & ~(size_t)7;
+	const size_t offset = _data.size();
+	_data.resize(offset + size);
+
+	CommandHeader header = { (uint)type, (uint)size };
+	memcpy(&_data[offset], &header, sizeof(header));
+	memcpy(&_data[offset + sizeof(header)], &command, sizeof(T));
+	return &_data[offset + sizeof(header) + sizeof(T)];
+}
+
+void DrawCommandBuffer::ActivateShader(
+	RenderProxy* proxy,
+	const CameraState& camera,
+	const RenderFrame& frame)
+{
+	Push(ACTIVATE_SHADER_COMMAND, ActivateShaderCommand{ proxy, &camera, &frame });
+}
+
+void DrawCommandBuffer::UseShader(Shader* shader)
+{
+	Push(USE_SHADER_COMMAND, shader);
+}
+
+void DrawCommandBuffer::SetValue(ShaderParameter* parameter, float value)
+{
+	if (parameter->IsValid())
+		Push(SET_FLOAT_COMMAND, SetValueCommand<float>{ parameter, value });
+}
+
+void DrawCommandBuffer::SetValue(ShaderParameter* parameter, int value)
+{
+	if (parameter->IsValid())
+		Push(SET_INT_COMMAND, SetValueCommand<int>{ parameter, value });
+}
+
+void DrawCommandBuffer::SetValue(ShaderParameter* parameter, const Vector3& value)
+{
+	if (parameter->IsValid())
+		Push(SET_VECTOR3_COMMAND, SetValueCommand<Vector3>{ parameter, value });
+}
+
+void DrawCommandBuffer::SetValue(ShaderParameter* parameter, const Color& value)
+{
+	if (parameter->IsValid())
+		Push(SET_COLOR_COMMAND, SetValueCommand<Color>{ parameter, value });
+}
+
+void DrawCommandBuffer::SetValue(ShaderParameter* parameter, const Matrix44& value)
+{
+	if (parameter->IsValid())
+		Push(SET_MATRIX_COMMAND, SetValueCommand<Matrix44>{ parameter, value });
+}
+
+void DrawCommandBuffer::SetValue(ShaderParameter* parameter, const Texture& texture)
+{
+	if (parameter->IsValid())
+		Push(SET_TEXTURE_COMMAND, SetValueCommand<const Texture*>{ parameter, &texture });
+}
+
+void DrawCommandBuffer::Draw(const RenderItem& item)
+{
+	Push(DRAW_COMMAND, DrawCommand{ &item, 1, 0 });
+}
+
+void* DrawCommandBuffer::DrawInstanced(const RenderItem& item, uint count, uint stride)
+{
+	return Push(DRAW_INSTANCED_COMMAND, DrawCommand{ &item, count, stride }, (size_t)count * stride);
+}
+
+void DrawCommandBuffer::Execute() const
+{
+	size_t offset = 0;
+	while (offset < _data.size())
+	{
+		const CommandHeader header = Read<CommandHeader>(&_data[offset]);
+		const uchar* data = &_data[offset + sizeof(CommandHeader)];
+		offset += header.Size;
+
+		switch (header.Type)
+		{
+		case ACTIVATE_SHADER_COMMAND:
+		{
+			auto c = Read<ActivateShaderCommand>(data);
+			c.Proxy->ActivateShader(*c.Camera, *c.Frame);
+			break;
+		}
+		case USE_SHADER_COMMAND:
+			Read<Shader*>(data)->Activate();
+			break;
+		case SET_FLOAT_COMMAND:
+		{
+			auto c = Read<SetValueCommand<float>>(data);
+			c.Parameter->SetValue(c.Value);
+			break;
+		}
+		case SET_INT_COMMAND:
+		{
+			auto c = Read<SetValueCommand<int>>(data);
+			c.Parameter->SetValue(c.Value);
+			break;
+		}
+		case SET_VECTOR3_COMMAND:
+		{
+			auto c = Read<SetValueCommand<Vector3>>(data);
+			c.Parameter->SetValue(c.Value);
+			break;
+		}
+		case SET_COLOR_COMMAND:
+		{
+			auto c = Read<SetValueCommand<Color>>(data);
+			c.Parameter->SetValue(c.Value);
+			break;
+		}
+		case SET_MATRIX_COMMAND:
+		{
+			auto c = Read<SetValueCommand<Matrix44>>(data);
+			c.Parameter->SetValue(c.Value);
+			break;
+		}
+		case SET_TEXTURE_COMMAND:
+		{
+			auto c = Read<SetValueCommand<const Texture*>>(data);
+			c.Parameter->SetValue(*c.Value);
+			break;
+		}
+		case DRAW_COMMAND:
+		{
+			auto c = Read<DrawCommand>(data);
+			c.Item->Proxy->Bind(*c.Item, nullptr, 0);
+			glDrawElements(GL_TRIANGLES, c.Item->IndexCount, GL_UNSIGNED_SHORT, nullptr);
+			break;
+		}
+		case DRAW_INSTANCED_COMMAND:
+		{
+			auto c = Read<DrawCommand>(data);
+			c.Item->Proxy->Bind(*c.Item, data + sizeof(DrawCommand), (size_t)c.Count * c.Stride);
+			glDrawElementsInstancedARB(
+				GL_TRIANGLES,
+				c.Item->IndexCount,
+				GL_UNSIGNED_SHORT,
+				nullptr,
+				(GLsizei)c.Count);
+			break;
+		}
+		default:
+			ASSERT(false);
+			return;
+		}
+	}
+}
@@ -0,0 +1,289 @@
+#include <Graphics/GLState.h>
+#include <Tools/Counters.h>
+
+using namespace Osm;
+using namespace std;
+
+namespace
+{
+	Counter gFilteredCalls("Filtered GL Calls");
+	Counter gStateChanges("GL State Changes");
+
+	// Never a valid name or enum, so nothing matches it after an invalidate
+	const GLuint kUnknown = 0xFFFFFFFF;
+}
+
+thread_local GLStateCache Osm::gGLState;
+
+GLStateCache::GLStateCache()
+{
+	Invalidate();
+}
+
+void GLStateCache::Invalidate()
+{
+	_program = kUnknown;
+	_vao = kUnknown;
+	for (auto& b : _buffers)
+		b = kUnknown;
+	_activeUnit = kUnknown;
+	for (auto& unit : _textures)
+		for (auto& t : unit)
+			t = kUnknown;
+	_readFramebuffer = kUnknown;
+	_drawFramebuffer = kUnknown;
+	for (auto& c : _capabilities)
+		c = -1;
+	_depthMask = -1;
+	_blendSource = kUnknown;
+	_blendDestination = kUnknown;
+	for (auto& v : _viewport)
+		v = -1;
+}
+
+void GLStateCache::UseProgram(GLuint program)
+{
+	if (_program == program)
+		return Filtered();
+
+	glUseProgram(program);
+	_program = program;
+	gStateChanges.Add();
+}
+
+void GLStateCache::BindVertexArray(GLuint vao)
+{
+	if (_vao == vao)
+		return Filtered();
+
+	glBindVertexArray(vao);
+	_vao = vao;
+	_buffers[ELEMENT_ARRAY_BUFFER_TARGET] = kUnknown;
+	gStateChanges.Add();
+}
+
+void GLStateCache::BindBuffer(GLenum target, GLuint buffer)
+{
+	int t = GetBufferTarget(target);
+	if (t >= 0 && _buffers[t] == buffer)
+		return Filtered();
+
+	glBindBuffer(target, buffer);
+	if (t >= 0)
+		_buffers[t] = buffer;
+	gStateChanges.Add();
+}
+
+void GLStateCache::ActiveTexture(uint unit)
+{
+	if (_activeUnit == unit)
+		return Filtered();
+
+	glActiveTexture(GL_TEXTURE0 + unit);
+	_activeUnit = unit;
+	gStateChanges.Add();
+}
+
+void GLStateCache::BindTexture(GLenum target, GLuint texture)
+{
+	int t = GetTextureTarget(target);
+	bool tracked = t >= 0 && _activeUnit < kTextureUnits;
+	if (tracked && _textures[_activeUnit][t] == texture)
+		return Filtered();
+
+	glBindTexture(target, texture);
+	if (tracked)
+		_textures[_activeUnit][t] = texture;
+	gStateChanges.Add();
+}
+
+void GLStateCache::BindTexture(uint unit, GLenum target, GLuint texture)
+{
+	int t = GetTextureTarget(target);
+	if (t >= 0 && unit < kTextureUnits && _textures[unit][t] == texture)
+		return Filtered();
+
+	ActiveTexture(unit);
+	BindTexture(target, texture);
+}
+
+void GLStateCache::BindFramebuffer(GLenum target, GLuint framebuffer)
+{
+	bool read = target == GL_FRAMEBUFFER || target == GL_READ_FRAMEBUFFER;
+	bool draw = target == GL_FRAMEBUFFER || target == GL_DRAW_FRAMEBUFFER;
+	if ((!read || _readFramebuffer == framebuffer) &&
+		(!draw || _drawFramebuffer == framebuffer))
+		return Filtered();
+
+	glBindFramebuffer(target, framebuffer);
+	if (read)
+		_readFramebuffer = framebuffer;
+	if (draw)
+		_drawFramebuffer = framebuffer;
+	gStateChanges.Add();
+}
+
+void GLStateCache::Enable(GLenum capability)
+{
+	SetEnabled(capability, true);
+}
+
+void GLStateCache::Disable(GLenum capability)
+{
+	SetEnabled(capability, false);
+}
+
+void GLStateCache::SetEnabled(GLenum capability, bool enabled)
+{
+	int c = GetCapability(capability);
+	int value = enabled ? 1 : 0;
+	if (c >= 0 && _capabilities[c] == value)
+		return Filtered();
+
+	if (enabled)
+		glEnable(capability);
+	else
+		glDisable(capability);
+	if (c >= 0)
+		_capabilities[c] = value;
+	gStateChanges.Add();
+}
+
+void GLStateCache::DepthMask(bool write)
+{
+	int value = write ? 1 : 0;
+	if (_depthMask == value)
+		return Filtered();
+
+	glDepthMask(write ? GL_TRUE : GL_FALSE);
+	_depthMask = value;
+	gStateChanges.Add();
+}
+
+void GLStateCache::BlendFunc(GLenum source, GLenum destination)
+{
+	if (_blendSource == source && _blendDestination == destination)
+		return Filtered();
+
+	glBlendFunc(source, destination);
+	_blendSource = source;
+	_blendDestination = destination;
+	gStateChanges.Add();
+}
+
+void GLStateCache::Viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+	if (_viewport[0] == x && _viewport[1] == y &&
+		_viewport[2] == width && _viewport[3] == height)
+		return Filtered();
+
+	glViewport(x, y, width, height);
+	_viewport[0] = x;
+	_viewport[1] = y;
+	_viewport[2] = width;
+	_viewport[3] = height;
+	gStateChanges.Add();
+}
+
+void GLStateCache::DeleteProgram(GLuint program)
+{
+	// Deleting the program in use only flags it, it stays in use
+	glDeleteProgram(program);
+	if (_program == program)
+		_program = kUnknown;
+}
+
+void GLStateCache::DeleteVertexArrays(GLsizei count, const GLuint* vaos)
+{
+	glDeleteVertexArrays(count, vaos);
+	for (GLsizei i = 0; i < count; i++)
+	{
+		// The bound one reverts to zero
+		if (_vao == vaos[i])
+		{
+			_vao = 0;
+			_buffers[ELEMENT_ARRAY_BUFFER_TARGET] = kUnknown;
+		}
+	}
+}
+
+void GLStateCache::DeleteBuffers(GLsizei count, const GLuint* buffers)
+{
+	glDeleteBuffers(count, buffers);
+	for (GLsizei i = 0; i < count; i++)
+	{
+		for (auto& b : _buffers)
+		{
+			if (b == buffers[i])
+				b = 0;
+		}
+	}
+}
+
+void GLStateCache::DeleteTextures(GLsizei count, const GLuint* textures)
+{
+	glDeleteTextures(count, textures);
+	for (GLsizei i = 0; i < count; i++)
+	{
+		for (auto& unit : _textures)
+		{
+			for (auto& t : unit)
+			{
+				if (t == textures[i])
+					t = 0;
+			}
+		}
+	}
+}
+
+void GLStateCache::DeleteFramebuffers(GLsizei count, const GLuint* framebuffers)
+{
+	glDeleteFramebuffers(count, framebuffers);
+	for (GLsizei i = 0; i < count; i++)
+	{
+		if (_readFramebuffer == framebuffers[i])
+			_readFramebuffer = 0;
+		if (_drawFramebuffer == framebuffers[i])
+			_drawFramebuffer = 0;
+	}
+}
+
+int GLStateCache::GetBufferTarget(GLenum target)
+{
+	switch (target)
+	{
+	case GL_ARRAY_BUFFER:			return ARRAY_BUFFER_TARGET;
+	case GL_ELEMENT_ARRAY_BUFFER:	return ELEMENT_ARRAY_BUFFER_TARGET;
+	case GL_UNIFORM_BUFFER:			return UNIFORM_BUFFER_TARGET;
+	default:						return -1;
+	}
+}
+
+int GLStateCache::GetTextureTarget(GLenum target)
+{
+	switch (target)
+	{
+	case GL_TEXTURE_2D:				return TEXTURE_2D_TARGET;
+	case GL_TEXTURE_2D_MULTISAMPLE:	return TEXTURE_2D_MULTISAMPLE_TARGET;
+	case GL_TEXTURE_CUBE_MAP:		return TEXTURE_CUBE_MAP_TARGET;
+	default:						return -1;
+	}
+}
+
+int GLStateCache::GetCapability(GLenum capability)
+{
+	switch (capability)
+	{
+	case GL_CULL_FACE:					return CULL_FACE_CAPABILITY;
+	case GL_DEPTH_TEST:					return DEPTH_TEST_CAPABILITY;
+	case GL_BLEND:						return BLEND_CAPABILITY;
+	case GL_SAMPLE_ALPHA_TO_COVERAGE:	return SAMPLE_ALPHA_TO_COVERAGE_CAPABILITY;
+	case GL_SCISSOR_TEST:				return SCISSOR_TEST_CAPABILITY;
+	default:							return -1;
+	}
+}
+
+void GLStateCache::Filtered()
+{
+	gFilteredCalls.Add();
+}
@@ -0,0 +1,113 @@
+#include <Graphics/GPUTimer.h>
+#include <Tools/Profiler.h>
+
+using namespace Osm;
+using namespace std;
+
+GPUTimer Osm::gGPUTimer;
+
+GPUTimer::GPUTimer()
+{
+	_results.reserve(kMaxSections);
+}
+
+// The queries are not deleted, the global outlives the GL context
+
+void GPUTimer::BeginFrame()
+{
+	if (!_created)
+	{
+		for (auto& slot : _slots)
+			glGenQueries(kMaxSections * 2, slot.Queries);
+		_created = true;
+	}
+
+	Poll();
+
+	// When the GPU is this far behind, skip timing rather than wait on it
+	uint next = (_current + 1) % kFrames;
+	Slot& slot = _slots[next];
+	if (slot.Pending)
+		return;
+
+	_current = next;
+	slot.Count = 0;
+	slot.CPUTime = Profiler::Now();
+	glGetInteger64v(GL_TIMESTAMP, &slot.GPUTime);
+	_recording = true;
+}
+
+void GPUTimer::EndFrame()
+{
+	if (!_recording)
+		return;
+
+	Slot& slot = _slots[_current];
+	for (uint i = 0; i < slot.Count; i++)
+	{
+		if (!slot.Sections[i].Ended)
+			End(i);
+	}
+	slot.Pending = slot.Count > 0;
+	_recording = false;
+}
+
+uint GPUTimer::Begin(const char* name)
+{
+	Slot& slot = _slots[_current];
+	if (!_recording || slot.Count == kMaxSections)
+		return kMaxSections;
+
+	uint section = slot.Count++;
+	slot.Sections[section] = { name, false };
+	glQueryCounter(slot.Queries[section * 2], GL_TIMESTAMP);
+	return section;
+}
+
+void GPUTimer::End(uint section)
+{
+	Slot& slot = _slots[_current];
+	if (!_recording || section >= slot.Count || slot.Sections[section].Ended)
+		return;
+
+	glQueryCounter(slot.Queries[section * 2 + 1], GL_TIMESTAMP);
+	slot.Sections[section].Ended = true;
+}
+
+void GPUTimer::Poll()
+{
+	// Oldest frame first, the current one is the newest
+	for (uint i = 1; i <= kFrames; i++)
+	{
+		Slot& slot = _slots[(_current + i) % kFrames];
+		if (!slot.Pending)
+			continue;
+
+		// Queries finish in order, so the last one tells for the whole frame
+		GLint available = 0;
+		glGetQueryObjectiv(slot.Queries[slot.Count * 2 - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			break;
+
+		_results.clear();
+		GLuint64 first = 0, last = 0;
+		for (uint s = 0; s < slot.Count; s++)
+		{
+			GLuint64 start = 0, end = 0;
+			glGetQueryObjectui64v(slot.Queries[s * 2], GL_QUERY_RESULT, &start);
+			glGetQueryObjectui64v(slot.Queries[s * 2 + 1], GL_QUERY_RESULT, &end);
+			if (s == 0)
+				first = start;
+			last = end;
+
+			_results.push_back({ slot.Sections[s].Name, (end - start) / 1000000.0 });
+
+			// Move from the GPU clock to the profiler clock
+			int64_t cpuStart = slot.CPUTime + Profiler::FromSeconds(((int64_t)start - slot.GPUTime) * 1e-9);
+			int64_t cpuEnd = slot.CPUTime + Profiler::FromSeconds(((int64_t)end - slot.GPUTime) * 1e-9);
+			Profiler::AddGPUEvent(slot.Sections[s].Name, cpuStart, cpuEnd);
+		}
+		_frameMilliseconds = (last - first) / 1000000.0;
+		slot.Pending = false;
+	}
+}
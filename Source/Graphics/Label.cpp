@@ -7,6 +7,9 @@
 #include <Defines.h>
 #include <Utils.h>
 #include <Graphics/OpenGL.h>
+#include <Graphics/GLState.h>
+#include <Core/Game.h>
+#include <Tools/Counters.h>
 
 #define _CRT_SECURE_NO_WARNINGS
 
@@ -18,6 +21,9 @@ const uint maxBufferHeight = 512;
 
 namespace
 {
+
+Counter gUploadedBytes("Uploaded Bytes");
+
 uint NextPowerOfTwo(uint val)
 {
 	uint t = 2;
@@ -169,18 +175,25 @@ Label::Label(	const string& labelText,
 	_uvTo = outUV;
 	_width = sizex;
 	_height = sizey;
+	// Only the metrics are needed without a GL context
+	if (Game.IsHeadless())
+	{
+		free(buffer);
+		return;
+	}
+
 	auto size = _width * _height; // *4;
 	GLubyte*  imageData = (GLubyte*)calloc(size, 1);
 
 	if (_texture != 0)
 	{
-		glDeleteTextures(1, &_texture);
+		gGLState.DeleteTextures(1, &_texture);
 		_texture = 0;
 	}
 
 	glGenTextures(1, &_texture);               // Gen
 	
-	glBindTexture(GL_TEXTURE_2D, _texture);    // Bind
+	gGLState.BindTexture(GL_TEXTURE_2D, _texture);    // Bind
 	
 	//
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);   // Minmization
@@ -216,6 +229,8 @@ Label::Label(	const string& labelText,
 		GL_RED,							// Format (how to use)
 		GL_UNSIGNED_BYTE,				// Type   (how to intepret)
 		imageData);						// Data
+	_gpuSize = (uint)(_width * _height);	// R8
+	gUploadedBytes += _gpuSize;
 
 	
 
@@ -1,9 +1,13 @@
 #include <Graphics/Mesh.h>
+#include <Graphics/GLState.h>
+#include <algorithm>
 #include <map>
 #include <sstream>
 #include <Defines.h>
 #include <Utils.h>
 #include <fstream>
+#include <Core/Game.h>
+#include <Tools/Counters.h>
 
 using namespace std;
 using namespace Osm;
@@ -11,6 +15,8 @@ using namespace Osm;
 namespace
 {
 
+Counter gUploadedBytes("Uploaded Bytes");
+
 uint64_t trihash(short k, short l, short m)
 {
 	ulong h = k;
@@ -44,6 +50,7 @@ Mesh::Mesh(const std::string& filename, bool apply)
 	else
 	{
 		_resourcePath = filename + " [CPU]";
+		UpdateSize();
 	}
 }
 
@@ -211,11 +218,13 @@ bool Mesh::LoadBINMESH(const std::string& filename)
 void Mesh::SetVertices(vector<VertexFormat>&& vertices)
 {
 	_vertices = move(vertices);
+	UpdateSize();
 }
 
 void Mesh::SetIndices(vector<GLushort>&& indices)
 {
 	_indices = move(indices);
+	UpdateSize();
 }
 
 void Mesh::Apply()
@@ -225,31 +234,77 @@ void Mesh::Apply()
 	if (_vertices.size() == 0 || _indices.size() == 0)
 		return;
 
+	UpdateBounds();
+
+	// Nothing to upload to, keep the data on the CPU
+	if (Game.IsHeadless())
+	{
+		_indexCount = static_cast<uint>(_indices.size());
+		UpdateSize();
+		return;
+	}
+
 	// Allocate two buffers
 	glGenBuffers(2, _vbo);	
 
 	// Array buffer contains the attribute data
-	glBindBuffer(GL_ARRAY_BUFFER, _vbo[0]);
+	gGLState.BindBuffer(GL_ARRAY_BUFFER, _vbo[0]);
 
 	// Copy into VBO
 	glBufferData(GL_ARRAY_BUFFER, sizeof(_vertices[0]) * _vertices.size(), &_vertices[0], GL_DYNAMIC_DRAW);
-	
-	glBindBuffer(GL_ARRAY_BUFFER, 0); // Unbind buffer
-	
+
+	// The element array binding belongs to the bound vertex array, and
+	// renderers leave theirs bound
+	gGLState.BindVertexArray(0);
 
 	// Element array buffer contains the indices.
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _vbo[1]);
+	gGLState.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, _vbo[1]);
 	
 
 	// Copy into VBO
 	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(_indices[0]) * _indices.size(), &_indices[0], GL_DYNAMIC_DRAW);
 	
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0); // Unbind buffer
-	
 
 	_indexCount =  static_cast<uint>(_indices.size());
+	_gpuSize = static_cast<uint>(sizeof(_vertices[0]) * _vertices.size() + sizeof(_indices[0]) * _indices.size());
+	gUploadedBytes += _gpuSize;
+
+	// Actually give the memory back, clear alone keeps the capacity
 	_vertices.clear();
+	_vertices.shrink_to_fit();
 	_indices.clear();
+	_indices.shrink_to_fit();
+	UpdateSize();
+}
+
+void Mesh::UpdateBounds()
+{
+	if (_vertices.empty())
+		return;
+
+	Vector3 low = _vertices[0].Position;
+	Vector3 high = low;
+	for (const auto& v : _vertices)
+	{
+		low = Vector3(min(low.x, v.Position.x), min(low.y, v.Position.y), min(low.z, v.Position.z));
+		high = Vector3(max(high.x, v.Position.x), max(high.y, v.Position.y), max(high.z, v.Position.z));
+	}
+	_boundsCenter = (low + high) * 0.5f;
+	_boundsExtents = (high - low) * 0.5f;
+
+	float radius = 0.0f;
+	for (const auto& v : _vertices)
+		radius = max(radius, (v.Position - _boundsCenter).SquareMagnitude());
+	_boundsRadius = sqrtf(radius);
+}
+
+void Mesh::UpdateSize()
+{
+	_size = static_cast<uint>(
+		sizeof(VertexFormat) * _vertices.capacity() +
+		sizeof(GLushort) * _indices.capacity());
+	if (!HasVertexBuffers())
+		_gpuSize = 0;
 }
 
 /*
@@ -278,9 +333,10 @@ void Mesh::ClearGL()
 {
 	if (HasVertexBuffers())
 	{
-		glDeleteBuffers(2, _vbo);
-		
+		gGLState.DeleteBuffers(2, _vbo);
+		_vbo[0] = _vbo[1] = 0;
 	}
+	_gpuSize = 0;
 }
 /*
 void Mesh::Reload()
@@ -3,9 +3,28 @@
 #include <imgui/imgui.h>
 #include "Core/Game.h"
 #include <Graphics/Texture.h>
+#include <Graphics/GLState.h>
+#include <Tools/Counters.h>
+#include <algorithm>
+#include <cstdio>
 
 using namespace Osm;
 
+namespace
+{
+	Counter gUploadedBytes("Uploaded Bytes");
+
+	// Continues the hash of "name[" with "index]"
+	ParameterID HashElement(ParameterID array, int index)
+	{
+		char element[16];
+		snprintf(element, sizeof(element), "%d]", index);
+		return HashParameter(element, array);
+	}
+}
+
+GLuint MeshRenderProxy::_instanceBuffer = 0;
+
 MeshRenderer::MeshRenderer(Entity& entity)
 	: Renderable(entity)	
 	, _diffuse(Color::White)
@@ -13,100 +32,163 @@ MeshRenderer::MeshRenderer(Entity& entity)
 {
 }
 
-MeshRenderer::~MeshRenderer()
-{
-	glBindVertexArray(0);
-	glDeleteVertexArrays(1, &_vao);
-}
-
 void MeshRenderer::SetMesh(Mesh* mesh)
 {
+	// The frame in flight has its own copy of the buffers, the proxy
+	// builds a new VAO when it sees the new version
 	_mesh = mesh;
-
-	if(_shader)
-		CreateVAO();
+	_version++;
 }
 
 void MeshRenderer::SetShader(Shader* shader)
 {	
 	_shader = shader;
+	SetProxy(new MeshRenderProxy(shader));
+}
 
-	_projParam = shader->GetParameter("u_projection");
-	_modelParam = shader->GetParameter("u_model");
-	_viewParam = shader->GetParameter("u_view");
-	_textureParam = shader->GetParameter("u_texture");
-	_eyePosParam = shader->GetParameter("u_eyePos");
-	_modelViewParam = shader->GetParameter("u_modelView");
-	_modelViewProjParam = shader->GetParameter("u_modelViewProjection");
+void MeshRenderer::Extract(RenderItem& item) const
+{
+	Renderable::Extract(item);
+	ASSERT(_mesh && _proxy);
+
+	const GLuint* vbo = _mesh->GetVertexBuffers();
+	item.VertexBuffer = vbo[0];
+	item.IndexBuffer = vbo[1];
+	item.IndexCount = _mesh->GetIndexCount();
+	item.Texture = _texture;
+	item.Diffuse = _diffuse;
+	item.Ambient = _ambient;
+	item.Version = _version;
+
+	// Move the box and sphere to world space, a scaled axis grows both
+	const Matrix44& w = item.World;
+	const Vector3& extents = _mesh->GetBoundsExtents();
+	item.BoundsCenter = w * _mesh->GetBoundsCenter();
+	item.BoundsExtents = Vector3(
+		fabsf(w.m[0][0]) * extents.x + fabsf(w.m[1][0]) * extents.y + fabsf(w.m[2][0]) * extents.z,
+		fabsf(w.m[0][1]) * extents.x + fabsf(w.m[1][1]) * extents.y + fabsf(w.m[2][1]) * extents.z,
+		fabsf(w.m[0][2]) * extents.x + fabsf(w.m[1][2]) * extents.y + fabsf(w.m[2][2]) * extents.z);
+	float scale = max(w.GetXAxis().Magnitude(), max(w.GetYAxis().Magnitude(), w.GetZAxis().Magnitude()));
+	item.BoundsRadius = _mesh->GetBoundsRadius() * scale;
+}
+
+#ifdef INSPECTOR
+void MeshRenderer::Inspect()
+{
+	ImGui::Checkbox("Enabled", &_enabled);
+	ImGui::OsmColor("Diffuse", _diffuse);
+	ImGui::OsmColor("Ambient", _ambient);		
+
+	bool transparent = _layer == TRANSPARENT_LAYER;
+	if (ImGui::Checkbox("Transparent", &transparent))
+		_layer = transparent ? TRANSPARENT_LAYER : OPAQUE_LAYER;
+}
+#endif
+
+MeshRenderProxy::MeshRenderProxy(Shader* shader)
+	: _shader(shader)
+{
+	_projParam = shader->GetParameter(HashParameter("u_projection"));
+	_modelParam = shader->GetParameter(HashParameter("u_model"));
+	_viewParam = shader->GetParameter(HashParameter("u_view"));
+	_textureParam = shader->GetParameter(HashParameter("u_texture"));
+	_eyePosParam = shader->GetParameter(HashParameter("u_eyePos"));
+	_modelViewParam = shader->GetParameter(HashParameter("u_modelView"));
+	_modelViewProjParam = shader->GetParameter(HashParameter("u_modelViewProjection"));
 	_positionAttrib = shader->GetAttribute("a_position");
 	_normalAttrib = shader->GetAttribute("a_normal");
 	_textureAttrib = shader->GetAttribute("a_texture");
-	_directionaLightsCountParam = shader->GetParameter("u_directionalLightsCount");
-	_pointLightsCountParam = shader->GetParameter("u_pointLightsCount");
-	_diffuseParam = shader->GetParameter("u_diffuse");
-	_ambientParam = shader->GetParameter("u_ambient");
-	_fogNearParam = shader->GetParameter("u_fogNear");
-	_fogFarParam = shader->GetParameter("u_fogFar");
-	_fogExpParam = shader->GetParameter("u_fogExp");
-	_fogNearColorParam = shader->GetParameter("u_fogColorNear");
-	_fogFarColorParam = shader->GetParameter("u_fogColorFar");
-	_timeParam = shader->GetParameter("u_time");
+	_instanceModelAttrib = shader->GetAttribute("a_instanceModel");
+	_instanceDiffuseAttrib = shader->GetAttribute("a_instanceDiffuse");
+	_instanceAmbientAttrib = shader->GetAttribute("a_instanceAmbient");
+	_directionaLightsCountParam = shader->GetParameter(HashParameter("u_directionalLightsCount"));
+	_pointLightsCountParam = shader->GetParameter(HashParameter("u_pointLightsCount"));
+	_diffuseParam = shader->GetParameter(HashParameter("u_diffuse"));
+	_ambientParam = shader->GetParameter(HashParameter("u_ambient"));
+	_fogNearParam = shader->GetParameter(HashParameter("u_fogNear"));
+	_fogFarParam = shader->GetParameter(HashParameter("u_fogFar"));
+	_fogExpParam = shader->GetParameter(HashParameter("u_fogExp"));
+	_fogNearColorParam = shader->GetParameter(HashParameter("u_fogColorNear"));
+	_fogFarColorParam = shader->GetParameter(HashParameter("u_fogColorFar"));
+	_timeParam = shader->GetParameter(HashParameter("u_time"));
+
+	// Names are hashed piece by piece, so no strings get built
+	constexpr ParameterID dirLights = HashParameter("u_directionalLights[");
+	constexpr ParameterID pointLights = HashParameter("u_pointLights[");
+	constexpr ParameterID dirShadows = HashParameter("u_directionalShadows[");
 
 	for (int i = 0; i < kMaxDirecationalLights; i++)
 	{
-		string name = "u_directionalLights[" + to_string(i) + "]";
-		auto lprm = new LightShaderParameter(_shader, name);
+		auto lprm = new LightShaderParameter(_shader, HashElement(dirLights, i));
 		_dirLightParams.push_back(unique_ptr<LightShaderParameter>(lprm));
 	}
 
 	for (int i = 0; i < kMaxPointLights; i++)
 	{
-		string name = "u_pointLights[" + to_string(i) + "]";
-		auto lprm = new LightShaderParameter(_shader, name);
+		auto lprm = new LightShaderParameter(_shader, HashElement(pointLights, i));
 		_pointLightParams.push_back(unique_ptr<LightShaderParameter>(lprm));
 	}
 
-	if(_mesh)
-		CreateVAO();
+	for (int i = 0; i < kMaxDirecationalLights; i++)
+	{
+		ParameterID id = HashParameter(".shadowMap", HashElement(dirShadows, i));
+		_shadowMapParams.push_back(shader->GetParameter(id));
+	}
 }
 
-void MeshRenderer::ActivateShader(	Camera* camera,
-									const vector<Light*> lights)
+MeshRenderProxy::~MeshRenderProxy()
 {
-	_viewMatrix = camera->GetView();
-	_projectionMatrix = camera->Projection();
-	//Vector3 eyePos = -1.0f * _viewMatrix.GetTranslation();
-	auto viewInv = _viewMatrix;
-	viewInv.Invert();
-	Vector3 eyePos = viewInv * Vector3(0, 0, 0);
+	if (_vao)
+		gGLState.DeleteVertexArrays(1, &_vao);
+}
 
+void MeshRenderProxy::ActivateShader(	const CameraState& camera,
+									const RenderFrame& frame)
+{
 	_shader->Activate();
-	_projParam->SetValue(_projectionMatrix);
-	_viewParam->SetValue(_viewMatrix);
-	_eyePosParam->SetValue(eyePos);
-	_fogNearParam->SetValue(camera->GetFogNear());
-	_fogFarParam->SetValue(camera->GetFogFar());
-	_fogExpParam->SetValue(camera->GetFogGamma());
-	_fogNearColorParam->SetValue(camera->GetFogNearColor());
-	_fogFarColorParam->SetValue(camera->GetFogFarColor());
-	_timeParam->SetValue(Game.Time().ElapsedTime);
 
+	// Shaders on the uniform blocks already have the camera and lights,
+	// only the shadow maps need setting as samplers can't go in a block
+	if (_shader->UsesUniformBlocks())
+	{
+		int shadowIndex = 0;
+		for (const auto& l : frame.Lights)
+		{
+			if (l.Type != Light::DIRECTIONAL_LIGHT || shadowIndex == kMaxDirecationalLights)
+				continue;
+
+			if (l.CastShadow && l.Shadow->Target)
+				_shadowMapParams[shadowIndex]->SetValue(*l.Shadow->Target);
+			shadowIndex++;
+		}
+		return;
+	}
+
+	_projParam->SetValue(camera.Projection);
+	_viewParam->SetValue(camera.View);
+	_eyePosParam->SetValue(camera.Position);
+	_fogNearParam->SetValue(camera.FogNear);
+	_fogFarParam->SetValue(camera.FogFar);
+	_fogExpParam->SetValue(camera.FogGamma);
+	_fogNearColorParam->SetValue(camera.FogNearColor);
+	_fogFarColorParam->SetValue(camera.FogFarColor);
+	_timeParam->SetValue(frame.Time);
+
+	// Shaders on the blocks get every point light through the clusters,
+	// these ones still loop over a capped array, like Basic.vsh in Planets
 	int pointLightsCount = 0;
 	int dirLightsCount = 0;
 	size_t maxDir = _dirLightParams.size();
 	size_t maxPoint = _pointLightParams.size();
-	for (auto l : lights)
+	for (const auto& l : frame.Lights)
 	{
-		if(!l->GetEnbled())
-			continue;
-
-		if (l->GetLightType() == Light::DIRECTIONAL_LIGHT && dirLightsCount < (int)maxDir)
+		if (l.Type == Light::DIRECTIONAL_LIGHT && dirLightsCount < (int)maxDir)
 		{
-			_dirLightParams[dirLightsCount++]->SetValue(*l);
+			_dirLightParams[dirLightsCount++]->SetValue(l);
 		}
-		else if (l->GetLightType() == Light::POINT_LIGHT && pointLightsCount < (int)maxPoint)
+		else if (l.Type == Light::POINT_LIGHT && pointLightsCount < (int)maxPoint)
 		{
-			_pointLightParams[pointLightsCount++]->SetValue(*l);
+			_pointLightParams[pointLightsCount++]->SetValue(l);
 		}
 	}
 
@@ -114,70 +196,90 @@ void MeshRenderer::ActivateShader(	Camera* camera,
 	_pointLightsCountParam->SetValue(pointLightsCount);
 }
 
-void MeshRenderer::Draw()
+void MeshRenderProxy::Record(
+	const RenderItem& item,
+	const CameraState& camera,
+	DrawCommandBuffer& commands) const
 {
-#ifdef INSPECTOR
-	if (_shader->Reloaded)
-		CreateVAO();
-#endif	
-
-	const Matrix44& model = GetOwner().GetComponent<Transform>()->GetWorld();
-	Matrix44 modelView = _viewMatrix * model;
-	Matrix44 modelViewProjection = _projectionMatrix * modelView;	
-
-	_modelParam->SetValue(model);
-	_modelViewParam->SetValue(modelView);
-	_modelViewProjParam->SetValue(modelViewProjection);
-	_diffuseParam->SetValue(_diffuse);
-	_ambientParam->SetValue(_ambient);
-	_textureParam->SetValue(*_texture);
+	const Matrix44& model = item.World;
+	Matrix44 modelView = camera.View * model;
+	Matrix44 modelViewProjection = camera.Projection * modelView;
+
+	commands.SetValue(_modelParam, model);
+	commands.SetValue(_modelViewParam, modelView);
+	commands.SetValue(_modelViewProjParam, modelViewProjection);
+	commands.SetValue(_diffuseParam, item.Diffuse);
+	commands.SetValue(_ambientParam, item.Ambient);
+	commands.SetValue(_textureParam, *item.Texture);
+	commands.Draw(item);
+}
 
-	glBindVertexArray(_vao);
+bool MeshRenderProxy::SupportsInstancing() const
+{
+	return _instanceModelAttrib && _instanceModelAttrib->IsValid();
+}
 
-	const void* firstIndex = reinterpret_cast<const void*>(0);
-	glDrawElements(GL_TRIANGLES, _mesh->GetIndexCount(), GL_UNSIGNED_SHORT, firstIndex);
+void MeshRenderProxy::RecordInstanced(
+	const vector<const RenderItem*>& items,
+	const CameraState& camera,
+	DrawCommandBuffer& commands) const
+{
+	const RenderItem& first = *items[0];
+	commands.SetValue(_textureParam, *first.Texture);
+
+	// The instances go straight into the command buffer
+	auto instances = static_cast<InstanceData*>(commands.DrawInstanced(
+		first,
+		(uint)items.size(),
+		(uint)sizeof(InstanceData)));
+	for (size_t i = 0; i < items.size(); i++)
+		instances[i] = { items[i]->World, items[i]->Diffuse, items[i]->Ambient };
+}
 
-	glBindVertexArray(0);
+void MeshRenderProxy::RecordDepth(const RenderItem& item, DrawCommandBuffer& commands) const
+{
+	commands.Draw(item);
 }
 
-void MeshRenderer::DrawDepth(Matrix44 viewProjection)
+void MeshRenderProxy::Bind(const RenderItem& item, const void* instances, size_t size)
 {
-	glBindVertexArray(_vao);
-
-	glDrawElements(GL_TRIANGLES, _mesh->GetIndexCount(), GL_UNSIGNED_SHORT, nullptr);
-
-	glBindVertexArray(0);
-
-	/*
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(
-		0,						// attribute
-		3,						// number of elements per vertex element
-		GL_FLOAT,				// the type of each element
-		GL_FALSE,				// take our values as-is or normalize
-		sizeof(VertexFormat),	// no extra data between each position
-		0						// offset of first element
-	);
-	*/
+#ifdef INSPECTOR
+	if (_shader->Reloaded)
+		_vaoVersion = 0;
+#endif	
+	if (_vaoVersion != item.Version)
+		CreateVAO(item);
+
+	if (instances)
+	{
+		// Orphan the last batch's storage rather than wait for it to draw
+		gGLState.BindBuffer(GL_ARRAY_BUFFER, _instanceBuffer);
+		glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)size, instances, GL_STREAM_DRAW);
+		gUploadedBytes += (int64_t)size;
+	}
+
+	// Left bound, the next draw with the same mesh skips the bind
+	gGLState.BindVertexArray(_vao);
 }
 
-bool MeshRenderer::CreateVAO()
+bool MeshRenderProxy::CreateVAO(const RenderItem& item)
 {
+	_vaoVersion = item.Version;
+
 	if (_vao != 0)
 	{
-		glBindVertexArray(0);
-		glDeleteVertexArrays(1, &_vao);
+		gGLState.DeleteVertexArrays(1, &_vao);
 		_vao = 0;
 	}
 
 	glGenVertexArrays(1, &_vao);
-	glBindVertexArray(_vao);
+	gGLState.BindVertexArray(_vao);
 
-	const GLuint* vbo = _mesh->GetVertexBuffers();
+	const GLuint vbo[] = { item.VertexBuffer, item.IndexBuffer };
 
 	// Bind the buffers to the global state
-	glBindBuffer(GL_ARRAY_BUFFER, vbo[0]);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo[1]);
+	gGLState.BindBuffer(GL_ARRAY_BUFFER, vbo[0]);
+	gGLState.BindBuffer(GL_ELEMENT_ARRAY_BUFFER, vbo[1]);
 
 	
 #ifdef DEBUG
@@ -203,57 +305,70 @@ bool MeshRenderer::CreateVAO()
 	_normalAttrib->SetAttributePointer(3, GL_FLOAT, GL_FALSE, size, firstNormal);
 	_textureAttrib->SetAttributePointer(2, GL_FLOAT, GL_FALSE, size, firstTexture);
 
-	glBindVertexArray(0);
+	if (SupportsInstancing())
+	{
+		if (!_instanceBuffer)
+			glGenBuffers(1, &_instanceBuffer);
+		gGLState.BindBuffer(GL_ARRAY_BUFFER, _instanceBuffer);
+
+		// A matrix takes four attribute slots, one for each column
+		GLsizei stride = sizeof(InstanceData);
+		GLuint location = (GLuint)_instanceModelAttrib->GetLocation();
+		for (GLuint i = 0; i < 4; i++)
+		{
+			const void* column = reinterpret_cast<const void*>(offsetof(InstanceData, Model) + i * 4 * sizeof(float));
+			glEnableVertexAttribArray(location + i);
+			glVertexAttribPointer(location + i, 4, GL_FLOAT, GL_FALSE, stride, column);
+			glVertexAttribDivisorARB(location + i, 1);
+		}
 
-	return true;
-}
+		const void* firstDiffuse = reinterpret_cast<const void*>(offsetof(InstanceData, Diffuse));
+		const void* firstAmbient = reinterpret_cast<const void*>(offsetof(InstanceData, Ambient));
+		_instanceDiffuseAttrib->SetAttributePointer(4, GL_UNSIGNED_BYTE, GL_TRUE, stride, firstDiffuse);
+		_instanceAmbientAttrib->SetAttributePointer(4, GL_UNSIGNED_BYTE, GL_TRUE, stride, firstAmbient);
+		if (_instanceDiffuseAttrib->IsValid())
+			glVertexAttribDivisorARB(_instanceDiffuseAttrib->GetLocation(), 1);
+		if (_instanceAmbientAttrib->IsValid())
+			glVertexAttribDivisorARB(_instanceAmbientAttrib->GetLocation(), 1);
+	}
 
-#ifdef INSPECTOR
-void MeshRenderer::Inspect()
-{
-	ImGui::Checkbox("Enabled", &_enabled);
-	ImGui::OsmColor("Diffuse", _diffuse);
-	ImGui::OsmColor("Ambient", _ambient);		
+	return true;
 }
-#endif
 
-LightShaderParameter::LightShaderParameter(Shader* shader, const string& name) :
-	_positionParam(shader->GetParameter(name + ".position")),
-	_directionParam(shader->GetParameter(name + ".direction")),
-	_colorParam(shader->GetParameter(name + ".color")),
-	_radiusParam(shader->GetParameter(name + ".radius")),
-	_attenuationParam(shader->GetParameter(name + ".attenuation")),
-	_shadowInvTransform(shader->GetParameter(name + ".shadowInvTransform")),
-	_shadowMap(shader->GetParameter(name + ".shadowMap")),
-	_castShadow(shader->GetParameter(name + ".castShadow"))
+LightShaderParameter::LightShaderParameter(Shader* shader, ParameterID name) :
+	_positionParam(shader->GetParameter(HashParameter(".position", name))),
+	_directionParam(shader->GetParameter(HashParameter(".direction", name))),
+	_colorParam(shader->GetParameter(HashParameter(".color", name))),
+	_radiusParam(shader->GetParameter(HashParameter(".radius", name))),
+	_attenuationParam(shader->GetParameter(HashParameter(".attenuation", name))),
+	_shadowInvTransform(shader->GetParameter(HashParameter(".shadowInvTransform", name))),
+	_shadowMap(shader->GetParameter(HashParameter(".shadowMap", name))),
+	_castShadow(shader->GetParameter(HashParameter(".castShadow", name)))
 {}
 
-void LightShaderParameter::SetValue(const Light& light)
+void LightShaderParameter::SetValue(const LightState& light)
 {
-	_colorParam->SetValue(light.GetColorAsVector());
+	_colorParam->SetValue(light.Color);
 
-	if (light.GetLightType() == Light::DIRECTIONAL_LIGHT)
+	if (light.Type == Light::DIRECTIONAL_LIGHT)
 	{
-		Vector3 dir = light.GetDirection();
-		_directionParam->SetValue(dir);
+		_directionParam->SetValue(light.Direction);
 		
-		if(light.GetShadowCasting())
+		if(light.CastShadow && light.Shadow->Target)
 		{
 			_castShadow->SetValue(true);
-			_shadowInvTransform->SetValue(light._shadowMatrix);
-			const Texture* shadowMap = light.GetRenderTarget();
-			_shadowMap->SetValue(*shadowMap);
+			_shadowInvTransform->SetValue(light.ShadowMatrix);
+			_shadowMap->SetValue(*light.Shadow->Target);
 		}
 		else
 		{
 			_castShadow->SetValue(false);
 		}
 	}
-	else if (light.GetLightType() == Light::POINT_LIGHT)
+	else if (light.Type == Light::POINT_LIGHT)
 	{
-		Vector3 pos = light.GetPosition();
-		_positionParam->SetValue(pos);
-		_radiusParam->SetValue(light.GetRadius());
+		_positionParam->SetValue(light.Position);
+		_radiusParam->SetValue(light.Radius);
 	}
 }
 
@@ -1,26 +1,140 @@
 #include <Graphics/Render.h>
 #include <Core/Entity.h>
 #include <algorithm>
+#include <cstring>
 #include <Core/Transform.h>
 #include <Graphics/Shader.h>
 #include <Core/Game.h>
+#include <Core/Jobs.h>
 #include <imgui.h> 
 #include <Graphics/DebugRenderer.h>
 #include <Core/Resources.h>
 #include <Graphics/Texture.h>
-
-#define PROFILE_OPENGL 1
+#include <Graphics/GPUTimer.h>
+#include <Graphics/GLState.h>
+#include <Graphics/StreamBuffer.h>
+#include <Tools/Profiler.h>
+#include <Tools/Memory.h>
+#include <Tools/Counters.h>
 
 using namespace Osm;
 
+namespace
+{
+	Counter gDrawCalls("Draw Calls");
+	Counter gShaderSwitches("Shader Switches");
+	Counter gRenderItems("Render Items");
+	Counter gLights("Lights");
+	Counter gInstances("Instances");
+	Counter gCulled("Culled");
+	Counter gUploadedBytes("Uploaded Bytes");
+	Counter gCommandBytes("Draw Command Bytes");
+	Counter gStorageGrows("Cluster Buffer Grows");
+
+	// Sorted draws per recording job, small enough to spread over the workers
+	const uint kDrawsPerChunk = 128;
+
+	constexpr ParameterID kModelViewProjection = HashParameter("u_modelViewProjection");
+	constexpr ParameterID kFrameBufSize = HashParameter("frameBufSize");
+
+	// Uniform blocks of a frame, the lights and a few cameras
+	const size_t kUniformStreamSize = 64 * 1024;
+
+	// Light clusters of a frame to start with, grows when a frame needs more
+	const size_t kStorageStreamSize = 256 * 1024;
+
+	// Empty ranges can't be bound, so empty storage blocks still get this much
+	const size_t kMinStorageBlockSize = 16;
+
+	// Every upload gets its own range of the frame's region, so the draws
+	// that read the last upload are never waited on or overwritten
+	void UploadUniformBlock(
+		StreamBuffer& stream,
+		size_t alignment,
+		UniformBinding binding,
+		const void* data,
+		size_t size)
+	{
+		size_t offset = 0;
+		void* dst = stream.Map(size, alignment, offset);
+		ASSERT(dst);
+		if (!dst)
+			return;
+
+		memcpy(dst, data, size);
+		stream.Unmap();
+
+		// Binding a range binds the buffer too, keep the cache in step
+		gGLState.BindBuffer(GL_UNIFORM_BUFFER, stream.GetBuffer());
+		glBindBufferRange(GL_UNIFORM_BUFFER, binding, stream.GetBuffer(), (GLintptr)offset, (GLsizeiptr)size);
+		gUploadedBytes += (int64_t)size;
+	}
+
+	Vector4 ToVector4(const Color& color)
+	{
+		return Vector4(color.r / 255.0f, color.g / 255.0f, color.b / 255.0f, color.a / 255.0f);
+	}
+}
+
 const unsigned int SHADOW_WIDTH = 1024, SHADOW_HEIGHT = 1024;
 
 RenderManager::RenderManager(World& world) : Component(world)
 {
-#if defined(INSPECTOR) && PROFILE_OPENGL 
-	glGenQueries(RENDER_PASSES_NUM, _queries);
-#endif
+	_frames[0] = std::make_unique<RenderFrame>();
+	_frames[1] = std::make_unique<RenderFrame>();
+
+	// Render components are still around when headless, but never draw
+	if (Game.IsHeadless())
+	{
+		_enabled = false;
+		return;
+	}
+
+	// Shadows end stuff	
+	_fullScreenPass = Game.Resources().LoadResource<Shader>(
+		"./Assets/Shaders/Include/RenderTexture.vsh",
+		"./Assets/Shaders/Include/RenderTexture.fsh");
+
+	_shadowPass = Game.Resources().LoadResource<Shader>(
+		"./Assets/Shaders/Include/DepthOnly.vsh",
+		"./Assets/Shaders/Include/DepthOnly.fsh");
 
+	/*
+	_bloomShader = Game.Resources().LoadResource<Shader>(
+		"./Assets/Shaders/Include/RenderTexture.vsh",
+		"./Assets/Shaders/Include/Bloom.fsh");
+	*/
+
+	_FXAAShader = Game.Resources().LoadResource<Shader>(
+		"./Assets/Shaders/Include/FXAA.vsh",
+		"./Assets/Shaders/Include/FXAA.fsh");
+}
+
+RenderManager::~RenderManager()
+{
+	if (!_msaaFramebuffer)
+		return;
+
+	// Framebuffers belong to the rendering context, so delete them there
+	GLuint textures[] = { _msaaColorbuffer, _reslovedColorbuffer };
+	GLuint renderbuffers[] = { _msaaDepthbuffer, _reslovedDepthbuffer };
+	GLuint framebuffers[] = { _msaaFramebuffer, _reslovedFramebuffer };
+	auto uniforms = std::make_unique<StreamBuffer>(_uniformStream);
+	auto storage = std::make_unique<StreamBuffer>(_storageStream);
+	Game.QueueRenderCommand([textures, renderbuffers, framebuffers,
+		uniforms = std::move(uniforms), storage = std::move(storage)]()
+	{
+		gGLState.BindFramebuffer(GL_FRAMEBUFFER, 0);
+		gGLState.DeleteTextures(2, textures);
+		glDeleteRenderbuffers(2, renderbuffers);
+		gGLState.DeleteFramebuffers(2, framebuffers);
+		uniforms->Release();
+		storage->Release();
+	});
+}
+
+void RenderManager::CreateFramebuffers()
+{
 	// Get settings
 	const auto& settings = Game.Settings();
 	const auto width = settings.ScreenWidth;
@@ -28,12 +142,12 @@ RenderManager::RenderManager(World& world) : Component(world)
 
 	//  -- MSAA framebuffer --
 	glGenFramebuffers(1, &_msaaFramebuffer);					// Create
-	glBindFramebuffer(GL_FRAMEBUFFER, _msaaFramebuffer);		// Bind FBO
+	gGLState.BindFramebuffer(GL_FRAMEBUFFER, _msaaFramebuffer);		// Bind FBO
 	// Color buffer
 	glGenTextures(1, &_msaaColorbuffer);						// Create MSAA color attachent
-	glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, _msaaColorbuffer);	// Bind
+	gGLState.BindTexture(GL_TEXTURE_2D_MULTISAMPLE, _msaaColorbuffer);	// Bind
 	glTexImage2DMultisample(GL_TEXTURE_2D_MULTISAMPLE, settings.MSAASamples, GL_RGB, width, height, GL_TRUE); // Set storage
-	glBindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);				// Unbind
+	gGLState.BindTexture(GL_TEXTURE_2D_MULTISAMPLE, 0);				// Unbind
 	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D_MULTISAMPLE, _msaaColorbuffer, 0);	// Attach it
 	// Depth buffer
 	glGenRenderbuffers(1, &_msaaDepthbuffer);					// Create
@@ -45,15 +159,15 @@ RenderManager::RenderManager(World& world) : Component(world)
 	// Check that our framebuffer is ok
 	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
 		ASSERT(false);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	gGLState.BindFramebuffer(GL_FRAMEBUFFER, 0);
 
 
 	// -- Resloved framebuffer --
 	glGenFramebuffers(1, &_reslovedFramebuffer);					// Create
-	glBindFramebuffer(GL_FRAMEBUFFER, _reslovedFramebuffer);		// Bind FBO
+	gGLState.BindFramebuffer(GL_FRAMEBUFFER, _reslovedFramebuffer);		// Bind FBO
 	// Color buffer
 	glGenTextures(1, &_reslovedColorbuffer);						// Resolved
-	glBindTexture(GL_TEXTURE_2D, _reslovedColorbuffer);				// Bind
+	gGLState.BindTexture(GL_TEXTURE_2D, _reslovedColorbuffer);				// Bind
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);	// Set storage
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);	// Filtering
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);	// Filtering
@@ -68,39 +182,128 @@ RenderManager::RenderManager(World& world) : Component(world)
 	// Check that our framebuffer is ok
 	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
 		ASSERT(false);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-	
-	// Shadows end stuff	
-	_fullScreenPass = Game.Resources().LoadResource<Shader>(
-		"./Assets/Shaders/Include/RenderTexture.vsh",
-		"./Assets/Shaders/Include/RenderTexture.fsh");
-
-	_shadowPass = Game.Resources().LoadResource<Shader>(
-		"./Assets/Shaders/Include/DepthOnly.vsh",
-		"./Assets/Shaders/Include/DepthOnly.fsh");
+	gGLState.BindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	// -- Uniform buffers --
+	GLint alignment = 0;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	_uniformAlignment = (size_t)std::max(alignment, 1);
+	_uniformStream.Create(GL_UNIFORM_BUFFER, kUniformStreamSize);
+
+	// -- Light cluster buffers --
+	glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	_storageAlignment = (size_t)std::max(alignment, 1);
+	_storageStream.Create(GL_SHADER_STORAGE_BUFFER, kStorageStreamSize);
+}
 
-	/*
-	_bloomShader = Game.Resources().LoadResource<Shader>(
-		"./Assets/Shaders/Include/RenderTexture.vsh",
-		"./Assets/Shaders/Include/Bloom.fsh");
-	*/
+void RenderManager::UploadFrameUniforms(const RenderFrame& frame)
+{
+	FrameUniforms frameUniforms = {};
+	frameUniforms.Time = frame.Time;
+	UploadUniformBlock(
+		_uniformStream,
+		_uniformAlignment,
+		FRAME_UNIFORMS_BINDING,
+		&frameUniforms,
+		sizeof(frameUniforms));
+
+	LightUniforms lights = {};
+	for (const auto& l : frame.Lights)
+	{
+		if (l.Type == Light::DIRECTIONAL_LIGHT && lights.DirectionalLightsCount < kMaxDirectionalLights)
+		{
+			auto& dir = lights.DirectionalLights[lights.DirectionalLightsCount++];
+			dir.Direction = l.Direction;
+			dir.Color = l.Color;
+			dir.CastShadow = l.CastShadow && l.Shadow->Target ? 1 : 0;
+			dir.ShadowInvTransform = l.ShadowMatrix;
+		}
+	}
+	UploadUniformBlock(
+		_uniformStream,
+		_uniformAlignment,
+		LIGHT_UNIFORMS_BINDING,
+		&lights,
+		sizeof(lights));
+}
 
-	_FXAAShader = Game.Resources().LoadResource<Shader>(
-		"./Assets/Shaders/Include/FXAA.vsh",
-		"./Assets/Shaders/Include/FXAA.fsh");
+void RenderManager::UploadCameraUniforms(const CameraState& camera, const LightClusters& clusters)
+{
+	CameraUniforms cameraUniforms = {};
+	cameraUniforms.Projection = camera.Projection;
+	cameraUniforms.View = camera.View;
+	cameraUniforms.EyePos = camera.Position;
+	cameraUniforms.FogNear = camera.FogNear;
+	cameraUniforms.FogColorNear = ToVector4(camera.FogNearColor);
+	cameraUniforms.FogColorFar = ToVector4(camera.FogFarColor);
+	cameraUniforms.FogFar = camera.FogFar;
+	cameraUniforms.FogExp = camera.FogGamma;
+	cameraUniforms.ClusterScale = clusters.GetSliceScale();
+	cameraUniforms.ClusterBias = clusters.GetSliceBias();
+	UploadUniformBlock(
+		_uniformStream,
+		_uniformAlignment,
+		CAMERA_UNIFORMS_BINDING,
+		&cameraUniforms,
+		sizeof(cameraUniforms));
 }
 
-RenderManager::~RenderManager()
+void RenderManager::UploadClusters(const LightClusters& clusters)
 {
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	const auto& lights = clusters.GetLights();
+	const auto& cells = clusters.GetClusters();
+	const auto& indices = clusters.GetIndices();
+	const void* data[STORAGE_BINDINGS_NUM] = { lights.data(), cells.data(), indices.data() };
+	const size_t sizes[STORAGE_BINDINGS_NUM] =
+	{
+		lights.size() * sizeof(PointLightUniforms),
+		cells.size() * sizeof(ClusterUniforms),
+		indices.size() * sizeof(uint)
+	};
+
+	// All the blocks in one range, each of them starting aligned
+	size_t offsets[STORAGE_BINDINGS_NUM];
+	size_t total = 0;
+	for (uint b = 0; b < STORAGE_BINDINGS_NUM; b++)
+	{
+		total = (total + _storageAlignment - 1) / _storageAlignment * _storageAlignment;
+		offsets[b] = total;
+		total += std::max(sizes[b], kMinStorageBlockSize);
+	}
 
-	glDeleteTextures(1, &_msaaColorbuffer);
-	glDeleteRenderbuffers(1, &_msaaDepthbuffer);
-	glDeleteFramebuffers(1, &_msaaFramebuffer);
+	size_t start = 0;
+	uchar* dst = static_cast<uchar*>(_storageStream.Map(total, _storageAlignment, start));
+	if (!dst)
+	{
+		// The draws of the ranges bound so far are already issued, so a new
+		// buffer can take over. Room for a few cameras this size.
+		gStorageGrows.Add();
+		_storageStream.Create(
+			GL_SHADER_STORAGE_BUFFER,
+			std::max(_storageStream.GetRegionSize() * 2, total * 4));
+		dst = static_cast<uchar*>(_storageStream.Map(total, _storageAlignment, start));
+	}
+	ASSERT(dst);
+	if (!dst)
+		return;
 
-	glDeleteTextures(1, &_reslovedColorbuffer);
-	glDeleteRenderbuffers(1, &_reslovedDepthbuffer);
-	glDeleteFramebuffers(1, &_reslovedFramebuffer);
+	for (uint b = 0; b < STORAGE_BINDINGS_NUM; b++)
+	{
+		if (sizes[b])
+			memcpy(dst + offsets[b], data[b], sizes[b]);
+	}
+	_storageStream.Unmap();
+
+	for (uint b = 0; b < STORAGE_BINDINGS_NUM; b++)
+	{
+		glBindBufferRange(
+			GL_SHADER_STORAGE_BUFFER,
+			b,
+			_storageStream.GetBuffer(),
+			(GLintptr)(start + offsets[b]),
+			(GLsizeiptr)std::max(sizes[b], kMinStorageBlockSize));
+	}
+	gUploadedBytes += (int64_t)total;
 }
 
 
@@ -122,165 +325,391 @@ void RenderQuad()
 		// setup plane VAO
 		glGenVertexArrays(1, &quadVAO);
 		glGenBuffers(1, &quadVBO);
-		glBindVertexArray(quadVAO);
-		glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+		gGLState.BindVertexArray(quadVAO);
+		gGLState.BindBuffer(GL_ARRAY_BUFFER, quadVBO);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(quadVertices), &quadVertices, GL_STATIC_DRAW);
 		glEnableVertexAttribArray(0);
 		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
 		glEnableVertexAttribArray(1);
 		glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
 	}
-	glBindVertexArray(quadVAO);
+	gGLState.BindVertexArray(quadVAO);
 	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
-	glBindVertexArray(0);
+}
+
+void RenderManager::Extract()
+{
+	PROFILE_FUNCTION();
+	MEMORY_SCOPE(MEMORY_TAG_RENDER);
+
+	if (!_enabled)
+		return;
+
+	RenderFrame& frame = *_frames[_extractFrame];
+	frame.Items.clear();
+	frame.Lights.clear();
+	frame.Cameras.clear();
+	frame.Time = Game.Time().ElapsedTime;
+
+	for (auto c : _cameras)
+	{
+		frame.Cameras.push_back(CameraState());
+		c->Extract(frame.Cameras.back());
+	}
+
+	for (auto l : _lights)
+	{
+		if (!l->GetEnbled())
+			continue;
+
+		frame.Lights.push_back(LightState());
+		l->Extract(frame.Lights.back());
+
+		if (l->GetLightType() == Light::POINT_LIGHT)
+		{
+			gDebugRenderer.AddSphere(
+				DebugRenderer::Categories::RENDERING,
+				l->GetPosition(),
+				l->GetRadius(),
+				l->GetColor());
+		}
+	}
+
+	for (auto r : _renderables)
+	{
+		if (!r->GetEnbled())
+			continue;
+
+		frame.Items.push_back(RenderItem());
+		r->Extract(frame.Items.back());
+	}
+}
+
+void RenderManager::SwapFrames()
+{
+	_extractFrame = 1 - _extractFrame;
 }
 
 void RenderManager::Render()
 {
+	PROFILE_FUNCTION();
+	MEMORY_SCOPE(MEMORY_TAG_RENDER);
+
 	if (!_enabled)
 		return;
 
+	if (!_msaaFramebuffer)
+		CreateFramebuffers();
+
+	// Draw the last frame that was extracted
+	const RenderFrame& frame = *_frames[1 - _extractFrame];
+
 	// Get settings
 	const auto& settings = Game.Settings();
 	const auto width = settings.ScreenWidth;
 	const auto height = settings.ScreenHeight;
 
-#if defined(INSPECTOR)
-	DrawCalls = 0;
-	ShaderSwitches = 0;
-#if PROFILE_OPENGL
-	if (!_firstFrame)
-		glGetQueryObjectuiv(_queries[FORWARD_PASS],
-			GL_QUERY_RESULT,
-			&_queryResults[FORWARD_PASS]);
+	gRenderItems += (int64_t)frame.Items.size();
+	gLights += (int64_t)frame.Lights.size();
+	int drawCalls = 0;
+	int shaderSwitches = 0;
+	int instances = 0;
+	int culled = 0;
 
-	glBeginQuery(GL_TIME_ELAPSED, _queries[FORWARD_PASS]);
-#endif
-#endif
+	// Shared by every program, so shader switches don't upload any of it
+	UploadFrameUniforms(frame);
 
-	for (auto l : _lights)
+	// Everything gets culled against the same bounds, once per view
+	_bounds.Clear();
+	for (const auto& item : frame.Items)
 	{
-		if(l->GetShadowCasting())
-		{
-			if (!l->_shadowMapFBO)
-				l->CreateShadowBuffer();
-			ASSERT(l->_shadowMapFBO);
-
-			glViewport(0, 0, l->GetShadowResolution(), l->GetShadowResolution());
-			glBindFramebuffer(GL_FRAMEBUFFER, l->_shadowMapFBO);
-			glClear(GL_DEPTH_BUFFER_BIT);
-			glEnable(GL_CULL_FACE);
-			glEnable(GL_DEPTH_TEST);
-
-			Matrix44 view = l->GetOwner().GetComponent<Transform>()->GetWorld();
-			view.Invert();
-			//view = Matrix44::CreateIdentity();
-
-			float size = 100.0f;
-			Matrix44 proj = Matrix44::CreateOrtho(
-				-l->_shadowVolume.x, l->_shadowVolume.x,
-				-l->_shadowVolume.y, l->_shadowVolume.y,
-				-l->_shadowVolume.z, l->_shadowVolume.y);
-
-			l->_shadowMatrix = proj * view;
-
-			_shadowPass->Activate();
-			for (auto r : _renderables)
-			{
-				if(!r->GetEnbled())
-					continue;
-
-				Matrix44 model;
-				auto t = r->GetOwner().GetComponent<Transform>();
-				if (t)
-					model = t->GetWorld();
-				Matrix44 mvp = l->_shadowMatrix * model;
-				_shadowPass->GetParameter("u_modelViewProjection")->SetValue(mvp);
-				Matrix44 identity;
-				r->DrawDepth(identity);
-			}
+		if (item.BoundsRadius < 0.0f)
+			_bounds.AddUnbounded();
+		else
+			_bounds.Add(item.BoundsCenter, item.BoundsExtents, item.BoundsRadius);
+	}
 
-			glBindFramebuffer(GL_FRAMEBUFFER, 0);
-		}
+	// Shadow casting lights first, then the cameras
+	uint shadowViews = 0;
+	for (const auto& l : frame.Lights)
+		shadowViews += l.CastShadow ? 1 : 0;
+	const uint viewCount = shadowViews + (uint)frame.Cameras.size();
+	_views.resize(viewCount);
+
+	uint v = 0;
+	for (const auto& l : frame.Lights)
+	{
+		if (!l.CastShadow)
+			continue;
+
+		// The shadow matrix is an ortho projection of the shadow volume
+		_views[v].Camera = nullptr;
+		_views[v].Light = &l;
+		_views[v].Frustum = Frustum::FromMatrix(l.ShadowMatrix);
+		v++;
+	}
+	for (const auto& c : frame.Cameras)
+	{
+		_views[v].Camera = &c;
+		_views[v].Light = nullptr;
+		_views[v].Frustum = Frustum::FromMatrix(c.Projection * c.View);
+		v++;
 	}
 
+	auto& jobs = Game.Jobs();
+	{
+		PROFILE_SCOPE("Cull");
+		jobs.ParallelFor(viewCount, 1, [this, &frame](uint begin, uint end)
+		{
+			for (uint i = begin; i < end; i++)
+				PrepareView(frame, _views[i]);
+		});
+	}
 
-	glViewport(0, 0, width, height);
-	glBindFramebuffer(GL_FRAMEBUFFER, _msaaFramebuffer);
-	const Color clear = _cameras.size() > 0 ? _cameras[0]->GetClearColor() : Color::Black;
-	glClearColor(clear.r / 255.0f, clear.g / 255.0f, clear.b / 255.0f, 10.0f);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glEnable(GL_CULL_FACE);
-	glEnable(GL_DEPTH_TEST);
-	glEnable(GL_SAMPLE_ALPHA_TO_COVERAGE);
-	
-	for (auto l : _lights)
+	// Cut every view into chunks that can be recorded on their own
+	uint chunkCount = 0;
+	for (uint i = 0; i < viewCount; i++)
 	{
-		if (l->GetLightType() == Light::POINT_LIGHT)
+		const auto& entries = _views[i].Queue.GetEntries();
+		const uint count = (uint)entries.size();
+		uint begin = 0;
+		while (begin < count)
 		{
-			gDebugRenderer.AddSphere(
-				DebugRenderer::Categories::RENDERING,
-				l->GetPosition(),
-				l->GetRadius(),
-				l->GetColor());
+			RenderLayer layer = RenderQueue::GetLayer(entries[begin].Key);
+			uint end = begin + 1;
+			while (end < count &&
+				end - begin < kDrawsPerChunk &&
+				RenderQueue::GetLayer(entries[end].Key) == layer)
+				end++;
+
+			if (chunkCount == _chunks.size())
+				_chunks.emplace_back();
+			DrawChunk& chunk = _chunks[chunkCount++];
+			chunk.View = i;
+			chunk.Begin = begin;
+			chunk.End = end;
+			chunk.Layer = layer;
+			begin = end;
 		}
 	}
 
-	Shader* activeShader = nullptr;
-	
-	for (auto c : _cameras)
 	{
-		// Matrix44 view = c->GetView();
-		// Matrix44 projection = c->Projection();
-
-		for (auto renderer : _renderables)
+		PROFILE_SCOPE("Record");
+		_shadowTransformParam = _shadowPass->GetParameter(kModelViewProjection);
+		jobs.ParallelFor(chunkCount, 1, [this, &frame](uint begin, uint end)
 		{
-			if(!renderer->GetEnbled())
-				continue;
+			for (uint i = begin; i < end; i++)
+				RecordChunk(frame, _chunks[i]);
+		});
+	}
+
+	for (uint i = 0; i < viewCount; i++)
+		culled += (int)_views[i].Culled;
+	for (uint i = 0; i < chunkCount; i++)
+	{
+		drawCalls += _chunks[i].DrawCalls;
+		shaderSwitches += _chunks[i].ShaderSwitches;
+		instances += _chunks[i].Instances;
+		gCommandBytes += (int64_t)_chunks[i].Commands.GetSize();
+	}
+
+	// Replay in the order the chunks were cut, views come in order
+	uint chunk = 0;
+	uint shadowPass = gGPUTimer.Begin("Shadow");
+	for (uint i = 0; i < shadowViews; i++)
+	{
+		const LightState& l = *_views[i].Light;
+		ShadowBuffer* shadow = l.Shadow;
+		if (shadow->Resolution != l.ShadowResolution)
+			shadow->Create(l.ShadowResolution);
+		ASSERT(shadow->Framebuffer);
+
+		gGLState.Viewport(0, 0, l.ShadowResolution, l.ShadowResolution);
+		gGLState.BindFramebuffer(GL_FRAMEBUFFER, shadow->Framebuffer);
+		glClear(GL_DEPTH_BUFFER_BIT);
+		gGLState.Enable(GL_CULL_FACE);
+		gGLState.Enable(GL_DEPTH_TEST);
+
+		for (; chunk < chunkCount && _chunks[chunk].View == i; chunk++)
+			_chunks[chunk].Commands.Execute();
+	}
+	gGPUTimer.End(shadowPass);
+
+	uint forwardPass = gGPUTimer.Begin("Forward");
 
-			if (renderer->GetShader() != activeShader)
+	gGLState.Viewport(0, 0, width, height);
+	gGLState.BindFramebuffer(GL_FRAMEBUFFER, _msaaFramebuffer);
+	const Color clear = frame.Cameras.size() > 0 ? frame.Cameras[0].ClearColor : Color::Black;
+	glClearColor(clear.r / 255.0f, clear.g / 255.0f, clear.b / 255.0f, 10.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	gGLState.Enable(GL_CULL_FACE);
+	gGLState.Enable(GL_DEPTH_TEST);
+	gGLState.Enable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+
+	for (uint i = shadowViews; i < viewCount; i++)
+	{
+		UploadCameraUniforms(*_views[i].Camera, _views[i].Clusters);
+		UploadClusters(_views[i].Clusters);
+
+		RenderLayer activeLayer = OPAQUE_LAYER;
+		for (; chunk < chunkCount && _chunks[chunk].View == i; chunk++)
+		{
+			if (_chunks[chunk].Layer != activeLayer)
 			{
-				renderer->ActivateShader(c, _lights);
-				activeShader = renderer->GetShader();
-#ifdef INSPECTOR
-				ShaderSwitches++;
-#endif
+				// Blend over what is there, without hiding what is behind
+				gGLState.Disable(GL_SAMPLE_ALPHA_TO_COVERAGE);
+				gGLState.Enable(GL_BLEND);
+				gGLState.BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+				gGLState.DepthMask(false);
+				activeLayer = _chunks[chunk].Layer;
 			}
-			renderer->Draw();
-#ifdef INSPECTOR
-			DrawCalls++;
-#endif
+			_chunks[chunk].Commands.Execute();
+		}
+
+		if (activeLayer != OPAQUE_LAYER)
+		{
+			gGLState.Disable(GL_BLEND);
+			gGLState.DepthMask(true);
+			gGLState.Enable(GL_SAMPLE_ALPHA_TO_COVERAGE);
 		}
 	}
 
-#if defined(INSPECTOR)
-	DrawCalls = 0;
-#if PROFILE_OPENGL
-	glEndQuery(GL_TIME_ELAPSED);	
-	_firstFrame = false;
-#endif	
-#endif
+	gGPUTimer.End(forwardPass);
 
-	glBindFramebuffer(GL_READ_FRAMEBUFFER, _msaaFramebuffer);
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, _reslovedFramebuffer);
+	uint resolvePass = gGPUTimer.Begin("Resolve");
+	gGLState.BindFramebuffer(GL_READ_FRAMEBUFFER, _msaaFramebuffer);
+	gGLState.BindFramebuffer(GL_DRAW_FRAMEBUFFER, _reslovedFramebuffer);
 	glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	gGPUTimer.End(resolvePass);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	gGLState.BindFramebuffer(GL_FRAMEBUFFER, 0);
 	glClearColor(1.0f, 0.0f, 0.0f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	glDisable(GL_CULL_FACE);
-	glDisable(GL_DEPTH_TEST);
+	gGLState.Disable(GL_CULL_FACE);
+	gGLState.Disable(GL_DEPTH_TEST);
 	
+	uint fxaaPass = gGPUTimer.Begin("FXAA");
 	_FXAAShader->Activate();
-	_FXAAShader->GetParameter("frameBufSize")->SetValue(
+	_FXAAShader->GetParameter(kFrameBufSize)->SetValue(
 		Vector2((float)width, (float)height));
 
-	uint program = _FXAAShader->GetProgram();	
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, _reslovedColorbuffer);
+	gGLState.BindTexture(0, GL_TEXTURE_2D, _reslovedColorbuffer);
 	
 	RenderQuad();
+	gGPUTimer.End(fxaaPass);
+
+	_uniformStream.EndFrame();
+	_storageStream.EndFrame();
+
+	gDrawCalls += drawCalls + 1;
+	gShaderSwitches += shaderSwitches;
+	gInstances += instances;
+	gCulled += culled;
+}
+
+void RenderManager::PrepareView(const RenderFrame& frame, RenderView& view) const
+{
+	view.Culled = _bounds.Cull(view.Frustum, view.Visible);
+
+	// Every camera gets its own froxels, the slices go wide on the workers
+	if (view.Camera)
+		view.Clusters.Build(*view.Camera, frame.Lights);
+
+	view.Queue.Clear();
+	for (size_t i = 0; i < frame.Items.size(); i++)
+	{
+		if (!view.Visible[i])
+			continue;
+
+		const RenderItem& item = frame.Items[i];
+		uint64_t key;
+		if (view.Camera)
+		{
+			Vector3 position = view.Camera->View * item.World.GetTranslation();
+			key = RenderQueue::MakeKey(
+				item.Layer,
+				item.Shader ? item.Shader->GetProgram() : 0,
+				item.Texture ? item.Texture->GetTexture() : 0,
+				item.VertexBuffer,
+				-position.z);
+		}
+		else
+		{
+			// Depth only, so front to back is the only order that helps.
+			// Clip space depth of the ortho projection goes from -1 to 1.
+			Vector3 position = view.Light->ShadowMatrix * item.World.GetTranslation();
+			key = RenderQueue::MakeKey(OPAQUE_LAYER, 0, 0, 0, position.z + 1.0f);
+		}
+		view.Queue.Add(key, (uint)i);
+	}
+	view.Queue.Sort();
+}
+
+void RenderManager::RecordChunk(const RenderFrame& frame, DrawChunk& chunk) const
+{
+	const RenderView& view = _views[chunk.View];
+	const auto& entries = view.Queue.GetEntries();
+	DrawCommandBuffer& commands = chunk.Commands;
+	commands.Clear();
+	chunk.DrawCalls = 0;
+	chunk.ShaderSwitches = 0;
+	chunk.Instances = 0;
+
+	// Chunks get replayed after each other, so each one activates its
+	// own shader instead of relying on the chunk before it
+	if (!view.Camera)
+	{
+		commands.UseShader(_shadowPass);
+		for (uint e = chunk.Begin; e < chunk.End; e++)
+		{
+			const RenderItem& item = frame.Items[entries[e].Item];
+			commands.SetValue(_shadowTransformParam, view.Light->ShadowMatrix * item.World);
+			item.Proxy->RecordDepth(item, commands);
+			chunk.DrawCalls++;
+		}
+		return;
+	}
+
+	const CameraState& camera = *view.Camera;
+	Shader* activeShader = nullptr;
+	for (uint e = chunk.Begin; e < chunk.End; e++)
+	{
+		const RenderItem& item = frame.Items[entries[e].Item];
+		if (item.Shader != activeShader)
+		{
+			commands.ActivateShader(item.Proxy, camera, frame);
+			activeShader = item.Shader;
+			chunk.ShaderSwitches++;
+		}
+
+		if (item.Proxy->SupportsInstancing())
+		{
+			// Sorting put items with the same state next to each other
+			chunk.Batch.clear();
+			chunk.Batch.push_back(&item);
+			while (e + 1 < chunk.End)
+			{
+				const RenderItem& next = frame.Items[entries[e + 1].Item];
+				if (next.Shader != item.Shader ||
+					next.Texture != item.Texture ||
+					next.VertexBuffer != item.VertexBuffer ||
+					next.IndexBuffer != item.IndexBuffer ||
+					next.Layer != item.Layer ||
+					!next.Proxy->SupportsInstancing())
+					break;
+				chunk.Batch.push_back(&next);
+				e++;
+			}
+			item.Proxy->RecordInstanced(chunk.Batch, camera, commands);
+			chunk.Instances += (int)chunk.Batch.size();
+		}
+		else
+		{
+			item.Proxy->Record(item, camera, commands);
+		}
+		chunk.DrawCalls++;
+	}
 }
 
 void RenderManager::Add(Renderable* renderable)
@@ -300,6 +729,7 @@ void RenderManager::Add(Camera* camera)
 
 void RenderManager::Remove(Renderable* renderable)
 {
+	// The frame in flight only points to the proxy, which outlives this
 	_renderables.erase(remove(_renderables.begin(), _renderables.end(), renderable));
 }
 
@@ -318,13 +748,12 @@ void RenderManager::Inspect()
 {
 	ImGui::Checkbox("Enabled", &_enabled);
 	ImGui::Text("Total renderables: %d", _renderables.size());
-	ImGui::Text("Draw Calls: %d", DrawCalls);
-	ImGui::Text("Shader Switches: %d", ShaderSwitches);
+	ImGui::Text("Draw Calls: %d", (int)gDrawCalls.GetLast());
+	ImGui::Text("Shader Switches: %d", (int)gShaderSwitches.GetLast());
 	
-#if PROFILE_OPENGL
-	double time = _queryResults[FORWARD_PASS] / 1000000.0;
-	ImGui::Text("Render Time: %.3f", time);
-#endif
+	ImGui::Text("GPU Time: %.3f ms", gGPUTimer.GetFrameMilliseconds());
+	for (const auto& r : gGPUTimer.GetResults())
+		ImGui::BulletText("%s: %.3f ms", r.Name, r.Milliseconds);
 }
 #endif
 
@@ -332,6 +761,31 @@ Renderable::Renderable(Entity& entity) :  RenderManagerComponent(entity)
 {
 }
 
+Renderable::~Renderable()
+{
+	SetProxy(nullptr);
+}
+
+void Renderable::SetProxy(RenderProxy* proxy)
+{
+	if (_proxy)
+	{
+		RenderProxy* old = _proxy;
+		Game.QueueRenderRelease([old]() { delete old; });
+	}
+	_proxy = proxy;
+}
+
+void Renderable::Extract(RenderItem& item) const
+{
+	item.Proxy = _proxy;
+	item.Shader = _shader;
+	item.Layer = _layer;
+	auto t = _owner.GetComponent<Transform>();
+	if (t)
+		item.World = t->GetWorld();
+}
+
 Camera::Camera(Entity& entity) : RenderManagerComponent(entity)
 {
 	_transform = _owner.GetComponent<Transform>();
@@ -346,17 +800,30 @@ Camera::Camera(Entity& entity) : RenderManagerComponent(entity)
 Matrix44 Camera::GetView() const
 {
 	Matrix44 view = _transform->GetWorld();
-	view.Invert();
+	view.InvertRigid();
 	return view;
 }
 
 void Camera::SetView(Matrix44 view)
 {
 	ASSERT(!_transform->GetParent());
-	view.Invert();
+	view.InvertRigid();
 	_transform->SetLocal(view);
 }
 
+void Camera::Extract(CameraState& state) const
+{
+	state.View = GetView();
+	state.Projection = _projection;
+	state.Position = _transform->GetWorld().GetTranslation();
+	state.FogNear = _fogNear;
+	state.FogFar = _fogFar;
+	state.FogGamma = _fogGamma;
+	state.FogNearColor = _fogNearColor;
+	state.FogFarColor = _fogFarColor;
+	state.ClearColor = _clearColor;
+}
+
 Light::Light(Entity& entity)
 	: RenderManagerComponent(entity)
 	, _lightType(DIRECTIONAL_LIGHT)
@@ -364,25 +831,66 @@ Light::Light(Entity& entity)
 {
 	_transform = _owner.GetComponent<Transform>();
 	ASSERT(_transform);
+	_shadowBuffer = new ShadowBuffer();
 }
 
 Light::~Light()
 {
+	// The frame in flight can still be rendering the shadows
+	ShadowBuffer* shadow = _shadowBuffer;
+	Game.QueueRenderRelease([shadow]() { delete shadow; });
 }
 
-void Light::CreateShadowBuffer()
+void Light::Extract(LightState& state)
 {
+	const Matrix44& world = _transform->GetWorld();
+
+	Matrix44 view = world;
+	view.InvertRigid();
+	Matrix44 proj = Matrix44::CreateOrtho(
+		-_shadowVolume.x, _shadowVolume.x,
+		-_shadowVolume.y, _shadowVolume.y,
+		-_shadowVolume.z, _shadowVolume.y);
+	_shadowMatrix = proj * view;
+
+	state.Shadow = _shadowBuffer;
+	state.Type = _lightType;
+	state.Position = world.GetTranslation();
+	state.Direction = GetDirection();
+	state.Color = GetColorAsVector();
+	state.Radius = _radius;
+	state.Attenuation = _attenuation;
+	state.CastShadow = _castShadow;
+	state.ShadowResolution = _shadowResolution;
+	state.ShadowMatrix = _shadowMatrix;
+}
+
+ShadowBuffer::~ShadowBuffer()
+{
+	if (Framebuffer)
+		gGLState.DeleteFramebuffers(1, &Framebuffer);
+	delete Target;
+}
+
+void ShadowBuffer::Create(int resolution)
+{
+	if (Framebuffer)
+		gGLState.DeleteFramebuffers(1, &Framebuffer);
+	delete Target;
+	Resolution = resolution;
+
 	// Shadows being made	
-	glGenFramebuffers(1, &_shadowMapFBO);
+	glGenFramebuffers(1, &Framebuffer);
 
-	glGenTextures(1, &_shadowMap);
-	glBindTexture(GL_TEXTURE_2D, _shadowMap);
+	GLuint depthMap = 0;
+	glGenTextures(1, &depthMap);
+	gGLState.BindTexture(GL_TEXTURE_2D, depthMap);
 	glTexImage2D(
 		GL_TEXTURE_2D,
 		0,
 		GL_DEPTH_COMPONENT,
-		_shadowResolution,
-		_shadowResolution,
+		resolution,
+		resolution,
 		0,
 		GL_DEPTH_COMPONENT,
 		GL_FLOAT,
@@ -394,12 +902,12 @@ void Light::CreateShadowBuffer()
 	// glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_R_TO_TEXTURE);
 	// glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_GREATER);
 
-	glBindFramebuffer(GL_FRAMEBUFFER, _shadowMapFBO);
+	gGLState.BindFramebuffer(GL_FRAMEBUFFER, Framebuffer);
 	glFramebufferTexture2D(
 		GL_FRAMEBUFFER,
 		GL_DEPTH_ATTACHMENT,
 		GL_TEXTURE_2D,
-		_shadowMap,
+		depthMap,
 		0);
 	glDrawBuffer(GL_NONE);
 	glReadBuffer(GL_NONE);
@@ -408,12 +916,8 @@ void Light::CreateShadowBuffer()
 	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
 		ASSERT(false);
 
-	_shadowTexture = new RenderTarget(_shadowMap);
-}
-
-void Light::DeleteShadowBuffer()
-{
-	// TODO: Cleanup here
+	Target = new RenderTarget(depthMap);
+	DepthMap = depthMap;
 }
 
 #ifdef INSPECTOR
@@ -435,25 +939,17 @@ void Light::Inspect()
 	ImGui::DragFloat("Intensity", &_intensity, 0.01f);
 	ImGui::DragFloat("Radius", &_radius, 0.1f);
 	// bool reCreateShadowBuff = false;
-	if(ImGui::Checkbox("Cast Shadows", &_castShadow))
-	{
-		if (_castShadow)
-			CreateShadowBuffer();
-		else
-			DeleteShadowBuffer();
-	}
+	// The render thread makes the shadow buffer match these
+	ImGui::Checkbox("Cast Shadows", &_castShadow);
 
 	if (_castShadow)
 	{
-		if (ImGui::InputInt("Shadow Resolution", &_shadowResolution))
-		{
-			DeleteShadowBuffer();
-			CreateShadowBuffer();
-		}
+		ImGui::InputInt("Shadow Resolution", &_shadowResolution);
 
-		if (_shadowMap != 0)
+		GLuint shadowMap = _shadowBuffer->DepthMap;
+		if (shadowMap != 0)
 		{
-			ImTextureID id = (void*)((UINT_PTR)(_shadowMap));
+			ImTextureID id = (void*)((UINT_PTR)(shadowMap));
 			auto w = ImGui::GetWindowWidth();
 			ImGui::Image(id, ImVec2(w, w));
 		}
@@ -0,0 +1,86 @@
+#include <Graphics/RenderQueue.h>
+#include <cstring>
+
+using namespace Osm;
+using namespace std;
+
+namespace
+{
+	const uint kIdBits		= 14;
+	const uint kDepthBits	= 20;
+	const uint64_t kIdMask		= (1ull << kIdBits) - 1;
+	const uint64_t kDepthMask	= (1ull << kDepthBits) - 1;
+
+	// The bits of a positive float sort the same as the float, so the top
+	// bits make a depth bucket that is finer close to the camera
+	uint64_t DepthBucket(float depth)
+	{
+		if (!(depth > 0.0f))
+			return 0;
+
+		uint32_t bits;
+		memcpy(&bits, &depth, sizeof(bits));
+		return (bits >> (31 - kDepthBits)) & kDepthMask;
+	}
+}
+
+uint64_t RenderQueue::MakeKey(
+	RenderLayer layer,
+	uint shader,
+	uint texture,
+	uint mesh,
+	float depth)
+{
+	// Opaque:		| layer 2 | shader 14 | texture 14 | mesh 14 | depth 20 |
+	// Transparent:	| layer 2 | far to near 20 | shader 14 | texture 14 | mesh 14 |
+	const uint64_t state =
+		((uint64_t)(shader & kIdMask) << (2 * kIdBits)) |
+		((uint64_t)(texture & kIdMask) << kIdBits) |
+		((uint64_t)(mesh & kIdMask));
+
+	uint64_t key = (uint64_t)layer << 62;
+	if (layer == TRANSPARENT_LAYER)
+		key |= ((kDepthMask - DepthBucket(depth)) << (3 * kIdBits)) | state;
+	else
+		key |= (state << kDepthBits) | DepthBucket(depth);
+	return key;
+}
+
+void RenderQueue::Sort()
+{
+	const size_t count = _entries.size();
+	if (count < 2)
+		return;
+
+	_scratch.resize(count);
+	Entry* src = _entries.data();
+	Entry* dst = _scratch.data();
+
+	// Least significant byte first, eight passes at most
+	for (uint shift = 0; shift < 64; shift += 8)
+	{
+		size_t offsets[256] = {};
+		for (size_t i = 0; i < count; i++)
+			offsets[(src[i].Key >> shift) & 0xFF]++;
+
+		// All keys share this byte, nothing to move
+		if (offsets[(src[0].Key >> shift) & 0xFF] == count)
+			continue;
+
+		size_t sum = 0;
+		for (size_t& o : offsets)
+		{
+			size_t c = o;
+			o = sum;
+			sum += c;
+		}
+
+		for (size_t i = 0; i < count; i++)
+			dst[offsets[(src[i].Key >> shift) & 0xFF]++] = src[i];
+
+		swap(src, dst);
+	}
+
+	if (src != _entries.data())
+		_entries.swap(_scratch);
+}
@@ -2,13 +2,25 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <Graphics/Texture.h>
+#include <Graphics/GLState.h>
 #include <Utils.h>
 #include <Graphics/Color.h>
+#include <Graphics/Uniforms.h>
 #include <Tools/ShaderPreprocessor.h>
+#include <Core/Game.h>
+#include <Tools/Counters.h>
+#include <cstring>
+#include <algorithm>
 
 using namespace std;
 using namespace Osm;
 
+namespace
+{
+	Counter gUniformUploads("Uniform Uploads");
+	Counter gSkippedUploads("Skipped Uniform Uploads");
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Compile shader and report success or failure
 ////////////////////////////////////////////////////////////////////////////////
@@ -111,13 +123,29 @@ bool ValidateProgram(GLuint prog)
 //
 ////////////////////////////////////////////////////////////////////////////////
 
+bool ShaderParameter::Update(const void* value, size_t size) const
+{
+	ASSERT(size <= sizeof(_value));
+	if (_cached && memcmp(_value, value, size) == 0)
+	{
+		++gSkippedUploads;
+		return false;
+	}
+
+	memcpy(_value, value, size);
+	_cached = true;
+	++gUniformUploads;
+	return true;
+}
+
 void ShaderParameter::SetValue(float val) const
 {
 	if (!IsValid())
 		return;
 
 	ASSERT(_type == GL_FLOAT);
-	glUniform1f(_location, val);
+	if (Update(&val, sizeof(val)))
+		glUniform1f(_location, val);
 	
 }
 
@@ -128,7 +156,8 @@ void ShaderParameter::SetValue(int val) const
 		return;
 
 	ASSERT(_type == GL_INT);
-	glUniform1i(_location, val);
+	if (Update(&val, sizeof(val)))
+		glUniform1i(_location, val);
 	
 }
 
@@ -138,7 +167,8 @@ void ShaderParameter::SetValue(uint val) const
 		return;
 
 	ASSERT(_type == GL_UNSIGNED_INT);
-	glUniform1ui(_location, val);
+	if (Update(&val, sizeof(val)))
+		glUniform1ui(_location, val);
 }
 
 void ShaderParameter::SetValue(bool val) const
@@ -147,7 +177,9 @@ void ShaderParameter::SetValue(bool val) const
 		return;
 
 	ASSERT(_type == GL_BOOL);
-	glUniform1i(_location, val);
+	GLint value = val ? 1 : 0;
+	if (Update(&value, sizeof(value)))
+		glUniform1i(_location, value);
 	
 }
 
@@ -157,7 +189,8 @@ void ShaderParameter::SetValue(const Vector2& vec) const
 		return;
 
 	ASSERT(_type == GL_FLOAT_VEC2);
-	glUniform2fv(_location, 1, &vec.x);
+	if (Update(&vec.x, sizeof(float) * 2))
+		glUniform2fv(_location, 1, &vec.x);
 	
 }
 
@@ -167,7 +200,8 @@ void ShaderParameter::SetValue(const Vector3& vec) const
 		return;
 
 	ASSERT(_type == GL_FLOAT_VEC3);
-	glUniform3fv(_location, 1, vec.f);
+	if (Update(vec.f, sizeof(float) * 3))
+		glUniform3fv(_location, 1, vec.f);
 	
 }
 
@@ -177,17 +211,27 @@ void ShaderParameter::SetValue(const Vector4& vec) const
 		return;
 
 	ASSERT(_type == GL_FLOAT_VEC4);
-	glUniform4fv(_location, 1, &vec.x);
+	if (Update(&vec.x, sizeof(float) * 4))
+		glUniform4fv(_location, 1, &vec.x);
 	
 }
 
 void ShaderParameter::SetValue(const Color& color)
 {
+	if (!IsValid())
+		return;
+
 	Vector4 c = { color.r / 255.0f, color.g / 255.0f, color.b / 255.0f, color.a / 255.0f };
 	if (_type == GL_FLOAT_VEC4)
-		glUniform4fv(_location, 1, &c.x);
+	{
+		if (Update(&c.x, sizeof(float) * 4))
+			glUniform4fv(_location, 1, &c.x);
+	}
 	else if (_type == GL_FLOAT_VEC3)
-		glUniform3fv(_location, 1, &c.x);
+	{
+		if (Update(&c.x, sizeof(float) * 3))
+			glUniform3fv(_location, 1, &c.x);
+	}
 	
 }
 
@@ -197,7 +241,17 @@ void ShaderParameter::SetValue(const Matrix44& mtx, bool transpose)
 		return;
 
 	ASSERT(_type == GL_FLOAT_MAT4);
-	glUniformMatrix4fv(_location, 1, transpose, mtx.f);
+
+	// The copy is of the untransposed matrix, so don't keep one then
+	if (transpose)
+	{
+		_cached = false;
+		glUniformMatrix4fv(_location, 1, transpose, mtx.f);
+		return;
+	}
+
+	if (Update(mtx.f, sizeof(mtx.f)))
+		glUniformMatrix4fv(_location, 1, transpose, mtx.f);
 	
 }
 
@@ -208,14 +262,13 @@ void ShaderParameter::SetValue(const Texture &texture)
 		return;
 
 	ASSERT(_type == GL_SAMPLER_2D);
-	// Use texture with index sampler. GL_TEXTURE1 = GL_TEXTURE1+1 is always true
-	glActiveTexture(GL_TEXTURE0 + _sampler);
-	
-	// Work with this texture
-	glBindTexture(GL_TEXTURE_2D, texture.GetTexture());
+	// Bind to the unit of this sampler. The binding is context state, not
+	// program state, so it's left to the state cache and not the uniform cache
+	gGLState.BindTexture(_sampler, GL_TEXTURE_2D, texture.GetTexture());
 	
 	// Set the sampler
-	glUniform1i(_location, _sampler);
+	if (Update(&_sampler, sizeof(_sampler)))
+		glUniform1i(_location, _sampler);
 	
 }
 
@@ -287,7 +340,7 @@ Shader::~Shader()
 {
 	if (_program > 0)
 	{
-		glDeleteProgram(_program);
+		gGLState.DeleteProgram(_program);
 		_program = 0;
 	}
 }
@@ -299,7 +352,7 @@ GLuint Shader::GetProgram() const
 
 void Osm::Shader::Deactivate()
 {
-	glUseProgram(0);
+	gGLState.UseProgram(0);
 }
 
 ullong Shader::CalculateResourceID(	const std::string& vertexFilename,
@@ -316,9 +369,13 @@ ullong Shader::CalculateResourceID(const std::string& vertexFilename, const std:
 
 void Shader::Reload()
 {
+	// Parameters stay invalid, so setting them does nothing
+	if (Game.IsHeadless())
+		return;
+
 	if (_program > 0)
 	{
-		glDeleteProgram(_program);
+		gGLState.DeleteProgram(_program);
 		_program = 0;
 	}
 
@@ -339,14 +396,27 @@ void Shader::Reload()
 	{
 		LoadParameters();
 	}
+
+	// The driver's binary is the closest thing to what lives on the GPU
+	GLint binaryLength = 0;
+	if (_program > 0)
+		glGetProgramiv(_program, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+	_gpuSize = (uint)binaryLength;
+	_size = (uint)(
+		_parameters.size() * sizeof(ParameterSlot) +
+		_parameterCount * sizeof(ShaderParameter) +
+		_attributes.size() * sizeof(ShaderAttribute));
 }
 
 void Shader::LoadParameters()
 {
 	// The shader should invalidate when reloading a new shader file
 	// as some information can be old
-	for (auto& itr : _parameters)
-		itr.second->Invalidate();
+	for (auto& slot : _parameters)
+	{
+		if (slot.Parameter)
+			slot.Parameter->Invalidate();
+	}
 	for (auto& itr : _attributes)
 		itr.second->Invalidate();
 
@@ -378,13 +448,26 @@ void Shader::LoadParameters()
 		string name(&uniformNameData[0], actualLength);
 		GLint location = glGetUniformLocation(_program, name.c_str());
 
-		auto itr = _parameters.find(name);
-		if (itr != _parameters.end())
+		ParameterID id = HashParameter(name.c_str());
+		ParameterSlot& slot = FindSlot(id);
+		if (slot.Parameter)
 		{
+			// Invalidating above cleared the names, so a named parameter came
+			// from this program. Lookups only go by the hash, so both names
+			// would get the same parameter.
+			if (!slot.Parameter->_name.empty())
+			{
+				LOG("Parameters %s and %s have the same hash, rename one of them",
+					slot.Parameter->_name.c_str(),
+					name.c_str());
+				ASSERT(false);
+				continue;
+			}
+
 			if (type == GL_SAMPLER_2D || type == GL_SAMPLER_CUBE)
-				itr->second->Reset(this, name, type, location, samplerCount++);		
+				slot.Parameter->Reset(this, name, type, location, samplerCount++);		
 			else
-				itr->second->Reset(this, name, type, location);
+				slot.Parameter->Reset(this, name, type, location);
 		}
 		else
 		{
@@ -393,7 +476,7 @@ void Shader::LoadParameters()
 				param = new ShaderParameter(this, name, type, location, samplerCount++);
 			else
 				param = new ShaderParameter(this, name, type, location);
-			_parameters[name] = unique_ptr<ShaderParameter>(param);
+			AddParameter(id, param);
 		}
 	}
 
@@ -433,20 +516,78 @@ void Shader::LoadParameters()
 			_attributes[name] = unique_ptr<ShaderAttribute>(attribute);
 		}
 	}
+
+	// The shared uniform blocks live at fixed binding points
+	_usesUniformBlocks = false;
+	for (uint binding = 0; binding < UNIFORM_BINDINGS_NUM; binding++)
+	{
+		GLuint index = glGetUniformBlockIndex(_program, kUniformBlockNames[binding]);
+		if (index != GL_INVALID_INDEX)
+		{
+			glUniformBlockBinding(_program, index, binding);
+			_usesUniformBlocks = true;
+		}
+	}
+
+	// So do the storage blocks with the light clusters
+	for (uint binding = 0; binding < STORAGE_BINDINGS_NUM; binding++)
+	{
+		GLuint index = glGetProgramResourceIndex(_program, GL_SHADER_STORAGE_BLOCK, kStorageBlockNames[binding]);
+		if (index != GL_INVALID_INDEX)
+			glShaderStorageBlockBinding(_program, index, binding);
+	}
 }
 
 ShaderParameter* Shader::GetParameter(const string& name)
+{
+	return GetParameter(HashParameter(name.c_str()));
+}
+
+ShaderParameter* Shader::GetParameter(ParameterID id)
 {
 	// Try to find param
-	auto itr = _parameters.find(name);
-	if (itr != _parameters.end())
-		return itr->second.get();
+	ParameterSlot& slot = FindSlot(id);
+	if (slot.Parameter)
+		return slot.Parameter.get();
 
 	// Create and return a non-valid param that is stored in collection
 	// in case it becomes valid after a reload
-	ShaderParameter* param = new ShaderParameter();
-	_parameters[name] = unique_ptr<ShaderParameter>(param);
-	return param;
+	return AddParameter(id, new ShaderParameter());
+}
+
+Shader::ParameterSlot& Shader::FindSlot(ParameterID id)
+{
+	if (_parameters.empty())
+		_parameters.resize(32);
+
+	const size_t mask = _parameters.size() - 1;
+	size_t index = id & mask;
+	while (_parameters[index].Parameter && _parameters[index].ID != id)
+		index = (index + 1) & mask;
+	return _parameters[index];
+}
+
+ShaderParameter* Shader::AddParameter(ParameterID id, ShaderParameter* parameter)
+{
+	// Keep at least half the slots empty, so most lookups take one probe
+	if ((_parameterCount + 1) * 2 > _parameters.size())
+	{
+		vector<ParameterSlot> old;
+		old.swap(_parameters);
+		_parameters.resize(max<size_t>(32, old.size() * 2));
+		for (auto& slot : old)
+		{
+			if (slot.Parameter)
+				FindSlot(slot.ID) = move(slot);
+		}
+	}
+
+	ParameterSlot& slot = FindSlot(id);
+	ASSERT(!slot.Parameter);
+	slot.ID = id;
+	slot.Parameter.reset(parameter);
+	_parameterCount++;
+	return parameter;
 }
 
 
@@ -466,8 +607,7 @@ ShaderAttribute* Shader::GetAttribute(const string& name)
 
 void Shader::Activate()
 {
-	glUseProgram(GetProgram());
-	
+	gGLState.UseProgram(GetProgram());
 }
 
 bool Shader::Validate()
@@ -588,7 +728,7 @@ bool Shader::LoadSource(const string& vertexShader,
 		}
 		if (_program)
 		{
-			glDeleteProgram(_program);
+			gGLState.DeleteProgram(_program);
 			_program = 0;
 		}
 
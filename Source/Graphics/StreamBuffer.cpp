@@ -0,0 +1,149 @@
+#include <Graphics/StreamBuffer.h>
+#include <Graphics/GLState.h>
+#include <Tools/Counters.h>
+
+using namespace Osm;
+using namespace std;
+
+namespace
+{
+	Counter gStreamedBytes("Streamed Bytes");
+	Counter gStreamWaits("Stream Buffer Waits");
+	Counter gStreamOrphans("Stream Buffer Orphans");
+}
+
+void StreamBuffer::Create(GLenum target, size_t size)
+{
+	Release();
+
+	_target = target;
+	_regionSize = size;
+	_region = 0;
+	_used = 0;
+	_begun = false;
+
+	const GLsizeiptr total = (GLsizeiptr)(size * kFrames);
+	glGenBuffers(1, &_buffer);
+	gGLState.BindBuffer(_target, _buffer);
+
+	if (GLAD_GL_ARB_buffer_storage)
+	{
+		const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(_target, total, nullptr, flags);
+		_persistent = static_cast<uchar*>(glMapBufferRange(_target, 0, total, flags));
+	}
+	else
+	{
+		glBufferData(_target, total, nullptr, GL_STREAM_DRAW);
+	}
+}
+
+void StreamBuffer::Release()
+{
+	for (auto& fence : _fences)
+	{
+		if (fence)
+			glDeleteSync(fence);
+		fence = nullptr;
+	}
+
+	if (_buffer)
+	{
+		if (_persistent)
+		{
+			gGLState.BindBuffer(_target, _buffer);
+			glUnmapBuffer(_target);
+		}
+		gGLState.DeleteBuffers(1, &_buffer);
+	}
+	_buffer = 0;
+	_persistent = nullptr;
+	_mapped = false;
+}
+
+void* StreamBuffer::Map(size_t size, size_t alignment, size_t& offset)
+{
+	ASSERT(_buffer && !_mapped);
+	if (!_begun)
+		BeginRegion();
+
+	// Aligned from the start of the buffer, regions don't have to be
+	const size_t regionStart = _region * _regionSize;
+	size_t start = regionStart + _used;
+	if (alignment > 1)
+		start = (start + alignment - 1) / alignment * alignment;
+	if (start + size > regionStart + _regionSize)
+		return nullptr;
+
+	offset = start;
+	_used = start + size - regionStart;
+	gStreamedBytes += (int64_t)size;
+
+	if (_persistent)
+		return _persistent + start;
+
+	// The fence already made sure nothing reads this range
+	gGLState.BindBuffer(_target, _buffer);
+	_mapped = true;
+	return glMapBufferRange(
+		_target,
+		(GLintptr)start,
+		(GLsizeiptr)size,
+		GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+}
+
+void StreamBuffer::Unmap()
+{
+	// Coherent mapping, the writes are visible to the next draw
+	if (!_mapped)
+		return;
+
+	gGLState.BindBuffer(_target, _buffer);
+	glUnmapBuffer(_target);
+	_mapped = false;
+}
+
+void StreamBuffer::EndFrame()
+{
+	if (!_begun)
+		return;
+
+	ASSERT(!_mapped);
+	_fences[_region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	_region = (_region + 1) % kFrames;
+	_used = 0;
+	_begun = false;
+}
+
+void StreamBuffer::BeginRegion()
+{
+	_begun = true;
+	GLsync& fence = _fences[_region];
+	if (!fence)
+		return;
+
+	GLenum status = glClientWaitSync(fence, 0, 0);
+	if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+	{
+		if (_persistent)
+		{
+			// The storage is immutable, all that can be done is wait
+			gStreamWaits.Add();
+			do
+			{
+				status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+			} while (status == GL_TIMEOUT_EXPIRED);
+		}
+		else
+		{
+			// New storage for the whole buffer, the draws in flight keep the
+			// old one. The other regions are done with or get rewritten.
+			gStreamOrphans.Add();
+			gGLState.BindBuffer(_target, _buffer);
+			glBufferData(_target, (GLsizeiptr)(_regionSize * kFrames), nullptr, GL_STREAM_DRAW);
+		}
+	}
+
+	glDeleteSync(fence);
+	fence = nullptr;
+}
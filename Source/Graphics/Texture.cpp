@@ -1,8 +1,16 @@
 #include <Graphics/Texture.h>
+#include <Graphics/GLState.h>
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
+#include <Core/Game.h>
+#include <Tools/Counters.h>
 using namespace Osm;
 
+namespace
+{
+	Counter gUploadedBytes("Uploaded Bytes");
+}
+
 Texture::Texture(const std::string& filename) : Resource(RESOURCE_TYPE_TEXTURE)
 {
 	_resourcePath = filename;
@@ -20,17 +28,21 @@ Texture::Texture(int width, int height)
 Texture::~Texture()
 {
 	if (_texture)
-		glDeleteTextures(1, &_texture);
+		gGLState.DeleteTextures(1, &_texture);
 }
 
 void Texture::CreateGLTextureWithData(GLubyte* data, bool genMipMaps)
 {	
+	if (Game.IsHeadless())
+		return;
+
 	if (_texture)
-		glDeleteTextures(1, &_texture);
+		gGLState.DeleteTextures(1, &_texture);
+	_gpuSize = 0;
 
 	glGenTextures(1, &_texture);											// Gen    
 
-	glBindTexture(GL_TEXTURE_2D, _texture);                                 // Bind
+	gGLState.BindTexture(GL_TEXTURE_2D, _texture);                                 // Bind
 
 	if (genMipMaps)
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);    // Minmization
@@ -56,6 +68,12 @@ void Texture::CreateGLTextureWithData(GLubyte* data, bool genMipMaps)
 
 	if (genMipMaps)
 		glGenerateMipmap(GL_TEXTURE_2D);
+
+	// RGBA8, a full mip chain adds about a third
+	_gpuSize = (uint)(_width * _height * 4);
+	gUploadedBytes += _gpuSize;
+	if (genMipMaps)
+		_gpuSize += _gpuSize / 3;
 }
 
 void Texture::Reload()
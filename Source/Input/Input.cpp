@@ -3,12 +3,45 @@
 #include <string>
 #include <windows.h>
 #include <Core/Device.h>
+#include <ctime>
+#include <cstring>
+#include <algorithm>
 
 using namespace Osm;
 using namespace std;
 
+namespace
+{
+	// Recording file layout, all little endian
+	//	Header:	magic, version, random seed
+	//	Frame:	delta time (float)
+	//			toggled key count (uint16), toggled key codes (uint16 each)
+	//			joystick count (uint8), then per joystick:
+	//				id (int16), profile (uint8), axis count (uint8), button count (uint8)
+	//				axes (float each), buttons (packed in bits)
+	const uint32_t kRecordingMagic = 0x524D534F;	// "OSMR"
+	const uint16_t kRecordingVersion = 1;
+
+	template<class T>
+	void Write(std::ofstream& out, T value)
+	{
+		out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<class T>
+	bool Read(std::ifstream& in, T& value)
+	{
+		in.read(reinterpret_cast<char*>(&value), sizeof(T));
+		return in.good();
+	}
+}
+
 void joystick_callback(int joy, int event)
 {
+	// The recording decides what is connected
+	if (Game.Input().IsReplaying())
+		return;
+
 	if (event == GLFW_CONNECTED)
 	{
 		Game.Input().AddJoystick(joy);		
@@ -24,9 +57,26 @@ InputManager::InputManager(CGame& engine)
 	, _joyState(0)
 	, _profiles(3)
 {
-	Init();
-	glfwSetJoystickCallback(joystick_callback);
 	InitProfiles();
+
+	// There is no GLFW to poll when headless
+	if (!engine.IsHeadless())
+	{
+		Init();
+		glfwSetJoystickCallback(joystick_callback);
+	}
+
+	const auto& settings = engine.Settings();
+	if (!settings.ReplayInput.empty())
+		StartReplay(settings.ReplayInput);
+	else if (!settings.RecordInput.empty())
+		StartRecording(settings.RecordInput);
+}
+
+InputManager::~InputManager()
+{
+	StopRecording();
+	StopReplay();
 }
 
 void InputManager::Init()
@@ -74,11 +124,52 @@ unordered_map<JoystickButtons, int> joyMappingTwo =
 	{ JOYSTICK_BUTTON_DPAD_LEFT,	GLFW_KEY_COMMA },
 };
 
-void InputManager::Update()
-{	
-	if (_joyState.size() == 0)
+float InputManager::Update(float deltaTime)
+{
+	if (IsReplaying())
+	{
+		if (ReadFrame(deltaTime))
+			return deltaTime;
+
+		LOG("Input replay finished after %d frames", _recordedFrames);
+		StopReplay();
+
+		// Nothing left to simulate
+		if (Game.IsHeadless())
+			Game.Quit();
+
+		// Back to live input, starting with this frame
+		Poll();
+	}
+
+	if (IsRecording())
+		WriteFrame(deltaTime);
+
+	return deltaTime;
+}
+
+void InputManager::Poll()
+{
+	if (IsReplaying())
+		return;
+
+	PollKeys();
+	PollJoysticks();
+}
+
+void InputManager::PollKeys()
+{
+	if (Game.IsHeadless())
 		return;
 
+	static_assert(GLFW_KEY_LAST < kMaxKeys, "Not enough room for all the keys");
+	GLFWwindow* window = Game.Device().GetWindow();
+	for (int k = GLFW_KEY_SPACE; k <= GLFW_KEY_LAST; k++)
+		_keys[k] = glfwGetKey(window, k) == GLFW_PRESS;
+}
+
+void InputManager::PollJoysticks()
+{
 	for (auto& i : _joyState)
 	{	
 		int joy = i.first;
@@ -112,7 +203,7 @@ void InputManager::Update()
 				state.Buttons[j] = GetKey(mapping[(JoystickButtons)j]);
 			}
 		}
-		else
+		else if (!Game.IsHeadless())
 		{
 			int count;
 			const float* axes = glfwGetJoystickAxes(joy, &count);
@@ -352,6 +443,24 @@ void InputManager::Inspect()
 	{
 		AddVirtualJoystick();
 	}
+
+	ImGui::Separator();
+	if (IsRecording())
+	{
+		ImGui::Text("Recording: %d frames", _recordedFrames);
+		if (ImGui::Button("Stop Recording"))
+			StopRecording();
+	}
+	else if (IsReplaying())
+	{
+		ImGui::Text("Replaying: frame %d", _recordedFrames);
+		if (ImGui::Button("Stop Replay"))
+			StopReplay();
+	}
+	else if (ImGui::Button("Start Recording"))
+	{
+		StartRecording(Game.Settings().SavePath + "input.rec");
+	}
 }
 
 void InputManager::AddVirtualJoystick()
@@ -389,7 +498,7 @@ void InputManager::InitProfiles()
 
 bool InputManager::GetKeyOnce(char key)
 {
-	return (glfwGetKey(Game.Device().GetWindow(), key) ?
+	return (GetKey(key) ?
 		(_keyOnce[key] ? false : (_keyOnce[key] = true)) : \
 		(_keyOnce[key] = false));
 }
@@ -398,5 +507,192 @@ bool InputManager::GetKeyOnce(char key)
 // ReSharper disable once CppMemberFunctionMayBeConst
 bool InputManager::GetKey(int key)
 {
-	return glfwGetKey(Game.Device().GetWindow(), key) == GLFW_PRESS;
+	return key >= 0 && key < kMaxKeys && _keys[key];
+}
+
+bool InputManager::StartRecording(const std::string& file)
+{
+	StopRecording();
+
+	_record.open(file, ios::binary | ios::trunc);
+	if (!_record.is_open())
+	{
+		LOG("Unable to open %s for recording input", file.c_str());
+		return false;
+	}
+
+	uint32_t seed = (uint32_t)time(nullptr);
+	srand(seed);
+
+	Write(_record, kRecordingMagic);
+	Write(_record, kRecordingVersion);
+	Write(_record, seed);
+
+	memset(_recordedKeys, 0, sizeof(_recordedKeys));
+	_recordedFrames = 0;
+	LOG("Recording input to %s with seed %u", file.c_str(), seed);
+	return true;
+}
+
+void InputManager::StopRecording()
+{
+	if (!IsRecording())
+		return;
+
+	_record.close();
+	LOG("Recorded %d frames of input", _recordedFrames);
+}
+
+bool InputManager::StartReplay(const std::string& file)
+{
+	StopReplay();
+
+	_replay.open(file, ios::binary);
+	if (!_replay.is_open())
+	{
+		LOG("Unable to open input recording %s", file.c_str());
+		return false;
+	}
+
+	uint32_t magic = 0;
+	uint16_t version = 0;
+	uint32_t seed = 0;
+	if (!Read(_replay, magic) || !Read(_replay, version) || !Read(_replay, seed) ||
+		magic != kRecordingMagic || version != kRecordingVersion)
+	{
+		LOG("%s is not a valid input recording", file.c_str());
+		_replay.close();
+		return false;
+	}
+
+	srand(seed);
+
+	// Everything connected comes from the recording
+	_joyState.clear();
+	memset(_keys, 0, sizeof(_keys));
+	memset(_recordedKeys, 0, sizeof(_recordedKeys));
+	_recordedFrames = 0;
+	LOG("Replaying input from %s with seed %u", file.c_str(), seed);
+	return true;
+}
+
+void InputManager::StopReplay()
+{
+	if (IsReplaying())
+		_replay.close();
+}
+
+void InputManager::WriteFrame(float deltaTime)
+{
+	Write(_record, deltaTime);
+
+	// Keys are stored as the ones that changed since the last frame
+	uint16_t toggled[kMaxKeys];
+	uint16_t toggledCount = 0;
+	for (int k = 0; k < kMaxKeys; k++)
+	{
+		if (_keys[k] != _recordedKeys[k])
+		{
+			toggled[toggledCount++] = (uint16_t)k;
+			_recordedKeys[k] = _keys[k];
+		}
+	}
+	Write(_record, toggledCount);
+	_record.write(reinterpret_cast<const char*>(toggled), toggledCount * sizeof(uint16_t));
+
+	Write(_record, (uint8_t)_joyState.size());
+	for (auto& i : _joyState)
+	{
+		const JoystickState& state = i.second;
+		uint8_t axisCount = (uint8_t)min(state.Axes.size(), (size_t)255);
+		uint8_t buttonCount = (uint8_t)min(state.Buttons.size(), (size_t)255);
+
+		Write(_record, (int16_t)i.first);
+		Write(_record, (uint8_t)state.Profile);
+		Write(_record, axisCount);
+		Write(_record, buttonCount);
+		_record.write(reinterpret_cast<const char*>(state.Axes.data()), axisCount * sizeof(float));
+
+		uint8_t bits = 0;
+		for (int b = 0; b < buttonCount; b++)
+		{
+			if (state.Buttons[b])
+				bits |= 1 << (b % 8);
+			if (b % 8 == 7 || b == buttonCount - 1)
+			{
+				Write(_record, bits);
+				bits = 0;
+			}
+		}
+	}
+
+	_recordedFrames++;
+}
+
+bool InputManager::ReadFrame(float& deltaTime)
+{
+	float recordedDelta = 0.0f;
+	if (!Read(_replay, recordedDelta))
+		return false;
+
+	uint16_t toggledCount = 0;
+	if (!Read(_replay, toggledCount))
+		return false;
+	for (int i = 0; i < toggledCount; i++)
+	{
+		uint16_t key = 0;
+		if (!Read(_replay, key) || key >= kMaxKeys)
+			return false;
+		_keys[key] = !_keys[key];
+	}
+
+	uint8_t joyCount = 0;
+	if (!Read(_replay, joyCount))
+		return false;
+
+	unordered_map<int, JoystickState> joysticks;
+	for (int j = 0; j < joyCount; j++)
+	{
+		int16_t id = 0;
+		uint8_t profile = 0, axisCount = 0, buttonCount = 0;
+		if (!Read(_replay, id) || !Read(_replay, profile) ||
+			!Read(_replay, axisCount) || !Read(_replay, buttonCount))
+			return false;
+
+		// Carry over the state so presses are detected
+		JoystickState state;
+		auto found = _joyState.find(id);
+		if (found != _joyState.end())
+			state = move(found->second);
+		else
+			state.Name = "Replay Joystick " + to_string(id);
+
+		state.Profile = (JoystickProfile)profile;
+		state.LastAxes = state.Axes;
+		state.LastButtons = state.Buttons;
+		state.Axes.resize(max((size_t)axisCount, state.Axes.size()));
+		state.Buttons.resize(max((size_t)buttonCount, state.Buttons.size()));
+		state.LastAxes.resize(state.Axes.size());
+		state.LastButtons.resize(state.Buttons.size());
+
+		_replay.read(reinterpret_cast<char*>(state.Axes.data()), axisCount * sizeof(float));
+
+		uint8_t bits = 0;
+		for (int b = 0; b < buttonCount; b++)
+		{
+			if (b % 8 == 0 && !Read(_replay, bits))
+				return false;
+			state.Buttons[b] = (bits >> (b % 8)) & 1;
+		}
+
+		joysticks[id] = move(state);
+	}
+
+	if (!_replay.good())
+		return false;
+
+	_joyState = move(joysticks);
+	deltaTime = recordedDelta;
+	_recordedFrames++;
+	return true;
 }
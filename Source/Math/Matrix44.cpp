@@ -1,6 +1,129 @@
 #include <Math/Matrix44.h>
-
+#include <Math/Quaternion.h>
+#include <Defines.h>
 #include <algorithm>
+#include <cstring>
+
+#if SIMD_AVX
+#include <immintrin.h>
+#elif SIMD_SSE
+#include <emmintrin.h>
+#endif
+
+#if SIMD_SSE
+
+#define SHUFFLE_MASK(x, y, z, w)	((x) | ((y) << 2) | ((z) << 4) | ((w) << 6))
+#define SWIZZLE(v, x, y, z, w)		_mm_shuffle_ps(v, v, SHUFFLE_MASK(x, y, z, w))
+#define SHUFFLE(a, b, x, y, z, w)	_mm_shuffle_ps(a, b, SHUFFLE_MASK(x, y, z, w))
+
+namespace
+{
+
+///
+/// The rows of a matrix kept in registers, so they can be reused
+/// when transforming or concatenating many times
+///
+struct MatrixRows
+{
+	explicit MatrixRows(const float* f)
+	{
+		for (int i = 0; i < 4; i++)
+			Row[i] = _mm_loadu_ps(f + i * 4);
+#if SIMD_AVX
+		for (int i = 0; i < 4; i++)
+			Row2[i] = _mm256_insertf128_ps(_mm256_castps128_ps256(Row[i]), Row[i], 1);
+#endif
+	}
+
+	/// Sums the rows scaled by the components of v
+	__m128 Combine(__m128 v) const
+	{
+		__m128 r = _mm_mul_ps(SWIZZLE(v, 0, 0, 0, 0), Row[0]);
+		r = _mm_add_ps(r, _mm_mul_ps(SWIZZLE(v, 1, 1, 1, 1), Row[1]));
+		r = _mm_add_ps(r, _mm_mul_ps(SWIZZLE(v, 2, 2, 2, 2), Row[2]));
+		r = _mm_add_ps(r, _mm_mul_ps(SWIZZLE(v, 3, 3, 3, 3), Row[3]));
+		return r;
+	}
+
+#if SIMD_AVX
+	/// Same as above, for two vectors at once
+	__m256 Combine(__m256 v) const
+	{
+		__m256 r = _mm256_mul_ps(_mm256_shuffle_ps(v, v, 0x00), Row2[0]);
+		r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_shuffle_ps(v, v, 0x55), Row2[1]));
+		r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_shuffle_ps(v, v, 0xAA), Row2[2]));
+		r = _mm256_add_ps(r, _mm256_mul_ps(_mm256_shuffle_ps(v, v, 0xFF), Row2[3]));
+		return r;
+	}
+#endif
+
+	/// Combines the rows with each of the four rows in coef. Reads all of
+	/// coef before writing, so res and coef can be the same.
+	void Multiply(const float* coef, float* res) const
+	{
+#if SIMD_AVX
+		__m256 c01 = _mm256_loadu_ps(coef);
+		__m256 c23 = _mm256_loadu_ps(coef + 8);
+		_mm256_storeu_ps(res, Combine(c01));
+		_mm256_storeu_ps(res + 8, Combine(c23));
+#else
+		__m128 c0 = _mm_loadu_ps(coef);
+		__m128 c1 = _mm_loadu_ps(coef + 4);
+		__m128 c2 = _mm_loadu_ps(coef + 8);
+		__m128 c3 = _mm_loadu_ps(coef + 12);
+		_mm_storeu_ps(res, Combine(c0));
+		_mm_storeu_ps(res + 4, Combine(c1));
+		_mm_storeu_ps(res + 8, Combine(c2));
+		_mm_storeu_ps(res + 12, Combine(c3));
+#endif
+	}
+
+	/// Transforms a point with w=1
+	__m128 TransformPoint(const Osm::Vector3& p) const
+	{
+		__m128 r = _mm_mul_ps(_mm_set1_ps(p.x), Row[0]);
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(p.y), Row[1]));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_set1_ps(p.z), Row[2]));
+		return _mm_add_ps(r, Row[3]);
+	}
+
+	__m128 Row[4];
+#if SIMD_AVX
+	__m256 Row2[4];
+#endif
+};
+
+/// Writes the first three components, without touching the memory after
+inline void StoreVector3(Osm::Vector3& out, __m128 v)
+{
+	_mm_storel_pi(reinterpret_cast<__m64*>(out.f), v);
+	_mm_store_ss(out.f + 2, _mm_movehl_ps(v, v));
+}
+
+// 2x2 matrix helpers for the block inverse, each 2x2 matrix is stored in one register 
+inline __m128 Mat2Mul(__m128 a, __m128 b)
+{
+	return _mm_add_ps(	_mm_mul_ps(a, SWIZZLE(b, 0, 3, 0, 3)),
+						_mm_mul_ps(SWIZZLE(a, 1, 0, 3, 2), SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+// Adjugate of a times b
+inline __m128 Mat2AdjMul(__m128 a, __m128 b)
+{
+	return _mm_sub_ps(	_mm_mul_ps(SWIZZLE(a, 3, 3, 0, 0), b),
+						_mm_mul_ps(SWIZZLE(a, 1, 1, 2, 2), SWIZZLE(b, 2, 3, 0, 1)));
+}
+
+// a times the adjugate of b
+inline __m128 Mat2MulAdj(__m128 a, __m128 b)
+{
+	return _mm_sub_ps(	_mm_mul_ps(a, SWIZZLE(b, 3, 0, 3, 0)),
+						_mm_mul_ps(SWIZZLE(a, 1, 0, 3, 2), SWIZZLE(b, 2, 1, 2, 1)));
+}
+
+}
+
+#endif
 
 Osm::Matrix44::Matrix44(	float m00, float m01, float m02, float m03,
 					float m10, float m11, float m12, float m13,
@@ -23,6 +146,11 @@ Osm::Matrix44::Matrix44()
 
 Osm::Vector3 Osm::Matrix44::operator*(const Vector3& vec) const
 {
+#if SIMD_SSE
+	Vector3 res;
+	StoreVector3(res, MatrixRows(f).TransformPoint(vec));
+	return res;
+#else
 	return Vector3(
 		vec.x * m[0][0] +
 		vec.y * m[1][0] +
@@ -35,15 +163,22 @@ Osm::Vector3 Osm::Matrix44::operator*(const Vector3& vec) const
 		vec.x * m[0][2] +
 		vec.y * m[1][2] +
 		vec.z * m[2][2] + m[3][2]);
+#endif
 }
 
 Osm::Vector4 Osm::Matrix44::operator*(const Vector4& vec) const
 {
+#if SIMD_SSE
+	Vector4 res;
+	_mm_storeu_ps(res.f, MatrixRows(f).Combine(_mm_loadu_ps(vec.f)));
+	return res;
+#else
 	Vector4 res(f[0] * vec.f[0] + f[4] * vec.f[1] + f[8] * vec.f[2] + f[12] * vec.f[3],
 		f[1] * vec.f[0] + f[5] * vec.f[1] + f[9] * vec.f[2] + f[13] * vec.f[3],
 		f[2] * vec.f[0] + f[6] * vec.f[1] + f[10] * vec.f[2] + f[14] * vec.f[3],
 		f[3] * vec.f[0] + f[7] * vec.f[1] + f[11] * vec.f[2] + f[15] * vec.f[3]);
 	return res;
+#endif
 }
 
 Osm::Vector3 Osm::Matrix44::GetTranslation() const
@@ -122,6 +257,40 @@ Osm::Matrix44 Osm::Matrix44::CreateScale(Vector3 scale)
 	return res;
 }
 
+Osm::Matrix44 Osm::Matrix44::CreateTRS(	const Vector3& translation,
+										const Quaternion& rotation,
+										const Vector3& scale)
+{
+	float xx = rotation.x * rotation.x;
+	float yy = rotation.y * rotation.y;
+	float zz = rotation.z * rotation.z;
+	float xy = rotation.x * rotation.y;
+	float xz = rotation.x * rotation.z;
+	float yz = rotation.y * rotation.z;
+	float wx = rotation.w * rotation.x;
+	float wy = rotation.w * rotation.y;
+	float wz = rotation.w * rotation.z;
+
+	// Each row is a rotated axis, scaled
+	return Matrix44(
+		(1.0f - 2.0f * (yy + zz)) * scale.x,
+		2.0f * (xy + wz) * scale.x,
+		2.0f * (xz - wy) * scale.x,
+		0.0f,
+		2.0f * (xy - wz) * scale.y,
+		(1.0f - 2.0f * (xx + zz)) * scale.y,
+		2.0f * (yz + wx) * scale.y,
+		0.0f,
+		2.0f * (xz + wy) * scale.z,
+		2.0f * (yz - wx) * scale.z,
+		(1.0f - 2.0f * (xx + yy)) * scale.z,
+		0.0f,
+		translation.x,
+		translation.y,
+		translation.z,
+		1.0f);
+}
+
 Osm::Matrix44 Osm::Matrix44::operator+(const Matrix44& mat) const
 {
 	Matrix44 res;
@@ -146,10 +315,11 @@ Osm::Matrix44 Osm::Matrix44::operator-(const Matrix44& mat) const
 
 Osm::Matrix44 Osm::Matrix44::operator*(const Matrix44& mat) const
 {
-	// Matrix multiplication, slow but reliable-ish :)
-
 	Matrix44 res;
-	//
+#if SIMD_SSE
+	MatrixRows(f).Multiply(mat.f, res.f);
+#else
+	// Matrix multiplication, slow but reliable-ish :)
 	for (int i = 0; i<4; i++)
 	{
 		res.m[i][0] = mat.m[i][0] * m[0][0] +
@@ -172,7 +342,7 @@ Osm::Matrix44 Osm::Matrix44::operator*(const Matrix44& mat) const
 			mat.m[i][2] * m[2][3] +
 			mat.m[i][3] * m[3][3];
 	}
-	//
+#endif
 	return res;
 }
 
@@ -338,6 +508,59 @@ float Osm::Matrix44::Determinant() const
 
 bool Osm::Matrix44::Invert()
 {
+#if SIMD_SSE
+	// Block inverse, splitting the matrix into four 2x2 matrices 
+	// | A B |
+	// | C D |
+	__m128 r0 = _mm_loadu_ps(f);
+	__m128 r1 = _mm_loadu_ps(f + 4);
+	__m128 r2 = _mm_loadu_ps(f + 8);
+	__m128 r3 = _mm_loadu_ps(f + 12);
+
+	__m128 A = _mm_movelh_ps(r0, r1);
+	__m128 B = _mm_movehl_ps(r1, r0);
+	__m128 C = _mm_movelh_ps(r2, r3);
+	__m128 D = _mm_movehl_ps(r3, r2);
+
+	// Determinants of the blocks as (|A| |B| |C| |D|)
+	__m128 detSub = _mm_sub_ps(
+		_mm_mul_ps(SHUFFLE(r0, r2, 0, 2, 0, 2), SHUFFLE(r1, r3, 1, 3, 1, 3)),
+		_mm_mul_ps(SHUFFLE(r0, r2, 1, 3, 1, 3), SHUFFLE(r1, r3, 0, 2, 0, 2)));
+	__m128 detA = SWIZZLE(detSub, 0, 0, 0, 0);
+	__m128 detB = SWIZZLE(detSub, 1, 1, 1, 1);
+	__m128 detC = SWIZZLE(detSub, 2, 2, 2, 2);
+	__m128 detD = SWIZZLE(detSub, 3, 3, 3, 3);
+
+	__m128 D_C = Mat2AdjMul(D, C);
+	__m128 A_B = Mat2AdjMul(A, B);
+	__m128 X_ = _mm_sub_ps(_mm_mul_ps(detD, A), Mat2Mul(B, D_C));
+	__m128 W_ = _mm_sub_ps(_mm_mul_ps(detA, D), Mat2Mul(C, A_B));
+	__m128 Y_ = _mm_sub_ps(_mm_mul_ps(detB, C), Mat2MulAdj(D, A_B));
+	__m128 Z_ = _mm_sub_ps(_mm_mul_ps(detC, B), Mat2MulAdj(A, D_C));
+
+	// |M| = |A||D| + |B||C| - tr((A#B)(D#C))
+	__m128 tr = _mm_mul_ps(A_B, SWIZZLE(D_C, 0, 2, 1, 3));
+	tr = _mm_add_ps(tr, _mm_movehl_ps(tr, tr));
+	tr = _mm_add_ps(tr, SWIZZLE(tr, 1, 1, 1, 1));
+	tr = SWIZZLE(tr, 0, 0, 0, 0);
+	__m128 detM = _mm_add_ps(_mm_mul_ps(detA, detD), _mm_mul_ps(detB, detC));
+	detM = _mm_sub_ps(detM, tr);
+
+	if (_mm_cvtss_f32(detM) == 0.0f)
+		return false;
+
+	__m128 rDetM = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), detM);
+	X_ = _mm_mul_ps(X_, rDetM);
+	Y_ = _mm_mul_ps(Y_, rDetM);
+	Z_ = _mm_mul_ps(Z_, rDetM);
+	W_ = _mm_mul_ps(W_, rDetM);
+
+	_mm_storeu_ps(f, SHUFFLE(X_, Y_, 3, 1, 3, 1));
+	_mm_storeu_ps(f + 4, SHUFFLE(X_, Y_, 2, 0, 2, 0));
+	_mm_storeu_ps(f + 8, SHUFFLE(Z_, W_, 3, 1, 3, 1));
+	_mm_storeu_ps(f + 12, SHUFFLE(Z_, W_, 2, 0, 2, 0));
+	return true;
+#else
 	Matrix44 inv;
 	
 	inv.f[0] = f[5] * f[10] * f[15] -
@@ -463,14 +686,51 @@ bool Osm::Matrix44::Invert()
 		f[i] = inv.f[i] * det;
 
 	return true;
+#endif
 }
 
 
+void Osm::Matrix44::InvertRigid()
+{
+	// The inverse of the upper 3x3 is its transpose with each axis
+	// divided by its squared length
+	Matrix44 inv;
+	for (int i = 0; i < 3; i++)
+	{
+		float len2 = m[i][0] * m[i][0] + m[i][1] * m[i][1] + m[i][2] * m[i][2];
+		float s = len2 > 0.0f ? 1.0f / len2 : 0.0f;
+		for (int j = 0; j < 3; j++)
+			inv.m[j][i] = m[i][j] * s;
+	}
+
+	// Then undo the translation
+	for (int i = 0; i < 3; i++)
+	{
+		inv.m[3][i] = -(m[3][0] * inv.m[0][i] +
+						m[3][1] * inv.m[1][i] +
+						m[3][2] * inv.m[2][i]);
+	}
+
+	*this = inv;
+}
+
 void Osm::Matrix44::Transpose()
 {
+#if SIMD_SSE
+	__m128 r0 = _mm_loadu_ps(f);
+	__m128 r1 = _mm_loadu_ps(f + 4);
+	__m128 r2 = _mm_loadu_ps(f + 8);
+	__m128 r3 = _mm_loadu_ps(f + 12);
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	_mm_storeu_ps(f, r0);
+	_mm_storeu_ps(f + 4, r1);
+	_mm_storeu_ps(f + 8, r2);
+	_mm_storeu_ps(f + 12, r3);
+#else
 	for (int i = 0; i < 4; i++)
 		for (int j = 0; j < i; j++)
 			std::swap(m[i][j], m[j][i]);
+#endif
 }
 
 void Osm::Matrix44::SetOrientation(	const Vector3 &x,
@@ -489,8 +749,13 @@ void Osm::Matrix44::SetEulerAngles(const Vector3& angles)
 	*this = CreateRotateX(angles.x) * CreateRotateY(angles.y) * CreateRotateZ(angles.z);
 }
 
-Osm::Vector3 Osm::Matrix44::TransformDirectionVector(const Vector3& dir)
+Osm::Vector3 Osm::Matrix44::TransformDirectionVector(const Vector3& dir) const
 {
+#if SIMD_SSE
+	Vector3 res;
+	StoreVector3(res, MatrixRows(f).Combine(_mm_setr_ps(dir.x, dir.y, dir.z, 0.0f)));
+	return res;
+#else
 	Vector3 res(dir.x * m[0][0] +
 		dir.y * m[1][0] +
 		dir.z * m[2][0],
@@ -503,6 +768,7 @@ Osm::Vector3 Osm::Matrix44::TransformDirectionVector(const Vector3& dir)
 		dir.y * m[1][2] +
 		dir.z * m[2][2]);
 	return res;
+#endif
 }
 
 Osm::Vector3 Osm::Matrix44::GetEulerAngles() const
@@ -526,4 +792,54 @@ Osm::Vector3 Osm::Matrix44::GetEulerAngles() const
 	}
 
 	return Vector3(-x, -y, -z);
-}
\ No newline at end of file
+}
+
+void Osm::Matrix44::TransformPoints(const Matrix44& mat,
+									const Vector3* in,
+									Vector3* out,
+									size_t count)
+{
+#if SIMD_SSE
+	MatrixRows rows(mat.f);
+	for (size_t i = 0; i < count; i++)
+		StoreVector3(out[i], rows.TransformPoint(in[i]));
+#else
+	for (size_t i = 0; i < count; i++)
+		out[i] = mat * in[i];
+#endif
+}
+
+void Osm::Matrix44::TransformVectors(const Matrix44& mat,
+									const Vector4* in,
+									Vector4* out,
+									size_t count)
+{
+#if SIMD_SSE
+	MatrixRows rows(mat.f);
+	size_t i = 0;
+#if SIMD_AVX
+	for (; i + 2 <= count; i += 2)
+		_mm256_storeu_ps(out[i].f, rows.Combine(_mm256_loadu_ps(in[i].f)));
+#endif
+	for (; i < count; i++)
+		_mm_storeu_ps(out[i].f, rows.Combine(_mm_loadu_ps(in[i].f)));
+#else
+	for (size_t i = 0; i < count; i++)
+		out[i] = mat * in[i];
+#endif
+}
+
+void Osm::Matrix44::Concatenate(const Matrix44& parent,
+								const Matrix44* in,
+								Matrix44* out,
+								size_t count)
+{
+#if SIMD_SSE
+	MatrixRows rows(parent.f);
+	for (size_t i = 0; i < count; i++)
+		rows.Multiply(in[i].f, out[i].f);
+#else
+	for (size_t i = 0; i < count; i++)
+		out[i] = parent * in[i];
+#endif
+}
@@ -0,0 +1,124 @@
+#include <Math/Quaternion.h>
+#include <Math/Matrix44.h>
+
+using namespace Osm;
+
+Quaternion Quaternion::operator*(const Quaternion& q) const
+{
+	return Quaternion(
+		w * q.x + x * q.w + y * q.z - z * q.y,
+		w * q.y - x * q.z + y * q.w + z * q.x,
+		w * q.z + x * q.y - y * q.x + z * q.w,
+		w * q.w - x * q.x - y * q.y - z * q.z);
+}
+
+Vector3 Quaternion::operator*(const Vector3& v) const
+{
+	// v' = v + 2w(u x v) + 2u x (u x v)
+	Vector3 u(x, y, z);
+	Vector3 t = u.Cross(v) * 2.0f;
+	return v + t * w + u.Cross(t);
+}
+
+void Quaternion::Normalize()
+{
+	float mag = Magnitude();
+	if (mag > 0.0f)
+	{
+		float inv = 1.0f / mag;
+		x *= inv;
+		y *= inv;
+		z *= inv;
+		w *= inv;
+	}
+}
+
+Matrix44 Quaternion::ToMatrix() const
+{
+	return Matrix44::CreateTRS(Vector3(), *this, Vector3(1.0f, 1.0f, 1.0f));
+}
+
+Quaternion Quaternion::CreateFromAxisAngle(const Vector3& axis, float angle)
+{
+	Vector3 a = axis.Unit();
+	float s = sinf(angle * 0.5f);
+	return Quaternion(a.x * s, a.y * s, a.z * s, cosf(angle * 0.5f));
+}
+
+Quaternion Quaternion::CreateFromMatrix(const Matrix44& mat)
+{
+	// Rows of the matrix are the rotated axes
+	const auto& m = mat.m;
+	float trace = m[0][0] + m[1][1] + m[2][2];
+	Quaternion q;
+
+	if (trace > 0.0f)
+	{
+		float s = 0.5f / sqrtf(trace + 1.0f);
+		q.w = 0.25f / s;
+		q.x = (m[1][2] - m[2][1]) * s;
+		q.y = (m[2][0] - m[0][2]) * s;
+		q.z = (m[0][1] - m[1][0]) * s;
+	}
+	else if (m[0][0] > m[1][1] && m[0][0] > m[2][2])
+	{
+		float s = 2.0f * sqrtf(1.0f + m[0][0] - m[1][1] - m[2][2]);
+		q.w = (m[1][2] - m[2][1]) / s;
+		q.x = 0.25f * s;
+		q.y = (m[1][0] + m[0][1]) / s;
+		q.z = (m[2][0] + m[0][2]) / s;
+	}
+	else if (m[1][1] > m[2][2])
+	{
+		float s = 2.0f * sqrtf(1.0f + m[1][1] - m[0][0] - m[2][2]);
+		q.w = (m[2][0] - m[0][2]) / s;
+		q.x = (m[1][0] + m[0][1]) / s;
+		q.y = 0.25f * s;
+		q.z = (m[2][1] + m[1][2]) / s;
+	}
+	else
+	{
+		float s = 2.0f * sqrtf(1.0f + m[2][2] - m[0][0] - m[1][1]);
+		q.w = (m[0][1] - m[1][0]) / s;
+		q.x = (m[2][0] + m[0][2]) / s;
+		q.y = (m[2][1] + m[1][2]) / s;
+		q.z = 0.25f * s;
+	}
+
+	q.Normalize();
+	return q;
+}
+
+Quaternion Quaternion::Slerp(const Quaternion& from, const Quaternion& to, float t)
+{
+	Quaternion target = to;
+	float cosAlpha = from.Dot(to);
+
+	// Take the shortest path
+	if (cosAlpha < 0.0f)
+	{
+		target = Quaternion(-to.x, -to.y, -to.z, -to.w);
+		cosAlpha = -cosAlpha;
+	}
+
+	float t1 = 1.0f - t;
+	float t2 = t;
+
+	// Almost the same rotation, a normalized lerp is good enough and
+	// avoids dividing by a tiny sine
+	if (cosAlpha < 0.9995f)
+	{
+		float alpha = acosf(cosAlpha);
+		float sinAlpha = sinf(alpha);
+		t1 = sinf((1.0f - t) * alpha) / sinAlpha;
+		t2 = sinf(t * alpha) / sinAlpha;
+	}
+
+	Quaternion res(
+		from.x * t1 + target.x * t2,
+		from.y * t1 + target.y * t2,
+		from.z * t1 + target.z * t2,
+		from.w * t1 + target.w * t2);
+	res.Normalize();
+	return res;
+}
@@ -5,6 +5,9 @@
 #include <algorithm>
 #include <vector>
 #include <Graphics/DebugRenderer.h>
+#include <Tools/Profiler.h>
+#include <Tools/Memory.h>
+#include <Tools/Counters.h>
 #include <Utils.h>
 #include <Defines.h>
 #include <imgui.h>
@@ -12,6 +15,14 @@
 using namespace Osm;
 const float skin = 0.1f;
 
+namespace
+{
+	Counter gBroadphasePairs("Broadphase Pairs");
+	Counter gSATTests("SAT Tests");
+	Counter gContacts("Contacts");
+	Counter gBodies("Physics Bodies", COUNTER_GAUGE);
+}
+
 #define PACK_TO_64(i,j) (((i) & 0x00000000FFFFFFFF) | ((j) << 32));
 
 #define RESTITUTION_AVERGE 1
@@ -290,7 +301,7 @@ void PhysicsBody2D::UpdateTransform()
 		return;
 
 	_transform->SetPosition(ToVector3(_position));
-	_transform->SetOrientation(Matrix44::CreateRotateY(_orientation));
+	_transform->SetRotation(Quaternion::CreateFromAxisAngle(Vector3(0.0f, 1.0f, 0.0f), _orientation));
 }
 
 #if DEBUG_RENDER
@@ -594,6 +605,9 @@ PhysicsManager2D::PhysicsManager2D(World& world)
 
 void PhysicsManager2D::UpdatePhysics(float dt)
 {
+	PROFILE_FUNCTION();
+	MEMORY_SCOPE(MEMORY_TAG_PHYSICS);
+
 	for (auto b : _bodies)
 	{
 		if (b->GetEnbled())
@@ -603,6 +617,8 @@ void PhysicsManager2D::UpdatePhysics(float dt)
 	}
 
 	AccumulateContacts();
+	gContacts += (int64_t)_collisions.size();
+	gBodies.Set((int64_t)_bodies.size());
 	CallOnCollisionEvent();
 	ResloveCollisions();
 
@@ -632,7 +648,7 @@ bool PhysicsManager2D::IsPhysicsBodyValid(PhysicsBody2D* body)
 	return it != _bodies.end();
 }
 
-vector<PhysicsBody2D*> PhysicsManager2D::GetInRadius(const Vector2& position, float radius)
+FrameVector<PhysicsBody2D*> PhysicsManager2D::GetInRadius(const Vector2& position, float radius)
 {
 	switch (_algorithm)
 	{
@@ -643,7 +659,7 @@ vector<PhysicsBody2D*> PhysicsManager2D::GetInRadius(const Vector2& position, fl
 	case CA_MULTI_GRID:
 		return GetInRadiusMultiGrid (position, radius);
 	default:
-		return vector<PhysicsBody2D*>();
+		return FrameVector<PhysicsBody2D*>();
 	}
 }
 
@@ -907,6 +923,8 @@ void PhysicsManager2D::AccumulateContacts()
 void PhysicsManager2D::AccumulateContactsBruteForce()
 {
 	_collisions.clear();
+	int64_t pairs = 0;
+	int64_t tests = 0;
 
 	for (size_t i = 0; i < _bodies.size(); i++)
 	{
@@ -928,10 +946,12 @@ void PhysicsManager2D::AccumulateContactsBruteForce()
 			if (!box0.IsValid() || !box1.IsValid())
 				break;
 
+			pairs++;
 			if (Overlap(box0, box1))
 			{
 				Collision2D collision; // Blank (invalid) collision 
 
+				tests++;
 				if (CheckCollision(body0, body1, collision))
 				{
 					_collisions.push_back(collision);
@@ -939,6 +959,9 @@ void PhysicsManager2D::AccumulateContactsBruteForce()
 			}
 		}
 	}
+
+	gBroadphasePairs += pairs;
+	gSATTests += tests;
 }
 
 void PhysicsManager2D::AccumulateContactsAutoGrid()
@@ -951,6 +974,8 @@ void PhysicsManager2D::AccumulateContactsAutoGrid()
 #endif
 
 	_collisions.clear();
+	int64_t pairs = 0;
+	int64_t tests = 0;
 	for (auto b : _bodies)
 	{
 		auto neighbours = _autoGrid.GetNeighbours(b);
@@ -965,10 +990,12 @@ void PhysicsManager2D::AccumulateContactsAutoGrid()
 				if (!box0.IsValid() || !box1.IsValid())
 					break;
 
+				pairs++;
 				if (Overlap(box0, box1))
 				{
 					Collision2D collision; // Blank (invalid) collision 
 
+					tests++;
 					if (CheckCollision(b, n, collision))
 					{
 						_collisions.push_back(collision);
@@ -977,6 +1004,9 @@ void PhysicsManager2D::AccumulateContactsAutoGrid()
 			}
 		}
 	}
+
+	gBroadphasePairs += pairs;
+	gSATTests += tests;
 }
 
 void Osm::PhysicsManager2D::AccumulateContactsMultiGrid()
@@ -990,9 +1020,9 @@ void Osm::PhysicsManager2D::AccumulateContactsMultiGrid()
 
 
 
-std::vector<PhysicsBody2D*> PhysicsManager2D::GetInRadiusBrute(const Vector2& position, float radius)
+FrameVector<PhysicsBody2D*> PhysicsManager2D::GetInRadiusBrute(const Vector2& position, float radius)
 {
-	vector<PhysicsBody2D*> neighbours;
+	FrameVector<PhysicsBody2D*> neighbours;
 
 	// gDebugRenderer.AddCircle(ToVector3(position), radius);
 
@@ -1009,12 +1039,12 @@ std::vector<PhysicsBody2D*> PhysicsManager2D::GetInRadiusBrute(const Vector2& po
 	return neighbours;
 }
 
-vector<PhysicsBody2D*> PhysicsManager2D::GetInRadiusAutoGrid(const Vector2& position, float radius)
+FrameVector<PhysicsBody2D*> PhysicsManager2D::GetInRadiusAutoGrid(const Vector2& position, float radius)
 {
 	return GetInRadiusBrute(position, radius);
 }
 
-vector<PhysicsBody2D*> PhysicsManager2D::GetInRadiusMultiGrid(const Vector2& position, float radius)
+FrameVector<PhysicsBody2D*> PhysicsManager2D::GetInRadiusMultiGrid(const Vector2& position, float radius)
 {
 	return GetInRadiusBrute(position, radius);
 }
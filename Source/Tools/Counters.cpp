@@ -0,0 +1,102 @@
+#include <Tools/Counters.h>
+#include <cstring>
+#include <mutex>
+
+using namespace Osm;
+using namespace std;
+
+namespace
+{
+	struct Registry
+	{
+		mutex					Mutex;
+		atomic<uint>			Count;
+		const char*				Names[CounterRegistry::kMaxCounters];
+		CounterKind				Kinds[CounterRegistry::kMaxCounters];
+		atomic<int64_t>			Values[CounterRegistry::kMaxCounters];
+		atomic<int64_t>			Last[CounterRegistry::kMaxCounters];
+	};
+
+	// Counters are usually statics in other files, so the registry has
+	// to exist before any of them registers
+	Registry& GetRegistry()
+	{
+		static Registry registry;
+		return registry;
+	}
+
+	// Where bumps go after running out of counters
+	atomic<int64_t> gOverflow;
+}
+
+uint CounterRegistry::Register(const char* name, CounterKind kind)
+{
+	Registry& registry = GetRegistry();
+	lock_guard<mutex> lock(registry.Mutex);
+
+	uint count = registry.Count.load();
+	for (uint i = 0; i < count; i++)
+	{
+		if (strcmp(registry.Names[i], name) == 0)
+			return i;
+	}
+
+	if (count == kMaxCounters)
+	{
+		LOG("Out of counters, %s will not be sampled", name);
+		return kMaxCounters;
+	}
+
+	registry.Names[count] = name;
+	registry.Kinds[count] = kind;
+	registry.Values[count].store(0);
+	registry.Last[count].store(0);
+	registry.Count.store(count + 1);
+	return count;
+}
+
+uint CounterRegistry::GetCount()
+{
+	return GetRegistry().Count.load();
+}
+
+const char* CounterRegistry::GetName(uint id)
+{
+	ASSERT(id < GetCount());
+	return GetRegistry().Names[id];
+}
+
+CounterKind CounterRegistry::GetKind(uint id)
+{
+	ASSERT(id < GetCount());
+	return GetRegistry().Kinds[id];
+}
+
+void CounterRegistry::Sample(std::vector<int64_t>& values)
+{
+	Registry& registry = GetRegistry();
+	uint count = registry.Count.load();
+	values.resize(count);
+	for (uint i = 0; i < count; i++)
+	{
+		if (registry.Kinds[i] == COUNTER_PER_FRAME)
+			values[i] = registry.Values[i].exchange(0, memory_order_relaxed);
+		else
+			values[i] = registry.Values[i].load(memory_order_relaxed);
+		registry.Last[i].store(values[i], memory_order_relaxed);
+	}
+}
+
+int64_t CounterRegistry::GetLast(uint id)
+{
+	if (id >= GetCount())
+		return 0;
+	return GetRegistry().Last[id].load(memory_order_relaxed);
+}
+
+std::atomic<int64_t>& CounterRegistry::GetValue(uint id)
+{
+	if (id >= kMaxCounters)
+		return gOverflow;
+	return GetRegistry().Values[id];
+}
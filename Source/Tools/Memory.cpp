@@ -0,0 +1,124 @@
+#include <Tools/Memory.h>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace Osm;
+using namespace std;
+
+namespace
+{
+	thread_local MemoryTag		tTag = MEMORY_TAG_UNTAGGED;
+
+	atomic<int64_t>				gLiveBytes[MEMORY_TAG_COUNT];
+	atomic<int64_t>				gFrameBytes[MEMORY_TAG_COUNT];
+	atomic<uint>				gFrameCount[MEMORY_TAG_COUNT];
+
+	const char* kTagNames[MEMORY_TAG_COUNT] =
+	{
+		"Untagged",
+		"Physics",
+		"Render",
+		"Resources",
+		"Gameplay",
+		"Audio"
+	};
+}
+
+MemoryTag MemoryTracker::SetTag(MemoryTag tag)
+{
+	MemoryTag previous = tTag;
+	tTag = tag;
+	return previous;
+}
+
+MemoryTag MemoryTracker::GetTag()
+{
+	return tTag;
+}
+
+const char* MemoryTracker::GetTagName(MemoryTag tag)
+{
+	ASSERT(tag >= 0 && tag < MEMORY_TAG_COUNT);
+	return kTagNames[tag];
+}
+
+MemoryStats MemoryTracker::EndFrame()
+{
+	MemoryStats stats;
+	for (int i = 0; i < MEMORY_TAG_COUNT; i++)
+	{
+		stats.LiveBytes[i] = gLiveBytes[i].load(memory_order_relaxed);
+		stats.FrameBytes[i] = gFrameBytes[i].exchange(0, memory_order_relaxed);
+		stats.FrameCount[i] = gFrameCount[i].exchange(0, memory_order_relaxed);
+	}
+	return stats;
+}
+
+#if MEMORY_TRACKING
+
+namespace
+{
+	// Every allocation is prefixed with its size and tag. The header is
+	// as big as the default alignment, so the memory handed out stays aligned.
+	struct alignas(alignof(max_align_t)) AllocationHeader
+	{
+		size_t		Size;
+		MemoryTag	Tag;
+	};
+
+	void* TrackedAlloc(size_t size)
+	{
+		void* block = malloc(sizeof(AllocationHeader) + size);
+		if (!block)
+			return nullptr;
+
+		auto header = static_cast<AllocationHeader*>(block);
+		header->Size = size;
+		header->Tag = tTag;
+
+		gLiveBytes[tTag].fetch_add((int64_t)size, memory_order_relaxed);
+		gFrameBytes[tTag].fetch_add((int64_t)size, memory_order_relaxed);
+		gFrameCount[tTag].fetch_add(1, memory_order_relaxed);
+		return header + 1;
+	}
+
+	void TrackedFree(void* ptr)
+	{
+		if (!ptr)
+			return;
+
+		auto header = static_cast<AllocationHeader*>(ptr) - 1;
+		gLiveBytes[header->Tag].fetch_sub((int64_t)header->Size, memory_order_relaxed);
+		free(header);
+	}
+
+	void* TrackedNew(size_t size)
+	{
+		while (true)
+		{
+			void* ptr = TrackedAlloc(size);
+			if (ptr)
+				return ptr;
+
+			new_handler handler = get_new_handler();
+			if (!handler)
+				throw bad_alloc();
+			handler();
+		}
+	}
+}
+
+void* operator new(size_t size)									{ return TrackedNew(size); }
+void* operator new[](size_t size)								{ return TrackedNew(size); }
+void* operator new(size_t size, const nothrow_t&) noexcept		{ return TrackedAlloc(size); }
+void* operator new[](size_t size, const nothrow_t&) noexcept	{ return TrackedAlloc(size); }
+
+void operator delete(void* ptr) noexcept						{ TrackedFree(ptr); }
+void operator delete[](void* ptr) noexcept						{ TrackedFree(ptr); }
+void operator delete(void* ptr, size_t) noexcept				{ TrackedFree(ptr); }
+void operator delete[](void* ptr, size_t) noexcept				{ TrackedFree(ptr); }
+void operator delete(void* ptr, const nothrow_t&) noexcept		{ TrackedFree(ptr); }
+void operator delete[](void* ptr, const nothrow_t&) noexcept	{ TrackedFree(ptr); }
+
+#endif
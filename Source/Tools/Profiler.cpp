@@ -1,7 +1,15 @@
 #include <Tools/Profiler.h>
-#include <GLFW/glfw3.h>
 #include <imgui/imgui.h>
 #include <Graphics/Color.h>
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
 
 using namespace Osm;
 using namespace std;
@@ -17,51 +25,255 @@ vector<ImU32> colors =
 	ImColor(Color::Orange.integervalue)
 };
 
+namespace
+{
+	/// Events of one thread that haven't been collected yet
+	struct Timeline
+	{
+		string					Name;
+		uint					Index;
+		mutex					Mutex;
+		vector<Profiler::Event>	Events;
+		vector<uint>			Open;		// Indices of the scopes still open
+	};
+
+	// Timelines are never removed, so a thread's index stays valid
+	mutex								gTimelinesMutex;
+	vector<unique_ptr<Timeline>>		gTimelines;
+	thread_local Timeline*				tTimeline = nullptr;
+
+	// GPU events waiting to be placed in a frame, and their timeline
+	mutex								gGPUMutex;
+	vector<Profiler::Event>				gGPUEvents;
+	Timeline*							gGPUTimeline = nullptr;
+
+	// Names of sections opened with a string, they need to stay around
+	mutex								gNamesMutex;
+	set<string>							gNames;
+
+	Timeline& GetTimeline()
+	{
+		if (!tTimeline)
+		{
+			lock_guard<mutex> lock(gTimelinesMutex);
+			gTimelines.push_back(make_unique<Timeline>());
+			tTimeline = gTimelines.back().get();
+			tTimeline->Index = (uint)(gTimelines.size() - 1);
+			tTimeline->Name = "Thread " + to_string(gTimelines.size() - 1);
+		}
+		return *tTimeline;
+	}
+}
+
 Profiler::Profiler(CGame& engine)
 	: Component(engine)
-	, _sections()
-	, _frameStart(-1.0f)
-	, _frameEnd(-1.0f)
+	, _history(kHistorySize)
 	, _framePerSecond(0)
 	, _timePerFrame(0.0)
 	, _timeSinceRefresh(0.0)
 {
+	SetThreadName("Main");
+	_mainThread = GetTimeline().Index;
+	_frameStart = Now();
+
+	const auto& settings = engine.Settings();
+	if (!settings.CaptureTrace.empty())
+		CaptureTrace(settings.CaptureTrace, (uint)max(settings.CaptureFrames, 1));
+	_hitchThreshold = settings.HitchThreshold;
+	if (!settings.Budget.empty())
+		SetBudget(settings.Budget);
 }
 
 void Profiler::StartFrame()
 {
-	_frameStart = glfwGetTime();
-	_sections.clear();
+	_frameStart = Now();
 }
 
 void Profiler::EndFrame()
 {
-	double frameTime = glfwGetTime() - _frameStart;	
+	int64_t end = Now();
+
+	const Frame* collected = &_pausedFrame;
+	if (_paused)
+	{
+		// Still drain the timelines, so they don't grow while paused
+		Collect(_pausedFrame, end);
+	}
+	else
+	{
+		collected = &_history[_historyHead];
+		Collect(_history[_historyHead], end);
+		_historyHead = (_historyHead + 1) % kHistorySize;
+		if (_historyCount < kHistorySize)
+			_historyCount++;
+	}
+
+	for (auto& budget : _budgets)
+	{
+		double time = budget.Section == "Frame" ?
+			collected->GetDuration() :
+			GetSectionTime(*collected, budget.Section);
+		float sample = (float)(time * 1000.0);
+		if (budget.Samples.size() < kBudgetSamples)
+		{
+			budget.Samples.push_back(sample);
+		}
+		else
+		{
+			// The stats don't depend on the order, so just overwrite the oldest
+			budget.Samples[budget.Head] = sample;
+			budget.Head = (budget.Head + 1) % kBudgetSamples;
+		}
+	}
+
+	if (_captureFrames > 0)
+	{
+		_capture.push_back(*collected);
+		if (--_captureFrames == 0)
+			_captureDelay = kGPULatency;
+	}
+	else if (_captureDelay > 0 && --_captureDelay == 0)
+	{
+		WriteTrace();
+	}
+
+	PlaceGPUEvents();
+
+	double frameTime = ToSeconds(end - _frameStart);
 	_timeSinceRefresh += frameTime;
 	_framePerSecond += 1.0;
 	if (_timeSinceRefresh > kRefreshRate)
-	{		
+	{
 		_timePerFrame = _timeSinceRefresh / _framePerSecond;
 		_framePerSecond = 0.0;
 		_timeSinceRefresh -= kRefreshRate;
 	}
 }
 
+void Profiler::Collect(Frame& frame, int64_t end)
+{
+	frame.Number = _frameNumber++;
+	frame.Start = _frameStart;
+	frame.End = end;
+	frame.Memory = MemoryTracker::EndFrame();
+	CounterRegistry::Sample(frame.Counters);
+
+	size_t used = 0;
+	lock_guard<mutex> lock(gTimelinesMutex);
+	for (size_t i = 0; i < gTimelines.size(); i++)
+	{
+		Timeline& timeline = *gTimelines[i];
+		lock_guard<mutex> timelineLock(timeline.Mutex);
+		if (timeline.Events.empty())
+			continue;
+
+		if (frame.Threads.size() <= used)
+			frame.Threads.push_back(ThreadEvents());
+		ThreadEvents& thread = frame.Threads[used++];
+		thread.Thread = (uint)i;
+		thread.Events.assign(timeline.Events.begin(), timeline.Events.end());
+
+		// Scopes that are still open get cut at the end of the frame
+		// and continue in the next one
+		for (auto& e : thread.Events)
+		{
+			if (e.End == 0)
+				e.End = end;
+		}
+
+		for (size_t o = 0; o < timeline.Open.size(); o++)
+		{
+			Event carried = timeline.Events[timeline.Open[o]];
+			carried.Start = end;
+			timeline.Events[o] = carried;
+			timeline.Open[o] = (uint)o;
+		}
+		timeline.Events.resize(timeline.Open.size());
+	}
+
+	while (frame.Threads.size() > used)
+		frame.Threads.pop_back();
+}
+
+namespace
+{
+	bool PlaceEvent(Profiler::Frame& frame, const Profiler::Event& e, uint thread)
+	{
+		if (e.Start < frame.Start || e.Start >= frame.End)
+			return false;
+
+		for (auto& t : frame.Threads)
+		{
+			if (t.Thread == thread)
+			{
+				t.Events.push_back(e);
+				return true;
+			}
+		}
+		frame.Threads.push_back({ thread, { e } });
+		return true;
+	}
+}
+
+void Profiler::PlaceGPUEvents()
+{
+	vector<Event> events;
+	uint thread;
+	{
+		lock_guard<mutex> lock(gGPUMutex);
+		if (gGPUEvents.empty())
+			return;
+		events.swap(gGPUEvents);
+		thread = gGPUTimeline->Index;
+	}
+
+	int64_t latest = _historyCount > 0 ? GetFrame(0).End : 0;
+	vector<Event> later;
+	for (auto& e : events)
+	{
+		for (auto& frame : _capture)
+			PlaceEvent(frame, e, thread);
+
+		bool placed = false;
+		for (uint i = 0; i < _historyCount && !placed; i++)
+			placed = PlaceEvent(_history[(_historyHead + kHistorySize - 1 - i) % kHistorySize], e, thread);
+
+		// Started after the last collected frame, try again next frame
+		if (!placed && e.Start >= latest)
+			later.push_back(e);
+	}
+
+	if (!later.empty())
+	{
+		lock_guard<mutex> lock(gGPUMutex);
+		gGPUEvents.insert(gGPUEvents.end(), later.begin(), later.end());
+	}
+}
+
 uint Profiler::StartSection(const std::string& name)
 {
-	Section section;
-	section.Name = name;
-	section.StartTime = glfwGetTime() - _frameStart;
-	section.EndTime = -1.0f;
-	_sections.push_back(std::move(section));
-	return (uint)(_sections.size() - 1);
+	const char* interned;
+	{
+		lock_guard<mutex> lock(gNamesMutex);
+		interned = gNames.insert(name).first->c_str();
+	}
+	BeginEvent(interned);
+
+	Timeline& timeline = GetTimeline();
+	lock_guard<mutex> lock(timeline.Mutex);
+	return (uint)timeline.Open.size();
 }
 
 void Profiler::EndSection(uint sectionId)
 {
-	ASSERT(sectionId >= 0 && sectionId < _sections.size());
-	auto& section = _sections[sectionId];
-	section.EndTime = glfwGetTime() - _frameStart;
+#ifdef DEBUG
+	Timeline& timeline = GetTimeline();
+	{
+		lock_guard<mutex> lock(timeline.Mutex);
+		ASSERT(sectionId == timeline.Open.size());
+	}
+#endif
+	EndEvent();
 }
 
 double Profiler::GetFPS() const
@@ -69,59 +281,614 @@ double Profiler::GetFPS() const
 	return _framePerSecond / kRefreshRate;
 }
 
+void Profiler::BeginEvent(const char* name)
+{
+	Timeline& timeline = GetTimeline();
+	int64_t now = Now();
+
+	lock_guard<mutex> lock(timeline.Mutex);
+	Event e = { name, now, 0, (uint)timeline.Open.size() };
+	timeline.Open.push_back((uint)timeline.Events.size());
+	timeline.Events.push_back(e);
+}
+
+void Profiler::EndEvent()
+{
+	Timeline& timeline = GetTimeline();
+	int64_t now = Now();
+
+	lock_guard<mutex> lock(timeline.Mutex);
+	if (timeline.Open.empty())
+		return;
+
+	timeline.Events[timeline.Open.back()].End = now;
+	timeline.Open.pop_back();
+}
+
+void Profiler::SetThreadName(const std::string& name)
+{
+	Timeline& timeline = GetTimeline();
+	lock_guard<mutex> lock(gTimelinesMutex);
+	timeline.Name = name;
+}
+
+std::string Profiler::GetThreadName(uint thread)
+{
+	lock_guard<mutex> lock(gTimelinesMutex);
+	if (thread < gTimelines.size())
+		return gTimelines[thread]->Name;
+	return "";
+}
+
+int64_t Profiler::Now()
+{
+	return chrono::high_resolution_clock::now().time_since_epoch().count();
+}
+
+double Profiler::ToSeconds(int64_t ticks)
+{
+	typedef chrono::high_resolution_clock::period Period;
+	return (double)ticks * Period::num / Period::den;
+}
+
+void Profiler::CaptureTrace(const std::string& file, uint frames)
+{
+	_captureFile = file;
+	_captureFrames = frames;
+	_capture.clear();
+	_capture.reserve(frames);
+	LOG("Capturing %d frames to %s", frames, file.c_str());
+}
+
+namespace
+{
+	// Names are mostly literals and function names, but escape them anyway
+	void WriteString(ofstream& out, const char* str)
+	{
+		out << '"';
+		for (const char* c = str; *c; c++)
+		{
+			if (*c == '"' || *c == '\\')
+				out << '\\';
+			if ((unsigned char)*c >= 0x20)
+				out << *c;
+		}
+		out << '"';
+	}
+}
+
+void Profiler::WriteTrace()
+{
+	ofstream out(_captureFile, ios::trunc);
+	if (!out.is_open())
+	{
+		LOG("Unable to write trace to %s", _captureFile.c_str());
+		_capture.clear();
+		return;
+	}
+
+	// Timestamps are in microseconds from the start of the capture
+	const int64_t origin = _capture.empty() ? 0 : _capture.front().Start;
+	auto micro = [origin](int64_t ticks) { return ToSeconds(ticks - origin) * 1000000.0; };
+	out.precision(3);
+	out << fixed;
+
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+	// Thread names first, for every thread that shows up
+	set<uint> threads = { _mainThread };
+	for (auto& frame : _capture)
+		for (auto& thread : frame.Threads)
+			threads.insert(thread.Thread);
+
+	bool first = true;
+	for (uint t : threads)
+	{
+		if (!first)
+			out << ",\n";
+		first = false;
+		out << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":0,\"tid\":" << t << ",\"args\":{\"name\":";
+		WriteString(out, GetThreadName(t).c_str());
+		out << "}}";
+	}
+
+	for (auto& frame : _capture)
+	{
+		// The frame itself wraps everything the main thread did
+		if (!first)
+			out << ",\n";
+		first = false;
+		out << "{\"ph\":\"X\",\"name\":\"Frame " << frame.Number
+			<< "\",\"pid\":0,\"tid\":" << _mainThread << ",\"ts\":" << micro(frame.Start)
+			<< ",\"dur\":" << micro(frame.End) - micro(frame.Start) << "}";
+
+		// Allocations show up as counter tracks
+		if (MemoryTracker::IsEnabled())
+		{
+			const char* counters[] = { "Allocated KB", "Allocations", "Live KB" };
+			for (int c = 0; c < 3; c++)
+			{
+				out << ",\n{\"ph\":\"C\",\"name\":\"" << counters[c]
+					<< "\",\"pid\":0,\"ts\":" << micro(frame.End) << ",\"args\":{";
+				for (int t = 0; t < MEMORY_TAG_COUNT; t++)
+				{
+					double value =
+						c == 0 ? frame.Memory.FrameBytes[t] / 1024.0 :
+						c == 1 ? (double)frame.Memory.FrameCount[t] :
+						frame.Memory.LiveBytes[t] / 1024.0;
+					out << (t ? "," : "") << "\"" << MemoryTracker::GetTagName((MemoryTag)t) << "\":" << value;
+				}
+				out << "}}";
+			}
+		}
+
+		for (size_t c = 0; c < frame.Counters.size(); c++)
+		{
+			out << ",\n{\"ph\":\"C\",\"name\":";
+			WriteString(out, CounterRegistry::GetName((uint)c));
+			out << ",\"pid\":0,\"ts\":" << micro(frame.Start)
+				<< ",\"args\":{\"value\":" << frame.Counters[c] << "}}";
+		}
+
+		for (auto& thread : frame.Threads)
+		{
+			for (auto& e : thread.Events)
+			{
+				out << ",\n{\"ph\":\"X\",\"name\":";
+				WriteString(out, e.Name);
+				out << ",\"pid\":0,\"tid\":" << thread.Thread
+					<< ",\"ts\":" << micro(e.Start)
+					<< ",\"dur\":" << micro(e.End) - micro(e.Start) << "}";
+			}
+		}
+	}
+
+	out << "\n]}\n";
+	LOG("Wrote %d frames to %s", (int)_capture.size(), _captureFile.c_str());
+	_capture.clear();
+}
+
+Profiler::Stats Profiler::ComputeStats(vector<float>& samples, double hitchThreshold)
+{
+	Stats stats;
+	if (samples.empty())
+		return stats;
+
+	sort(samples.begin(), samples.end());
+
+	// Nearest rank
+	auto percentile = [&samples](double p)
+	{
+		size_t rank = (size_t)ceil(p * samples.size());
+		return (double)samples[rank > 0 ? rank - 1 : 0];
+	};
+
+	double sum = 0.0;
+	for (float s : samples)
+	{
+		sum += s;
+		if (s > hitchThreshold)
+			stats.Hitches++;
+	}
+
+	stats.Samples = (uint)samples.size();
+	stats.Mean = sum / samples.size();
+	stats.P50 = percentile(0.50);
+	stats.P95 = percentile(0.95);
+	stats.P99 = percentile(0.99);
+	stats.Max = samples.back();
+	return stats;
+}
+
+double Profiler::GetSectionTime(const Frame& frame, const std::string& name)
+{
+	int64_t ticks = 0;
+	for (auto& thread : frame.Threads)
+	{
+		for (auto& e : thread.Events)
+		{
+			if (name == e.Name)
+				ticks += e.End - e.Start;
+		}
+	}
+	return ToSeconds(ticks);
+}
+
+Profiler::Stats Profiler::GetFrameStats() const
+{
+	vector<float> samples(_historyCount);
+	for (uint i = 0; i < _historyCount; i++)
+		samples[i] = (float)(GetFrame(i).GetDuration() * 1000.0);
+	return ComputeStats(samples, _hitchThreshold);
+}
+
+Profiler::Stats Profiler::GetSectionStats(const std::string& name) const
+{
+	vector<float> samples(_historyCount);
+	for (uint i = 0; i < _historyCount; i++)
+		samples[i] = (float)(GetSectionTime(GetFrame(i), name) * 1000.0);
+	return ComputeStats(samples, _hitchThreshold);
+}
+
+bool Profiler::ExportCounters(const std::string& file) const
+{
+	ofstream out(file, ios::trunc);
+	if (!out.is_open())
+	{
+		LOG("Unable to write counters to %s", file.c_str());
+		return false;
+	}
+
+	// Counters registered late are missing from older frames, those stay empty
+	uint count = CounterRegistry::GetCount();
+	out << "Frame,Milliseconds";
+	for (uint c = 0; c < count; c++)
+		out << "," << CounterRegistry::GetName(c);
+	out << "\n";
+
+	for (uint i = _historyCount; i-- > 0;)
+	{
+		const Frame& frame = GetFrame(i);
+		out << frame.Number << "," << frame.GetDuration() * 1000.0;
+		for (uint c = 0; c < count; c++)
+		{
+			out << ",";
+			if (c < frame.Counters.size())
+				out << frame.Counters[c];
+		}
+		out << "\n";
+	}
+
+	LOG("Wrote %d frames of counters to %s", (int)_historyCount, file.c_str());
+	return true;
+}
+
+namespace
+{
+	string Trim(const string& str)
+	{
+		size_t begin = str.find_first_not_of(" \t");
+		size_t end = str.find_last_not_of(" \t");
+		return begin == string::npos ? string() : str.substr(begin, end - begin + 1);
+	}
+}
+
+void Profiler::SetBudget(const std::string& spec)
+{
+	_budgets.clear();
+
+	stringstream entries(spec);
+	string entry;
+	while (getline(entries, entry, ','))
+	{
+		size_t first = entry.find(':');
+		size_t second = entry.find(':', first + 1);
+		if (first == string::npos || second == string::npos)
+		{
+			LOG("Budget entry '%s' should look like section:stat:milliseconds", entry.c_str());
+			continue;
+		}
+
+		Budget budget;
+		budget.Section = Trim(entry.substr(0, first));
+		budget.Stat = Trim(entry.substr(first + 1, second - first - 1));
+		budget.Limit = atof(entry.substr(second + 1).c_str());
+		transform(budget.Stat.begin(), budget.Stat.end(), budget.Stat.begin(),
+			[](char c) { return (char)tolower((unsigned char)c); });
+
+		if (budget.Stat != "mean" && budget.Stat != "p50" && budget.Stat != "p95" &&
+			budget.Stat != "p99" && budget.Stat != "max")
+		{
+			LOG("Budget stat '%s' is not one of mean, p50, p95, p99 or max", budget.Stat.c_str());
+			continue;
+		}
+		_budgets.push_back(move(budget));
+	}
+}
+
+bool Profiler::CheckBudget(std::string& report) const
+{
+	bool passed = true;
+	stringstream out;
+	out.precision(3);
+	out << fixed;
+
+	for (auto& budget : _budgets)
+	{
+		vector<float> samples = budget.Samples;
+		Stats stats = ComputeStats(samples, _hitchThreshold);
+
+		double value =
+			budget.Stat == "mean" ? stats.Mean :
+			budget.Stat == "p50" ? stats.P50 :
+			budget.Stat == "p95" ? stats.P95 :
+			budget.Stat == "p99" ? stats.P99 :
+			stats.Max;
+
+		bool over = value > budget.Limit;
+		passed &= !over;
+
+		out << (over ? "  OVER " : "  ok   ")
+			<< budget.Section << " " << budget.Stat << " " << value << " ms (budget " << budget.Limit << " ms)"
+			<< " - mean " << stats.Mean << " p50 " << stats.P50 << " p95 " << stats.P95
+			<< " p99 " << stats.P99 << " max " << stats.Max
+			<< " hitches " << stats.Hitches << "/" << stats.Samples << "\n";
+	}
+
+	report = out.str();
+	return passed;
+}
+
+int64_t Profiler::FromSeconds(double seconds)
+{
+	typedef chrono::high_resolution_clock::period Period;
+	return (int64_t)(seconds * Period::den / Period::num);
+}
+
+void Profiler::AddGPUEvent(const char* name, int64_t start, int64_t end)
+{
+	{
+		lock_guard<mutex> lock(gTimelinesMutex);
+		if (!gGPUTimeline)
+		{
+			gTimelines.push_back(make_unique<Timeline>());
+			gGPUTimeline = gTimelines.back().get();
+			gGPUTimeline->Index = (uint)(gTimelines.size() - 1);
+			gGPUTimeline->Name = "GPU";
+		}
+	}
+
+	Event e = { name, start, end, 0 };
+	lock_guard<mutex> lock(gGPUMutex);
+	gGPUEvents.push_back(e);
+}
+
+const Profiler::Frame& Profiler::GetFrame(uint framesAgo) const
+{
+	ASSERT(framesAgo < _historyCount);
+	uint index = (_historyHead + kHistorySize - 1 - framesAgo) % kHistorySize;
+	return _history[index];
+}
+
 
 #ifdef INSPECTOR
 
 void Profiler::Inspect()
 {
-	ImGuiWindowFlags window_flags = 0;
-	window_flags |= ImGuiWindowFlags_NoResize;
-	
-	if (ImGui::Begin("Profiler"))
+	if (ImGui::Begin("Profiler") && _historyCount > 0)
 	{
+		ImGui::Checkbox("Pause", &_paused);
+		ImGui::SameLine();
+		if (IsCapturing())
+		{
+			if (_captureFrames > 0)
+				ImGui::Text("Capturing, %d frames left", _captureFrames);
+			else
+				ImGui::Text("Waiting for the GPU");
+		}
+		else
+		{
+			ImGui::PushItemWidth(100.0f * ImGui::GetIO().FontGlobalScale);
+			ImGui::InputInt("##CaptureFrames", &_inspectCaptureFrames);
+			ImGui::PopItemWidth();
+			ImGui::SameLine();
+			if (ImGui::Button("Capture Trace"))
+				CaptureTrace(_owner.Settings().SavePath + "trace.json", (uint)max(_inspectCaptureFrames, 1));
+		}
+
+		// Frame times, oldest on the left
+		float times[kHistorySize];
+		for (uint i = 0; i < _historyCount; i++)
+			times[_historyCount - 1 - i] = (float)(GetFrame(i).GetDuration() * 1000.0);
+
+		float width = ImGui::GetContentRegionAvailWidth();
+		ImGui::PlotHistogram("##Frames", times, (int)_historyCount, 0, nullptr, 0.0f, 33.3f, ImVec2(width, 80.0f));
+
+		// Clicking the graph pauses and selects that frame
+		if (ImGui::IsItemHovered() && ImGui::IsMouseClicked(0))
+		{
+			float t = (ImGui::GetMousePos().x - ImGui::GetItemRectMin().x) / ImGui::GetItemRectSize().x;
+			int index = (int)(t * _historyCount);
+			_selectedFrame = (int)_historyCount - 1 - index;
+			_paused = true;
+		}
 
+		if (_paused)
+			ImGui::SliderInt("Frames Ago", &_selectedFrame, 0, (int)_historyCount - 1);
+		else
+			_selectedFrame = 0;
+
+		if (_selectedFrame < 0 || _selectedFrame >= (int)_historyCount)
+			_selectedFrame = 0;
+
+		const Frame& frame = GetFrame((uint)_selectedFrame);
+		const double duration = frame.GetDuration();
+		ImGui::Text("Frame %d - %.3f ms", frame.Number, duration * 1000.0);
+
+		if (ImGui::CollapsingHeader("Statistics"))
+			InspectStats(frame, width);
+
+		if (ImGui::CollapsingHeader("Counters"))
+			InspectCounters(frame, width);
+
+		ImGui::Separator();
+
+		// Timeline, scaled so a 60Hz frame always fits
 		ImDrawList* draw_list = ImGui::GetWindowDrawList();
-						
-		float spacing = 8.0f;
-		float sz = 10.0f * ImGui::GetIO().FontGlobalScale;
-		float barOffset = 200 * ImGui::GetIO().FontGlobalScale;
-		const ImVec2 basePos = ImGui::GetCursorScreenPos();
-		float lenghtF = 1000 * 30;
-		
-		for (size_t i = 0; i < _sections.size(); i++)
+		float rowHeight = ImGui::GetTextLineHeightWithSpacing();
+		float labelWidth = 100 * ImGui::GetIO().FontGlobalScale;
+		float barsWidth = width - labelWidth;
+		double scale = barsWidth / max(duration, 1.0 / 60.0);
+		ImVec2 mouse = ImGui::GetMousePos();
+
+		for (auto& thread : frame.Threads)
 		{
+			uint maxDepth = 0;
+			for (auto& e : thread.Events)
+				maxDepth = max(maxDepth, e.Depth);
+
 			ImVec2 p = ImGui::GetCursorScreenPos();
+			ImGui::Text("%s", GetThreadName(thread.Thread).c_str());
 
-			ImU32 color = colors[i % colors.size()];
+			for (auto& e : thread.Events)
+			{
+				double start = ToSeconds(max(e.Start, frame.Start) - frame.Start);
+				double end = ToSeconds(e.End - frame.Start);
+				float x0 = p.x + labelWidth + (float)(start * scale);
+				float x1 = p.x + labelWidth + max((float)(end * scale), (float)(start * scale) + 1.0f);
+				float y0 = p.y + e.Depth * rowHeight;
+				float y1 = y0 + rowHeight - 1.0f;
 
-			auto& section = _sections[i];
-			if (section.EndTime == -1.0f)
-				continue;
+				ImU32 color = colors[e.Depth % colors.size()];
+				draw_list->AddRectFilled(ImVec2(x0, y0), ImVec2(x1, y1), color);
 
-			double time = section.EndTime - section.StartTime;	
+				// Only label the bars that have room for it
+				if (ImGui::CalcTextSize(e.Name).x < x1 - x0)
+					draw_list->AddText(ImVec2(x0 + 2.0f, y0), ImColor(Color::Black.integervalue), e.Name);
 
-			ImGui::TextColored(ImColor(color), "%s - %f", section.Name.c_str(), time * 1000);
+				if (mouse.x >= x0 && mouse.x <= x1 && mouse.y >= y0 && mouse.y <= y1)
+					ImGui::SetTooltip("%s\n%.3f ms", e.Name, ToSeconds(e.End - e.Start) * 1000.0);
+			}
 
-			float x0 = p.x + (int)(section.StartTime * lenghtF) + barOffset;
-			float x1 = p.x + (int)(section.EndTime * lenghtF) + barOffset;
+			ImGui::SetCursorScreenPos(ImVec2(p.x, p.y + (maxDepth + 1) * rowHeight + 4.0f));
+			ImGui::Separator();
+		}
+	}
+	ImGui::End();
+}
+void Profiler::InspectStats(const Frame& frame, float width)
+{
+	float threshold = (float)_hitchThreshold;
+	if (ImGui::InputFloat("Hitch Threshold (ms)", &threshold))
+		_hitchThreshold = threshold;
 
-			draw_list->AddRectFilled(ImVec2(x0, p.y + 4), ImVec2(x1, p.y + sz), color);
+	// Distribution of frame times
+	Stats frameStats = GetFrameStats();
+	const int kBuckets = 50;
+	const double range = max(frameStats.Max, _hitchThreshold) * 1.05;
+	float buckets[kBuckets] = {};
+	for (uint i = 0; i < _historyCount; i++)
+	{
+		int b = (int)(GetFrame(i).GetDuration() * 1000.0 / range * kBuckets);
+		buckets[min(b, kBuckets - 1)] += 1.0f;
+	}
+	char overlay[64];
+	snprintf(overlay, sizeof(overlay), "0 - %.1f ms", range);
+	ImGui::PlotHistogram("##Distribution", buckets, kBuckets, 0, overlay, 0.0f, FLT_MAX, ImVec2(width, 60.0f));
 
-			p.y += sz + spacing;
-			ImGui::SetCursorScreenPos(p);
-		}
+	// Every section in the selected frame gets a row
+	set<string> names;
+	for (auto& thread : frame.Threads)
+		for (auto& e : thread.Events)
+			names.insert(e.Name);
+
+	ImGui::Columns(7, "Stats");
+	ImGui::Separator();
+	const char* headers[] = { "Section", "Mean", "P50", "P95", "P99", "Max", "Hitches" };
+	for (auto h : headers)
+	{
+		ImGui::Text("%s", h);
+		ImGui::NextColumn();
+	}
+	ImGui::Separator();
+
+	auto row = [](const char* name, const Stats& stats)
+	{
+		ImGui::Text("%s", name);				ImGui::NextColumn();
+		ImGui::Text("%.2f", stats.Mean);		ImGui::NextColumn();
+		ImGui::Text("%.2f", stats.P50);			ImGui::NextColumn();
+		ImGui::Text("%.2f", stats.P95);			ImGui::NextColumn();
+		ImGui::Text("%.2f", stats.P99);			ImGui::NextColumn();
+		ImGui::Text("%.2f", stats.Max);			ImGui::NextColumn();
+		ImGui::Text("%d", stats.Hitches);		ImGui::NextColumn();
+	};
 
-		float lowY = ImGui::GetCursorScreenPos().y;
-		ImVec2 p = ImGui::GetCursorScreenPos();
+	row("Frame", frameStats);
+	for (auto& name : names)
+		row(name.c_str(), GetSectionStats(name));
 
-		float max = 1.0f / 60.0f;
-		draw_list->AddRectFilled(	ImVec2(p.x + max * lenghtF + barOffset, 0),
-									ImVec2(p.x + max * lenghtF + barOffset + 2, lowY),
-									ImColor(Color::White.integervalue));
+	ImGui::Columns(1);
+}
+
+void Profiler::InspectCounters(const Frame& frame, float width)
+{
+	if (ImGui::Button("Export CSV"))
+		ExportCounters(_owner.Settings().SavePath + "counters.csv");
 
-		ImGui::End();
+	float values[kHistorySize];
+	for (uint c = 0; c < (uint)frame.Counters.size(); c++)
+	{
+		// History of this counter, oldest on the left
+		for (uint i = 0; i < _historyCount; i++)
+		{
+			const auto& counters = GetFrame(i).Counters;
+			values[_historyCount - 1 - i] = c < counters.size() ? (float)counters[c] : 0.0f;
+		}
+
+		char label[128];
+		snprintf(label, sizeof(label), "%s: %lld", CounterRegistry::GetName(c), (long long)frame.Counters[c]);
+		ImGui::PushID(c);
+		ImGui::PlotLines("##Counter", values, (int)_historyCount, 0, label, 0.0f, FLT_MAX, ImVec2(width, 40.0f));
+		ImGui::PopID();
 	}
+}
 
-	_sections.clear();
+void Profiler::InspectMemory()
+{
+	if (ImGui::Begin("Memory"))
+	{
+		if (!MemoryTracker::IsEnabled())
+		{
+			ImGui::TextWrapped("Build with MEMORY_TRACKING to count allocations");
+		}
+		else if (_historyCount > 0)
+		{
+			const Frame& frame = GetFrame(_paused ? (uint)_selectedFrame : 0);
+			const MemoryStats& stats = frame.Memory;
+
+			ImGui::Text("Frame %d", frame.Number);
+			ImGui::Columns(4, "Memory");
+			ImGui::Separator();
+			ImGui::Text("Tag");				ImGui::NextColumn();
+			ImGui::Text("Live KB");			ImGui::NextColumn();
+			ImGui::Text("Frame KB");		ImGui::NextColumn();
+			ImGui::Text("Frame Allocs");	ImGui::NextColumn();
+			ImGui::Separator();
+
+			int64_t live = 0, bytes = 0;
+			uint count = 0;
+			for (int t = 0; t < MEMORY_TAG_COUNT; t++)
+			{
+				ImGui::Text("%s", MemoryTracker::GetTagName((MemoryTag)t));	ImGui::NextColumn();
+				ImGui::Text("%.1f", stats.LiveBytes[t] / 1024.0);			ImGui::NextColumn();
+				ImGui::Text("%.1f", stats.FrameBytes[t] / 1024.0);			ImGui::NextColumn();
+				ImGui::Text("%d", stats.FrameCount[t]);						ImGui::NextColumn();
+				live += stats.LiveBytes[t];
+				bytes += stats.FrameBytes[t];
+				count += stats.FrameCount[t];
+			}
+
+			ImGui::Separator();
+			ImGui::Text("Total");							ImGui::NextColumn();
+			ImGui::Text("%.1f", live / 1024.0);				ImGui::NextColumn();
+			ImGui::Text("%.1f", bytes / 1024.0);			ImGui::NextColumn();
+			ImGui::Text("%d", count);						ImGui::NextColumn();
+			ImGui::Columns(1);
+			ImGui::Separator();
+
+			// Allocations per frame over the history, oldest on the left
+			float allocs[kHistorySize];
+			for (uint i = 0; i < _historyCount; i++)
+			{
+				const MemoryStats& m = GetFrame(i).Memory;
+				uint total = 0;
+				for (int t = 0; t < MEMORY_TAG_COUNT; t++)
+					total += m.FrameCount[t];
+				allocs[_historyCount - 1 - i] = (float)total;
+			}
+			ImGui::PlotLines("Allocations", allocs, (int)_historyCount, 0, nullptr, 0.0f, FLT_MAX, ImVec2(0, 80.0f));
+		}
+	}
+	ImGui::End();
 }
 #endif